@@ -0,0 +1,279 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "gstrealsensemeta.h"
+
+#include <cstring>
+
+/* ----> Pyramid meta */
+
+GType
+gst_realsense_pyramid_meta_api_get_type (void)
+{
+  static gsize type = 0;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register ("GstRealsensePyramidMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+  return (GType) type;
+}
+
+static gboolean
+gst_realsense_pyramid_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
+{
+  auto *pmeta = reinterpret_cast<GstRealsensePyramidMeta *>(meta);
+
+  pmeta->levels_buffer = NULL;
+  pmeta->n_levels = 0;
+  memset (pmeta->levels, 0, sizeof (pmeta->levels));
+  return TRUE;
+}
+
+static void
+gst_realsense_pyramid_meta_free (GstMeta * meta, GstBuffer * buffer)
+{
+  auto *pmeta = reinterpret_cast<GstRealsensePyramidMeta *>(meta);
+
+  if (pmeta->levels_buffer)
+    gst_buffer_unref (pmeta->levels_buffer);
+  pmeta->levels_buffer = NULL;
+}
+
+static gboolean
+gst_realsense_pyramid_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  auto *pmeta = reinterpret_cast<GstRealsensePyramidMeta *>(meta);
+
+  /* The levels describe the whole frame, so only full copies keep them */
+  if (!GST_META_TRANSFORM_IS_COPY (type))
+    return FALSE;
+  auto *copy = static_cast<GstMetaTransformCopy *>(data);
+  if (copy->region)
+    return FALSE;
+
+  return gst_buffer_add_realsense_pyramid_meta (dest, pmeta->levels_buffer,
+      pmeta->levels, pmeta->n_levels) != NULL;
+}
+
+const GstMetaInfo *
+gst_realsense_pyramid_meta_get_info (void)
+{
+  static const GstMetaInfo *meta_info = NULL;
+
+  if (g_once_init_enter ((GstMetaInfo **) & meta_info)) {
+    const GstMetaInfo *mi = gst_meta_register (GST_REALSENSE_PYRAMID_META_API_TYPE,
+        "GstRealsensePyramidMeta", sizeof (GstRealsensePyramidMeta),
+        gst_realsense_pyramid_meta_init, gst_realsense_pyramid_meta_free,
+        gst_realsense_pyramid_meta_transform);
+    g_once_init_leave ((GstMetaInfo **) & meta_info, (GstMetaInfo *) mi);
+  }
+  return meta_info;
+}
+
+GstRealsensePyramidMeta *
+gst_buffer_add_realsense_pyramid_meta (GstBuffer * buffer, GstBuffer * levels_buffer,
+    const RsPyramidLevel * levels, gint n_levels)
+{
+  g_return_val_if_fail (levels_buffer != NULL, NULL);
+  g_return_val_if_fail (n_levels >= 0 && n_levels <= RS_PYRAMID_MAX_LEVELS, NULL);
+
+  auto *pmeta = reinterpret_cast<GstRealsensePyramidMeta *>(
+      gst_buffer_add_meta (buffer, GST_REALSENSE_PYRAMID_META_INFO, NULL));
+  if (!pmeta)
+    return NULL;
+
+  pmeta->levels_buffer = gst_buffer_ref (levels_buffer);
+  pmeta->n_levels = n_levels;
+  memcpy (pmeta->levels, levels, sizeof (RsPyramidLevel) * n_levels);
+  return pmeta;
+}
+
+/* ----> Latency meta */
+
+GType
+gst_realsense_latency_meta_api_get_type (void)
+{
+  static gsize type = 0;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register (GST_REALSENSE_LATENCY_META_API_NAME, tags);
+    g_once_init_leave (&type, _type);
+  }
+  return (GType) type;
+}
+
+static void
+gst_realsense_latency_meta_clear (GstRealsenseLatencyMeta * lmeta)
+{
+  lmeta->sensor_timestamp = 0.0;
+  lmeta->sensor_domain = 0;
+  lmeta->sensor = GST_CLOCK_TIME_NONE;
+  lmeta->arrival = GST_CLOCK_TIME_NONE;
+  lmeta->aligned = GST_CLOCK_TIME_NONE;
+  lmeta->encoded = GST_CLOCK_TIME_NONE;
+  lmeta->pushed = GST_CLOCK_TIME_NONE;
+  lmeta->n_stamps = 0;
+}
+
+static gboolean
+gst_realsense_latency_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
+{
+  gst_realsense_latency_meta_clear (reinterpret_cast<GstRealsenseLatencyMeta *>(meta));
+  return TRUE;
+}
+
+static gboolean
+gst_realsense_latency_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  auto *lmeta = reinterpret_cast<GstRealsenseLatencyMeta *>(meta);
+
+  /* Timing belongs to the frame, so any copy keeps it */
+  if (!GST_META_TRANSFORM_IS_COPY (type))
+    return FALSE;
+
+  GstRealsenseLatencyMeta *copy = gst_buffer_add_realsense_latency_meta (dest);
+  if (!copy)
+    return FALSE;
+  memcpy (reinterpret_cast<guint8 *>(copy) + sizeof (GstMeta),
+      reinterpret_cast<const guint8 *>(lmeta) + sizeof (GstMeta),
+      sizeof (GstRealsenseLatencyMeta) - sizeof (GstMeta));
+  return TRUE;
+}
+
+const GstMetaInfo *
+gst_realsense_latency_meta_get_info (void)
+{
+  static const GstMetaInfo *meta_info = NULL;
+
+  if (g_once_init_enter ((GstMetaInfo **) & meta_info)) {
+    const GstMetaInfo *mi = gst_meta_register (GST_REALSENSE_LATENCY_META_API_TYPE,
+        "GstRealsenseLatencyMeta", sizeof (GstRealsenseLatencyMeta),
+        gst_realsense_latency_meta_init, NULL, gst_realsense_latency_meta_transform);
+    g_once_init_leave ((GstMetaInfo **) & meta_info, (GstMetaInfo *) mi);
+  }
+  return meta_info;
+}
+
+GstClockTime
+gst_realsense_latency_now (void)
+{
+  return g_get_monotonic_time () * GST_USECOND;
+}
+
+GstRealsenseLatencyMeta *
+gst_buffer_add_realsense_latency_meta (GstBuffer * buffer)
+{
+  GstRealsenseLatencyMeta *lmeta = gst_buffer_get_realsense_latency_meta (buffer);
+  if (lmeta) {
+    gst_realsense_latency_meta_clear (lmeta);
+    return lmeta;
+  }
+
+  lmeta = reinterpret_cast<GstRealsenseLatencyMeta *>(
+      gst_buffer_add_meta (buffer, GST_REALSENSE_LATENCY_META_INFO, NULL));
+  if (lmeta)
+    GST_META_FLAG_SET (&lmeta->meta, GST_META_FLAG_POOLED);
+  return lmeta;
+}
+
+gboolean
+gst_realsense_latency_meta_stamp (GstRealsenseLatencyMeta * meta, const gchar * stage)
+{
+  g_return_val_if_fail (meta != NULL && stage != NULL, FALSE);
+
+  if (meta->n_stamps >= GST_REALSENSE_LATENCY_MAX_STAMPS)
+    return FALSE;
+  meta->stamps[meta->n_stamps].stage = g_quark_from_string (stage);
+  meta->stamps[meta->n_stamps].time = gst_realsense_latency_now ();
+  ++meta->n_stamps;
+  return TRUE;
+}
+
+/* ----> Floor meta */
+
+GType
+gst_realsense_floor_meta_api_get_type (void)
+{
+  static gsize type = 0;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type)) {
+    GType _type = gst_meta_api_type_register (GST_REALSENSE_FLOOR_META_API_NAME, tags);
+    g_once_init_leave (&type, _type);
+  }
+  return (GType) type;
+}
+
+static gboolean
+gst_realsense_floor_meta_init (GstMeta * meta, gpointer params, GstBuffer * buffer)
+{
+  auto *fmeta = reinterpret_cast<GstRealsenseFloorMeta *>(meta);
+
+  fmeta->found = FALSE;
+  memset (fmeta->plane, 0, sizeof (fmeta->plane));
+  fmeta->inlier_ratio = 0.0f;
+  fmeta->samples = 0;
+  fmeta->hypotheses = 0;
+  return TRUE;
+}
+
+static gboolean
+gst_realsense_floor_meta_transform (GstBuffer * dest, GstMeta * meta,
+    GstBuffer * buffer, GQuark type, gpointer data)
+{
+  auto *fmeta = reinterpret_cast<GstRealsenseFloorMeta *>(meta);
+
+  /* The plane is in camera coordinates, not pixels, so any copy keeps it */
+  if (!GST_META_TRANSFORM_IS_COPY (type))
+    return FALSE;
+
+  GstRealsenseFloorMeta *copy = gst_buffer_add_realsense_floor_meta (dest);
+  if (!copy)
+    return FALSE;
+  memcpy (reinterpret_cast<guint8 *>(copy) + sizeof (GstMeta),
+      reinterpret_cast<const guint8 *>(fmeta) + sizeof (GstMeta),
+      sizeof (GstRealsenseFloorMeta) - sizeof (GstMeta));
+  return TRUE;
+}
+
+const GstMetaInfo *
+gst_realsense_floor_meta_get_info (void)
+{
+  static const GstMetaInfo *meta_info = NULL;
+
+  if (g_once_init_enter ((GstMetaInfo **) & meta_info)) {
+    const GstMetaInfo *mi = gst_meta_register (GST_REALSENSE_FLOOR_META_API_TYPE,
+        "GstRealsenseFloorMeta", sizeof (GstRealsenseFloorMeta),
+        gst_realsense_floor_meta_init, NULL, gst_realsense_floor_meta_transform);
+    g_once_init_leave ((GstMetaInfo **) & meta_info, (GstMetaInfo *) mi);
+  }
+  return meta_info;
+}
+
+GstRealsenseFloorMeta *
+gst_buffer_add_realsense_floor_meta (GstBuffer * buffer)
+{
+  return reinterpret_cast<GstRealsenseFloorMeta *>(
+      gst_buffer_add_meta (buffer, GST_REALSENSE_FLOOR_META_INFO, NULL));
+}
@@ -0,0 +1,146 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_REALSENSE_META_H__
+#define __GST_REALSENSE_META_H__
+
+#include <gst/gst.h>
+
+#include "rspyramid.h"
+
+G_BEGIN_DECLS
+
+/* Pyramid meta: half-resolution levels of the color and depth planes */
+#define GST_REALSENSE_PYRAMID_META_API_TYPE (gst_realsense_pyramid_meta_api_get_type())
+#define GST_REALSENSE_PYRAMID_META_INFO (gst_realsense_pyramid_meta_get_info())
+#define gst_buffer_get_realsense_pyramid_meta(b) \
+  ((GstRealsensePyramidMeta *)gst_buffer_get_meta((b), GST_REALSENSE_PYRAMID_META_API_TYPE))
+
+typedef struct _GstRealsensePyramidMeta GstRealsensePyramidMeta;
+
+struct _GstRealsensePyramidMeta
+{
+  GstMeta meta;
+
+  /* All levels in one buffer, color (RGB) levels first, then depth (Z16).
+   * levels[0] is half the resolution of the frame, levels[i + 1] half of
+   * levels[i]; offsets and strides are in bytes into levels_buffer. */
+  GstBuffer *levels_buffer;
+  gint n_levels;
+  RsPyramidLevel levels[RS_PYRAMID_MAX_LEVELS];
+};
+
+GType gst_realsense_pyramid_meta_api_get_type (void);
+const GstMetaInfo *gst_realsense_pyramid_meta_get_info (void);
+
+/* Takes a ref on levels_buffer */
+GstRealsensePyramidMeta *gst_buffer_add_realsense_pyramid_meta (GstBuffer * buffer,
+    GstBuffer * levels_buffer, const RsPyramidLevel * levels, gint n_levels);
+
+/* Latency meta: when a frame passed each stage, for per-frame latency
+ * waterfalls. All times are on the latency clock (monotonic time in ns,
+ * see gst_realsense_latency_now) and GST_CLOCK_TIME_NONE if not reached. */
+#define GST_REALSENSE_LATENCY_META_API_NAME "GstRealsenseLatencyMetaAPI"
+#define GST_REALSENSE_LATENCY_META_API_TYPE (gst_realsense_latency_meta_api_get_type())
+#define GST_REALSENSE_LATENCY_META_INFO (gst_realsense_latency_meta_get_info())
+#define gst_buffer_get_realsense_latency_meta(b) \
+  ((GstRealsenseLatencyMeta *)gst_buffer_get_meta((b), GST_REALSENSE_LATENCY_META_API_TYPE))
+
+#define GST_REALSENSE_LATENCY_MAX_STAMPS 16
+
+/* Applications that do not link the plugin look the API up by name with
+ * g_type_from_name (GST_REALSENSE_LATENCY_META_API_NAME) once a buffer
+ * with the meta has been produced, and read the struct directly. */
+
+typedef struct _GstRealsenseLatencyMeta GstRealsenseLatencyMeta;
+
+typedef struct
+{
+  GQuark stage;
+  GstClockTime time;
+} GstRealsenseLatencyStamp;
+
+struct _GstRealsenseLatencyMeta
+{
+  GstMeta meta;
+
+  /* Color frame timestamp as reported by librealsense, in ms, and its
+   * rs2_timestamp_domain. sensor is the same instant on the latency clock
+   * for host-based domains, GST_CLOCK_TIME_NONE for the hardware clock. */
+  gdouble sensor_timestamp;
+  gint sensor_domain;
+  GstClockTime sensor;
+
+  GstClockTime arrival;   /* wait_for_frames returned */
+  GstClockTime aligned;   /* after align or guided upsampling */
+  GstClockTime encoded;   /* output buffer filled */
+  GstClockTime pushed;    /* handed to the downstream peer */
+
+  /* Appended by downstream stages with gst_realsense_latency_meta_stamp() */
+  guint n_stamps;
+  GstRealsenseLatencyStamp stamps[GST_REALSENSE_LATENCY_MAX_STAMPS];
+};
+
+GType gst_realsense_latency_meta_api_get_type (void);
+const GstMetaInfo *gst_realsense_latency_meta_get_info (void);
+
+GstClockTime gst_realsense_latency_now (void);
+
+/* Returns a cleared latency meta on buffer. The meta is marked pooled, so
+ * a recycled buffer still carries it and it is reused rather than added. */
+GstRealsenseLatencyMeta *gst_buffer_add_realsense_latency_meta (GstBuffer * buffer);
+
+/* Appends stage at the current time. Returns FALSE when the meta is full. */
+gboolean gst_realsense_latency_meta_stamp (GstRealsenseLatencyMeta * meta, const gchar * stage);
+
+/* Floor meta: the floor plane fitted to this frame's depth, see
+ * floor-plane. Plain data like the latency meta, so applications that do
+ * not link the plugin read it the same way, looking the API up with
+ * g_type_from_name (GST_REALSENSE_FLOOR_META_API_NAME). */
+#define GST_REALSENSE_FLOOR_META_API_NAME "GstRealsenseFloorMetaAPI"
+#define GST_REALSENSE_FLOOR_META_API_TYPE (gst_realsense_floor_meta_api_get_type())
+#define GST_REALSENSE_FLOOR_META_INFO (gst_realsense_floor_meta_get_info())
+#define gst_buffer_get_realsense_floor_meta(b) \
+  ((GstRealsenseFloorMeta *)gst_buffer_get_meta((b), GST_REALSENSE_FLOOR_META_API_TYPE))
+
+typedef struct _GstRealsenseFloorMeta GstRealsenseFloorMeta;
+
+struct _GstRealsenseFloorMeta
+{
+  GstMeta meta;
+
+  /* plane[0..2] * p + plane[3] = 0 for points p of the floor, in metres in
+   * the camera frame of the output depth plane (x right, y down, z
+   * forward). The normal has unit length and points up, so plane[3] is the
+   * camera height above the floor. All 0 when found is FALSE. */
+  gboolean found;
+  gfloat plane[4];
+  gfloat inlier_ratio;  /* share of the depth samples on the plane */
+  guint samples;        /* valid depth samples the fit ran on */
+  guint hypotheses;     /* RANSAC hypotheses scored, 0 when tracked */
+};
+
+GType gst_realsense_floor_meta_api_get_type (void);
+const GstMetaInfo *gst_realsense_floor_meta_get_info (void);
+
+GstRealsenseFloorMeta *gst_buffer_add_realsense_floor_meta (GstBuffer * buffer);
+
+G_END_DECLS
+
+#endif /* __GST_REALSENSE_META_H__ */
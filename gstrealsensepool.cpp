@@ -0,0 +1,91 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "gstrealsensepool.h"
+
+G_DEFINE_TYPE (GstRealsenseBufferPool, gst_realsense_buffer_pool, GST_TYPE_BUFFER_POOL);
+
+static gsize
+gst_realsense_buffer_pool_bytes (GstBuffer * buffer)
+{
+  gsize maxsize = 0;
+  gst_buffer_get_sizes (buffer, NULL, &maxsize);
+  return maxsize;
+}
+
+static GstFlowReturn
+gst_realsense_buffer_pool_alloc_buffer (GstBufferPool * pool, GstBuffer ** buffer,
+    GstBufferPoolAcquireParams * params)
+{
+  auto *self = GST_REALSENSE_BUFFER_POOL (pool);
+  GstFlowReturn ret = GST_BUFFER_POOL_CLASS (gst_realsense_buffer_pool_parent_class)->alloc_buffer (
+      pool, buffer, params);
+
+  if (ret == GST_FLOW_OK && self->account)
+    (*self->account)->add (RsMemPools, gst_realsense_buffer_pool_bytes (*buffer));
+  return ret;
+}
+
+static void
+gst_realsense_buffer_pool_free_buffer (GstBufferPool * pool, GstBuffer * buffer)
+{
+  auto *self = GST_REALSENSE_BUFFER_POOL (pool);
+
+  if (self->account)
+    (*self->account)->add (RsMemPools, -(int64_t) gst_realsense_buffer_pool_bytes (buffer));
+  GST_BUFFER_POOL_CLASS (gst_realsense_buffer_pool_parent_class)->free_buffer (pool, buffer);
+}
+
+static void
+gst_realsense_buffer_pool_finalize (GObject * object)
+{
+  auto *self = GST_REALSENSE_BUFFER_POOL (object);
+
+  delete self->account;
+  self->account = NULL;
+  G_OBJECT_CLASS (gst_realsense_buffer_pool_parent_class)->finalize (object);
+}
+
+static void
+gst_realsense_buffer_pool_class_init (GstRealsenseBufferPoolClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBufferPoolClass *pool_class = GST_BUFFER_POOL_CLASS (klass);
+
+  gobject_class->finalize = gst_realsense_buffer_pool_finalize;
+  pool_class->alloc_buffer = gst_realsense_buffer_pool_alloc_buffer;
+  pool_class->free_buffer = gst_realsense_buffer_pool_free_buffer;
+}
+
+static void
+gst_realsense_buffer_pool_init (GstRealsenseBufferPool * pool)
+{
+  pool->account = NULL;
+}
+
+GstBufferPool *
+gst_realsense_buffer_pool_new (const std::shared_ptr<RsMemoryAccount> & account)
+{
+  auto *pool = GST_REALSENSE_BUFFER_POOL (g_object_new (GST_TYPE_REALSENSE_BUFFER_POOL, NULL));
+
+  gst_object_ref_sink (pool);
+  if (account)
+    pool->account = new std::shared_ptr<RsMemoryAccount> (account);
+  return GST_BUFFER_POOL (pool);
+}
@@ -0,0 +1,59 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __GST_REALSENSE_POOL_H__
+#define __GST_REALSENSE_POOL_H__
+
+#include <memory>
+
+#include <gst/gst.h>
+
+#include "rsmemory.h"
+
+G_BEGIN_DECLS
+
+/* Buffer pool that charges the buffers it allocates to an element's
+ * RsMemoryAccount. The pool keeps the account alive, as buffers can come
+ * back long after the element is gone. */
+#define GST_TYPE_REALSENSE_BUFFER_POOL (gst_realsense_buffer_pool_get_type())
+#define GST_REALSENSE_BUFFER_POOL(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), GST_TYPE_REALSENSE_BUFFER_POOL, GstRealsenseBufferPool))
+
+typedef struct _GstRealsenseBufferPool GstRealsenseBufferPool;
+typedef struct _GstRealsenseBufferPoolClass GstRealsenseBufferPoolClass;
+
+struct _GstRealsenseBufferPool
+{
+  GstBufferPool parent;
+
+  std::shared_ptr<RsMemoryAccount> *account;
+};
+
+struct _GstRealsenseBufferPoolClass
+{
+  GstBufferPoolClass parent_class;
+};
+
+GType gst_realsense_buffer_pool_get_type (void);
+
+GstBufferPool *gst_realsense_buffer_pool_new (const std::shared_ptr<RsMemoryAccount> & account);
+
+G_END_DECLS
+
+#endif /* __GST_REALSENSE_POOL_H__ */
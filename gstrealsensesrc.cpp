@@ -45,6 +45,8 @@
 #include <gst/video/video.h>
 #include <gst/audio/audio.h>
 #include "gstrealsensesrc.h"
+#include "gstrealsensemeta.h"
+#include "rsmux.h"
 #include <cmath>
 #include <fstream>
 #include <vector>
@@ -53,6 +55,21 @@
 GST_DEBUG_CATEGORY_STATIC (gst_realsense_src_debug);
 #define GST_CAT_DEFAULT gst_realsense_src_debug
 
+/* A create() attempt that gave its frameset up to stay within max-memory */
+#define RS_FLOW_DROPPED GST_FLOW_CUSTOM_SUCCESS
+
+/* align=3 kernel: spatial sigma in coarse pixels, color sigma in 8-bit levels */
+#define GUIDED_SIGMA_SPACE 1.0f
+#define GUIDED_SIGMA_COLOR 12.0f
+
+enum
+{
+  SIGNAL_GET_DISTANCES,
+  LAST_SIGNAL
+};
+
+static guint gst_realsense_src_signals[LAST_SIGNAL] = { 0 };
+
 enum
 {
   PROP_0,
@@ -63,7 +80,33 @@ enum
   PROP_DEPTH_WIDTH,
   PROP_DEPTH_HEIGHT,
   PROP_DEPTH_FPS,
-  PROP_PRESET_FILE
+  PROP_PRESET_FILE,
+  PROP_STATS,
+  PROP_ZERO_COPY,
+  PROP_MAX_INFLIGHT,
+  PROP_INFLIGHT_POLICY,
+  PROP_OUTPUT_FORMAT,
+  PROP_JPEG_QUALITY,
+  PROP_ENCODE_THREADS,
+  PROP_PRIORITY,
+  PROP_RECORD_FILE,
+  PROP_RECORD_LEVEL,
+  PROP_PYRAMID_LEVELS,
+  PROP_PYRAMID_DEPTH_FILTER,
+  PROP_DEPTH_MASK,
+  PROP_MAX_MEMORY,
+  PROP_ADAPTIVE,
+  PROP_HOLE_FILL,
+  PROP_LATENCY_META,
+  PROP_PLAYBACK_FILE,
+  PROP_SYNTHETIC,
+  PROP_STARTUP_STATS,
+  PROP_DEPTH_UNITS,
+  PROP_DEPTH_SCALE,
+  PROP_ALIGN_SCALE,
+  PROP_UNDISTORT,
+  PROP_FLOOR_PLANE,
+  PROP_FLOOR_BUDGET
 };
 
 /* the capabilities of the inputs and outputs.
@@ -100,6 +143,10 @@ static GstCaps *gst_realsense_src_get_caps (GstBaseSrc * src, GstCaps * filter);
 static gboolean gst_realsense_src_set_caps (GstBaseSrc * src, GstCaps * caps);
 static gboolean gst_realsense_src_unlock (GstBaseSrc * basesrc);
 static gboolean gst_realsense_src_unlock_stop (GstBaseSrc * basesrc);
+static gboolean gst_realsense_src_event (GstBaseSrc * basesrc, GstEvent * event);
+static gboolean gst_realsense_src_switch_mode (GstRealsenseSrc * src, int rung);
+static GArray *gst_realsense_src_get_distances (GstRealsenseSrc * src, GArray * points,
+    gboolean color_space);
 
 
 static GstStaticPadTemplate gst_realsense_src_pad_template =
@@ -111,6 +158,14 @@ GST_STATIC_PAD_TEMPLATE("src",
         "format = (string) RGB, "
         "width = (int) [1, MAX], "
         "height = (int) [1, MAX], "
+        "framerate = (fraction) [0/1, MAX]; "
+        "image/jpeg, "
+        "width = (int) [1, MAX], "
+        "height = (int) [1, MAX], "
+        "framerate = (fraction) [0/1, MAX]; "
+        "application/x-realsense-sparse-depth, "
+        "width = (int) [1, MAX], "
+        "height = (int) [1, MAX], "
         "framerate = (fraction) [0/1, MAX]"
     )
 );
@@ -148,6 +203,7 @@ gst_realsense_src_class_init (GstRealsenseSrcClass * klass)
   gstbasesrc_class->set_caps = GST_DEBUG_FUNCPTR(gst_realsense_src_set_caps);
   gstbasesrc_class->unlock = GST_DEBUG_FUNCPTR (gst_realsense_src_unlock);
   gstbasesrc_class->unlock_stop = GST_DEBUG_FUNCPTR (gst_realsense_src_unlock_stop);
+  gstbasesrc_class->event = GST_DEBUG_FUNCPTR (gst_realsense_src_event);
 
   gstpushsrc_class->create = GST_DEBUG_FUNCPTR(gst_realsense_src_create);
 
@@ -157,8 +213,9 @@ gst_realsense_src_class_init (GstRealsenseSrcClass * klass)
     g_param_spec_int (
       "align",
       "Alignment",
-      "Alignment between Color and Depth sensors. Valid values: 0=None, 1=Color, 2=Depth. Default: None.",
-      Align::None, Align::Depth, 0,
+      "Alignment between Color and Depth sensors. Valid values: 0=None, 1=Color, 2=Depth, "
+      "3=Guided (depth upsampled to color resolution). Default: None.",
+      Align::None, Align::Guided, 0,
       (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
   
   // Register new properties for color and depth stream configuration
@@ -214,14 +271,315 @@ gst_realsense_src_class_init (GstRealsenseSrcClass * klass)
       "This property is optional and only needed for custom tuning.",
       NULL,
       (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_STATS,
+    g_param_spec_boxed (
+      "stats",
+      "Statistics",
+      "Streaming statistics: frames produced, scratch arena capacity, "
+      "high-water usage and overflow count, zero-copy in-flight, "
+      "fallback and drop counters, depth recording counters and memory usage.",
+      GST_TYPE_STRUCTURE,
+      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_ZERO_COPY,
+    g_param_spec_boolean (
+      "zero-copy",
+      "Zero Copy",
+      "Wrap the RealSense color frame memory in the output buffer instead of copying it. "
+      "Each such buffer pins a frame from the librealsense frame pool until it is released.",
+      FALSE,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_MAX_INFLIGHT,
+    g_param_spec_uint (
+      "max-inflight",
+      "Max In-flight",
+      "Maximum number of zero-copy color buffers that may be held downstream at once. Default: 4.",
+      1, 64, 4,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_INFLIGHT_POLICY,
+    g_param_spec_int (
+      "inflight-policy",
+      "In-flight Policy",
+      "What to do when max-inflight is reached. Valid values: 0=Copy the frame, 1=Drop the frameset. Default: Copy.",
+      InflightCopy, InflightDrop, InflightCopy,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_OUTPUT_FORMAT,
+    g_param_spec_int (
+      "output-format",
+      "Output Format",
+      "Format pushed on the source pad. Valid values: 0=Mux (RGB color over encoded depth), "
+      "1=JPEG (color only, needs libjpeg-turbo), 2=Sparse ((u, v, z) records of valid depth "
+      "pixels). Default: Mux.",
+      OutputMux, OutputSparse, OutputMux,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_JPEG_QUALITY,
+    g_param_spec_int (
+      "jpeg-quality",
+      "JPEG Quality",
+      "Quality of the JPEG color output. Default: 85.",
+      1, 100, 85,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_ENCODE_THREADS,
+    g_param_spec_uint (
+      "encode-threads",
+      "Encode Threads",
+      "Maximum number of threads working on slices of each frame, including the streaming thread. "
+      "Threads come from a pool shared by all instances in the process. "
+      "0 = one per CPU, at most 4. Default: 0.",
+      0, 64, 0,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_PRIORITY,
+    g_param_spec_int (
+      "priority",
+      "Priority",
+      "Priority of this instance's slices in the shared thread pool. "
+      "Valid values: 0=Low, 1=Normal, 2=High, Default: 1",
+      0, 2, 1,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_RECORD_FILE,
+    g_param_spec_string (
+      "record-file",
+      "Record File",
+      "Path of a file to record the output depth plane to (after alignment, before hole-fill), "
+      "losslessly compressed (row delta prediction + zstd, needs zstd at build time). "
+      "Empty disables recording.",
+      NULL,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_RECORD_LEVEL,
+    g_param_spec_int (
+      "record-level",
+      "Record Compression Level",
+      "zstd compression level used for depth recording. Default: 3.",
+      1, 19, 3,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_PYRAMID_LEVELS,
+    g_param_spec_int (
+      "pyramid-levels",
+      "Pyramid Levels",
+      "Number of half-resolution color and depth levels attached to each buffer as a "
+      "GstRealsensePyramidMeta. 0 disables the pyramid. Default: 0.",
+      0, RS_PYRAMID_MAX_LEVELS, 0,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_PYRAMID_DEPTH_FILTER,
+    g_param_spec_int (
+      "pyramid-depth-filter",
+      "Pyramid Depth Filter",
+      "How 2x2 depth blocks are reduced, ignoring invalid samples. "
+      "Valid values: 0=Min (nearest), 1=Median. Default: Min.",
+      RsPyramidDepthMin, RsPyramidDepthMedian, RsPyramidDepthMin,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_DEPTH_MASK,
+    g_param_spec_boolean (
+      "depth-mask",
+      "Depth Mask",
+      "Replace the redundant B channel of the encoded depth with a validity code: "
+      "0 = no data, 64 = out of range, 128 = filled, 255 = valid.",
+      FALSE,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_MAX_MEMORY,
+    g_param_spec_uint64 (
+      "max-memory",
+      "Max Memory",
+      "Budget in bytes for the librealsense frame queues, align output, scratch arena, "
+      "buffer pools, buffers held downstream and the recorder queue. Queues and pools "
+      "are shrunk to fit and frames are dropped while over it. 0 = unlimited. Default: 0.",
+      0, G_MAXUINT64, 0,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_ADAPTIVE,
+    g_param_spec_boolean (
+      "adaptive",
+      "Adaptive",
+      "Step the color and depth modes down a resolution and frame-rate ladder under "
+      "sustained CPU or downstream (QoS) pressure, and back up when there is headroom. "
+      "Each switch restarts the camera, renegotiates caps and posts a "
+      "realsense-mode-change element message.",
+      FALSE,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_HOLE_FILL,
+    g_param_spec_int (
+      "hole-fill",
+      "Hole Fill",
+      "Fill pixels without depth in the encoded depth plane, row by row as it is encoded. "
+      "Valid values: 0=Off, 1=Left (nearest valid pixel to the left), 2=Farthest around "
+      "(3x3), 3=Nearest around (3x3). Default: Off.",
+      0, 3, 0,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_LATENCY_META,
+    g_param_spec_boolean (
+      "latency-meta",
+      "Latency Meta",
+      "Attach a GstRealsenseLatencyMeta with the sensor timestamp and the times each frame "
+      "arrived, was aligned, encoded and pushed. Downstream stages can append their own. "
+      "Default: false.",
+      FALSE,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_PLAYBACK_FILE,
+    g_param_spec_string (
+      "playback-file",
+      "Playback File",
+      "Play a librealsense .bag recording in a loop instead of streaming from a camera. "
+      "The stream modes are taken from the recording and adaptive is ignored. "
+      "Default: none (live camera).",
+      NULL,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_SYNTHETIC,
+    g_param_spec_boolean (
+      "synthetic",
+      "Synthetic",
+      "Stream generated frames from a librealsense software device instead of a camera, "
+      "for benchmarks and tests without hardware. Any supported mode can be used. "
+      "Ignored when playback-file is set. Default: false.",
+      FALSE,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_STARTUP_STATS,
+    g_param_spec_boxed (
+      "startup-stats",
+      "Startup Statistics",
+      "Microseconds spent in each phase of the last start: context creation, device query, "
+      "advanced mode, preset loading, setup, pipeline start, configure, first frame and "
+      "the total, which is their sum. "
+      "Also posted as a realsense-startup element message.",
+      GST_TYPE_STRUCTURE,
+      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_ALIGN_SCALE,
+    g_param_spec_float (
+      "align-scale",
+      "Align Scale",
+      "With align=1, reproject depth onto the color grid scaled by this factor and box filter "
+      "the color image down to it, so both output planes shrink. Rounded to 1/n for n up to 8, "
+      "e.g. 0.5 or 0.25. Disables zero-copy. Default: 1 (full color resolution).",
+      0.125f, 1.0f, 1.0f,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_UNDISTORT,
+    g_param_spec_boolean (
+      "undistort",
+      "Undistort",
+      "Remove the color lens distortion through a remap table built at start, applied while "
+      "the color plane is copied into the output. With align=1 or 3, depth is aligned to the "
+      "undistorted image. Not available with align=2. Disables zero-copy. Default: false.",
+      FALSE,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_FLOOR_PLANE,
+    g_param_spec_boolean (
+      "floor-plane",
+      "Floor Plane",
+      "Fit the floor plane to each depth frame (subsampled RANSAC, warm-started from the "
+      "previous frame) on the encode threads and attach it as a GstRealsenseFloorMeta. "
+      "Default: false.",
+      FALSE,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_FLOOR_BUDGET,
+    g_param_spec_uint (
+      "floor-budget",
+      "Floor Budget",
+      "Time in microseconds the floor-plane search may take per frame. Default: 2000.",
+      100, 100000, 2000,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_DEPTH_UNITS,
+    g_param_spec_float (
+      "depth-units",
+      "Depth Units",
+      "Metres per depth unit to set on the depth sensor at start, overriding the preset. "
+      "Smaller units give finer precision and a shorter encoded range (2559 units in mux output). "
+      "Default: 0 (keep the device setting, 0.001 on a D435i).",
+      0.0f, 0.01f, 0.0f,
+      (GParamFlags)(G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_DEPTH_SCALE,
+    g_param_spec_float (
+      "depth-scale",
+      "Depth Scale",
+      "Metres per unit of the output depth values, as read back from the running device. "
+      "Also in the caps of mux and sparse output.",
+      0.0f, 1.0f, 0.001f,
+      (GParamFlags)(G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  /**
+   * GstRealsenseSrc::get-distances:
+   * @src: the realsensesrc
+   * @points: #GArray of gfloat holding (x, y) pixel pairs
+   * @color_space: TRUE if the points are color pixels, FALSE for depth pixels
+   *
+   * Looks up the distances at @points in the most recent depth frame.
+   *
+   * Returns: (transfer full): #GArray of gfloat distances in metres, one per
+   * point and 0 where there is no depth, or NULL before the first frame.
+   */
+  gst_realsense_src_signals[SIGNAL_GET_DISTANCES] =
+      g_signal_new ("get-distances", G_TYPE_FROM_CLASS (klass),
+      (GSignalFlags)(G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION),
+      G_STRUCT_OFFSET (GstRealsenseSrcClass, get_distances), NULL, NULL, NULL,
+      G_TYPE_ARRAY, 2, G_TYPE_ARRAY, G_TYPE_BOOLEAN);
+
+  klass->get_distances = gst_realsense_src_get_distances;
+}
+
+static void
+gst_realsense_src_clear_pool (GstBufferPool ** pool)
+{
+  if (*pool) {
+    gst_buffer_pool_set_active (*pool, FALSE);
+    gst_object_unref (*pool);
+    *pool = NULL;
+  }
+}
+
+/* An active pool of recycled buffers of the given size, charged to the
+ * element's memory account and capped at pool_buffers, or NULL */
+static GstBufferPool *
+gst_realsense_src_new_pool (GstRealsenseSrc * src, GstCaps * caps, guint size)
+{
+  GstBufferPool *pool = gst_realsense_buffer_pool_new (src->memory);
+  GstStructure *config = gst_buffer_pool_get_config (pool);
+
+  gst_buffer_pool_config_set_params (config, caps, size,
+      src->pool_buffers ? MIN (2, src->pool_buffers) : 2, src->pool_buffers);
+  if (!gst_buffer_pool_set_config (pool, config) ||
+      !gst_buffer_pool_set_active (pool, TRUE)) {
+    gst_object_unref (pool);
+    return NULL;
+  }
+  return pool;
+}
+
+/* A buffer from one of the element's pools. When the pools are capped by
+ * max-memory, running out does not block but returns RS_FLOW_DROPPED. */
+static GstFlowReturn
+gst_realsense_src_acquire (GstRealsenseSrc * src, GstBufferPool * pool, GstBuffer ** buf)
+{
+  GstBufferPoolAcquireParams params = GstBufferPoolAcquireParams ();
+  params.flags = GST_BUFFER_POOL_ACQUIRE_FLAG_DONTWAIT;
+
+  const GstFlowReturn ret = gst_buffer_pool_acquire_buffer (pool, buf,
+      src->pool_buffers ? &params : NULL);
+  if (ret == GST_FLOW_EOS) {
+    GST_LOG_OBJECT (src, "All %u pool buffers are held downstream", src->pool_buffers);
+    return RS_FLOW_DROPPED;
+  }
+  return ret == GST_FLOW_OK ? GST_FLOW_OK : GST_FLOW_FLUSHING;
 }
 
 static void gst_realsense_src_reset(GstRealsenseSrc *src) {
+  // The cached depth frame belongs to the pipeline's frame pool
+  src->depth_query->clear();
+
   if(src->rs_pipeline != nullptr)
     src->rs_pipeline->stop();
+  src->synthetic_camera.reset();
+  src->memory->set(RsMemFrameQueue, 0);
+  src->memory->set(RsMemAlign, 0);
 
   src->out_framesize = 0;
-  src->frame_count = 0;
+  src->frame_count.store(0, std::memory_order_relaxed);
+  src->zero_copy_frames.store(0, std::memory_order_relaxed);
+  src->copy_fallbacks.store(0, std::memory_order_relaxed);
+  src->inflight_drops.store(0, std::memory_order_relaxed);
+  src->memory_drops.store(0, std::memory_order_relaxed);
+
+  gst_realsense_src_clear_pool(&src->out_pool);
+  gst_realsense_src_clear_pool(&src->pyramid_pool);
+  GST_OBJECT_LOCK(src);
+  src->recorder.reset();
+  GST_OBJECT_UNLOCK(src);
+  src->memory->set(RsMemRecorder, 0);
 
   if (src->caps) {
       gst_caps_unref(src->caps);
@@ -249,9 +607,38 @@ gst_realsense_src_init (GstRealsenseSrc * src)
   src->depth_height = 480;
   src->depth_fps = 30;
   src->align = Align::Color;
+  src->align_scale = 1.0f;
+  src->align_divisor = 1;
+  src->undistort = FALSE;
   src->preset_file = NULL;
+  src->zero_copy = FALSE;
+  src->max_inflight = 4;
+  src->inflight_policy = InflightCopy;
+  src->output_format = OutputMux;
+  src->jpeg_quality = 85;
+  src->encode_threads = 0;
+  src->priority = RsTaskPriority::Normal;
+  src->record_file = NULL;
+  src->record_level = 3;
+  src->pyramid_levels = 0;
+  src->pyramid_depth_filter = RsPyramidDepthMin;
+  src->depth_mask = FALSE;
+  src->max_memory = 0;
+  src->adaptive = FALSE;
+  src->adaptive_pending = -1;
+  src->hole_fill = RsHoleFill::Off;
+  src->latency_meta = FALSE;
+  src->latency_probe = 0;
+  src->floor_plane = FALSE;
+  src->floor_budget = 2000;
+  src->playback_file = NULL;
+  src->synthetic = FALSE;
+  src->depth_units = 0.0f;
+  src->depth_scale = 0.001f;
   src->stop_requested = FALSE;
   src->caps = NULL;
+  src->depth_query = std::make_unique<RsDepthQuery>();
+  src->memory = std::make_shared<RsMemoryAccount>();
   gst_realsense_src_reset(src);
 
 }
@@ -318,6 +705,79 @@ gst_realsense_src_set_property (GObject * object, guint prop_id, const GValue *
         g_free(src->preset_file);
       src->preset_file = g_value_dup_string(value);
       break;
+    case PROP_ZERO_COPY:
+      src->zero_copy = g_value_get_boolean(value);
+      break;
+    case PROP_MAX_INFLIGHT:
+      src->max_inflight = g_value_get_uint(value);
+      break;
+    case PROP_INFLIGHT_POLICY:
+      src->inflight_policy = static_cast<InflightPolicy>(g_value_get_int(value));
+      break;
+    case PROP_OUTPUT_FORMAT:
+      src->output_format = static_cast<OutputFormat>(g_value_get_int(value));
+      break;
+    case PROP_JPEG_QUALITY:
+      src->jpeg_quality = g_value_get_int(value);
+      break;
+    case PROP_ENCODE_THREADS:
+      src->encode_threads = g_value_get_uint(value);
+      break;
+    case PROP_PRIORITY:
+      src->priority = static_cast<RsTaskPriority>(g_value_get_int(value));
+      if (src->workers)
+        src->workers->set_priority(src->priority);
+      break;
+    case PROP_RECORD_FILE:
+      g_free(src->record_file);
+      src->record_file = g_value_dup_string(value);
+      break;
+    case PROP_RECORD_LEVEL:
+      src->record_level = g_value_get_int(value);
+      break;
+    case PROP_PYRAMID_LEVELS:
+      src->pyramid_levels = g_value_get_int(value);
+      break;
+    case PROP_PYRAMID_DEPTH_FILTER:
+      src->pyramid_depth_filter = static_cast<RsPyramidDepthFilter>(g_value_get_int(value));
+      break;
+    case PROP_DEPTH_MASK:
+      src->depth_mask = g_value_get_boolean(value);
+      break;
+    case PROP_MAX_MEMORY:
+      src->max_memory = g_value_get_uint64(value);
+      break;
+    case PROP_ADAPTIVE:
+      src->adaptive = g_value_get_boolean(value);
+      break;
+    case PROP_HOLE_FILL:
+      src->hole_fill = static_cast<RsHoleFill>(g_value_get_int(value));
+      break;
+    case PROP_LATENCY_META:
+      src->latency_meta = g_value_get_boolean(value);
+      break;
+    case PROP_PLAYBACK_FILE:
+      g_free(src->playback_file);
+      src->playback_file = g_value_dup_string(value);
+      break;
+    case PROP_SYNTHETIC:
+      src->synthetic = g_value_get_boolean(value);
+      break;
+    case PROP_DEPTH_UNITS:
+      src->depth_units = g_value_get_float(value);
+      break;
+    case PROP_ALIGN_SCALE:
+      src->align_scale = g_value_get_float(value);
+      break;
+    case PROP_UNDISTORT:
+      src->undistort = g_value_get_boolean(value);
+      break;
+    case PROP_FLOOR_PLANE:
+      src->floor_plane = g_value_get_boolean(value);
+      break;
+    case PROP_FLOOR_BUDGET:
+      src->floor_budget = g_value_get_uint(value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -345,6 +805,68 @@ gst_realsense_src_set_property (GObject * object, guint prop_id, const GValue *
   }
 }
 
+static GstStructure *
+gst_realsense_src_create_stats (GstRealsenseSrc * src)
+{
+  guint64 arena_capacity = 0, arena_high_water = 0, arena_overflows = 0;
+  guint64 record_frames = 0, record_drops = 0, record_bytes = 0;
+
+  // The counters are atomics; the lock keeps the arena and recorder from
+  // being replaced while they are read
+  GST_OBJECT_LOCK (src);
+  if (src->arena) {
+    arena_capacity = src->arena->capacity();
+    arena_high_water = src->arena->high_water();
+    arena_overflows = src->arena->overflows();
+  }
+  if (src->recorder) {
+    record_frames = src->recorder->written();
+    record_drops = src->recorder->dropped();
+    record_bytes = src->recorder->bytes();
+  }
+  GstStructure *s = gst_structure_new ("application/x-realsensesrc-stats",
+      "frames", G_TYPE_UINT64, (guint64) src->frame_count.load(std::memory_order_relaxed),
+      "arena-capacity", G_TYPE_UINT64, arena_capacity,
+      "arena-high-water", G_TYPE_UINT64, arena_high_water,
+      "arena-overflows", G_TYPE_UINT64, arena_overflows,
+      "inflight-color", G_TYPE_INT, g_atomic_int_get(&src->inflight_color),
+      "zero-copy-frames", G_TYPE_UINT64, (guint64) src->zero_copy_frames.load(std::memory_order_relaxed),
+      "copy-fallbacks", G_TYPE_UINT64, (guint64) src->copy_fallbacks.load(std::memory_order_relaxed),
+      "inflight-drops", G_TYPE_UINT64, (guint64) src->inflight_drops.load(std::memory_order_relaxed),
+      "record-frames", G_TYPE_UINT64, record_frames,
+      "record-drops", G_TYPE_UINT64, record_drops,
+      "record-bytes", G_TYPE_UINT64, record_bytes,
+      "memory-bytes", G_TYPE_UINT64, (guint64) src->memory->total(),
+      "memory-peak", G_TYPE_UINT64, (guint64) src->memory->peak(),
+      "memory-limit", G_TYPE_UINT64, src->memory_limit,
+      "memory-drops", G_TYPE_UINT64, (guint64) src->memory_drops.load(std::memory_order_relaxed),
+      NULL);
+  for (int kind = 0; kind < RsMemKindCount; ++kind) {
+    gchar *field = g_strdup_printf ("memory-%s", RsMemoryAccount::kind_name ((RsMemoryKind) kind));
+    gst_structure_set (s, field, G_TYPE_UINT64, (guint64) src->memory->get ((RsMemoryKind) kind), NULL);
+    g_free (field);
+  }
+  GST_OBJECT_UNLOCK (src);
+
+  return s;
+}
+
+static const char *const startup_phase_fields[StartupPhaseCount] = {
+  "context-us", "query-devices-us", "advanced-mode-us", "load-preset-us", "setup-us",
+  "pipeline-start-us", "configure-us", "first-frame-us", "total-us"
+};
+
+static GstStructure *
+gst_realsense_src_create_startup_stats (GstRealsenseSrc * src)
+{
+  GstStructure *s = gst_structure_new_empty ("realsense-startup");
+  GST_OBJECT_LOCK (src);
+  for (int phase = 0; phase < StartupPhaseCount; ++phase)
+    gst_structure_set (s, startup_phase_fields[phase], G_TYPE_INT64, src->startup[phase], NULL);
+  GST_OBJECT_UNLOCK (src);
+  return s;
+}
+
 static void
 gst_realsense_src_get_property (GObject * object, guint prop_id, GValue * value, GParamSpec * pspec)
 {
@@ -375,12 +897,108 @@ gst_realsense_src_get_property (GObject * object, guint prop_id, GValue * value,
     case PROP_PRESET_FILE:
       g_value_set_string(value, src->preset_file);
       break;
+    case PROP_STATS:
+      g_value_take_boxed(value, gst_realsense_src_create_stats(src));
+      break;
+    case PROP_ZERO_COPY:
+      g_value_set_boolean(value, src->zero_copy);
+      break;
+    case PROP_MAX_INFLIGHT:
+      g_value_set_uint(value, src->max_inflight);
+      break;
+    case PROP_INFLIGHT_POLICY:
+      g_value_set_int(value, src->inflight_policy);
+      break;
+    case PROP_OUTPUT_FORMAT:
+      g_value_set_int(value, src->output_format);
+      break;
+    case PROP_JPEG_QUALITY:
+      g_value_set_int(value, src->jpeg_quality);
+      break;
+    case PROP_ENCODE_THREADS:
+      g_value_set_uint(value, src->encode_threads);
+      break;
+    case PROP_PRIORITY:
+      g_value_set_int(value, static_cast<gint>(src->priority));
+      break;
+    case PROP_RECORD_FILE:
+      g_value_set_string(value, src->record_file);
+      break;
+    case PROP_RECORD_LEVEL:
+      g_value_set_int(value, src->record_level);
+      break;
+    case PROP_PYRAMID_LEVELS:
+      g_value_set_int(value, src->pyramid_levels);
+      break;
+    case PROP_PYRAMID_DEPTH_FILTER:
+      g_value_set_int(value, src->pyramid_depth_filter);
+      break;
+    case PROP_DEPTH_MASK:
+      g_value_set_boolean(value, src->depth_mask);
+      break;
+    case PROP_MAX_MEMORY:
+      g_value_set_uint64(value, src->max_memory);
+      break;
+    case PROP_ADAPTIVE:
+      g_value_set_boolean(value, src->adaptive);
+      break;
+    case PROP_HOLE_FILL:
+      g_value_set_int(value, static_cast<gint>(src->hole_fill));
+      break;
+    case PROP_LATENCY_META:
+      g_value_set_boolean(value, src->latency_meta);
+      break;
+    case PROP_PLAYBACK_FILE:
+      g_value_set_string(value, src->playback_file);
+      break;
+    case PROP_SYNTHETIC:
+      g_value_set_boolean(value, src->synthetic);
+      break;
+    case PROP_STARTUP_STATS:
+      g_value_take_boxed(value, gst_realsense_src_create_startup_stats(src));
+      break;
+    case PROP_DEPTH_UNITS:
+      g_value_set_float(value, src->depth_units);
+      break;
+    case PROP_DEPTH_SCALE:
+      g_value_set_float(value, src->depth_scale);
+      break;
+    case PROP_ALIGN_SCALE:
+      g_value_set_float(value, src->align_scale);
+      break;
+    case PROP_UNDISTORT:
+      g_value_set_boolean(value, src->undistort);
+      break;
+    case PROP_FLOOR_PLANE:
+      g_value_set_boolean(value, src->floor_plane);
+      break;
+    case PROP_FLOOR_BUDGET:
+      g_value_set_uint(value, src->floor_budget);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
   }
 }
 
+static GArray *
+gst_realsense_src_get_distances (GstRealsenseSrc * src, GArray * points, gboolean color_space)
+{
+  g_return_val_if_fail (points != NULL, NULL);
+  g_return_val_if_fail (g_array_get_element_size (points) == sizeof (gfloat), NULL);
+
+  const guint n_points = points->len / 2;
+  GArray *metres = g_array_sized_new (FALSE, TRUE, sizeof (gfloat), n_points);
+  g_array_set_size (metres, n_points);
+
+  if (!src->depth_query->query (reinterpret_cast<const float *>(points->data), n_points,
+          color_space, reinterpret_cast<float *>(metres->data))) {
+    g_array_unref (metres);
+    return NULL;
+  }
+  return metres;
+}
+
 static gboolean
 gst_realsense_src_unlock (GstBaseSrc * basesrc)
 {
@@ -405,11 +1023,46 @@ gst_realsense_src_unlock_stop (GstBaseSrc * basesrc)
   return TRUE;
 }
 
+static gboolean
+gst_realsense_src_event (GstBaseSrc * basesrc, GstEvent * event)
+{
+  GstRealsenseSrc *src = GST_REALSENSESRC (basesrc);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_QOS && src->adaptive_ctl) {
+    GstQOSType type;
+    gdouble proportion;
+    GstClockTimeDiff diff;
+    GstClockTime timestamp;
+
+    gst_event_parse_qos (event, &type, &proportion, &diff, &timestamp);
+    src->adaptive_ctl->observe_qos (proportion, g_get_monotonic_time ());
+  }
+
+  return GST_BASE_SRC_CLASS (gst_realsense_src_parent_class)->event (basesrc, event);
+}
+
 static gboolean
 gst_realsense_src_stop (GstBaseSrc * basesrc)
 {
   auto *src = GST_REALSENSESRC (basesrc);
    GST_TRACE_OBJECT(src, "gst_realsense_src_stop");
+  // The mode properties go back to what was configured, not the last rung
+  if (src->adaptive_ctl && src->adaptive_ctl->rung() != 0) {
+    const RsLadderRung &top = src->adaptive_ctl->ladder()[0];
+    src->color_width = top.color.width;
+    src->color_height = top.color.height;
+    src->color_fps = top.color.fps;
+    src->depth_width = top.depth.width;
+    src->depth_height = top.depth.height;
+    src->depth_fps = top.depth.fps;
+  }
+  if (src->latency_probe) {
+    gst_pad_remove_probe(GST_BASE_SRC_PAD(src), src->latency_probe);
+    src->latency_probe = 0;
+  }
+  if (src->arena)
+    GST_INFO_OBJECT(src, "Scratch arena high-water %zu of %zu bytes, %" G_GUINT64_FORMAT " overflows",
+        src->arena->high_water(), src->arena->capacity(), (guint64) src->arena->overflows());
   gst_realsense_src_reset(src); 
   return TRUE;
 }
@@ -449,6 +1102,11 @@ gst_realsense_src_set_caps(GstBaseSrc *bsrc, GstCaps *caps)
 
   GST_DEBUG_OBJECT(src, "The caps being set are %" GST_PTR_FORMAT, caps);
 
+  if (gst_structure_has_name(gst_caps_get_structure(caps, 0), "image/jpeg"))
+    return src->output_format == OutputJpeg;
+  if (gst_structure_has_name(gst_caps_get_structure(caps, 0), "application/x-realsense-sparse-depth"))
+    return src->output_format == OutputSparse;
+
   if (!gst_video_info_from_caps(&vinfo, caps)) {
     GST_ERROR_OBJECT(src, "Failed to parse video info from caps");
     return FALSE;
@@ -461,6 +1119,34 @@ gst_realsense_src_set_caps(GstBaseSrc *bsrc, GstCaps *caps)
   }
 
   src->gst_stride = GST_VIDEO_INFO_COMP_STRIDE(&vinfo, 0);
+  src->info = vinfo;
+
+  // Aligned and guided depth share the output size; unaligned depth of
+  // another size is resampled onto the color grid by the kernel itself
+  const gint out_width = GST_VIDEO_INFO_WIDTH(&vinfo);
+  const gint out_height = GST_VIDEO_INFO_HEIGHT(&vinfo) / 2;
+  const bool resample = src->align == Align::None &&
+      (src->depth_width != out_width || src->depth_height != out_height);
+
+  const RSMux::DepthEncoding encoding =
+      src->depth_mask ? RSMux::DepthEncoding::DecimalMask : RSMux::DepthEncoding::Decimal;
+  src->depth_kernel = rs_mux_depth_kernel(encoding, resample, src->hole_fill);
+  if (!src->depth_kernel) {
+    GST_ERROR_OBJECT(src, "No depth kernel for this configuration");
+    return FALSE;
+  }
+  src->depth_encoding = encoding;
+  src->depth_resampled = resample;
+  src->depth_kernel_fill = src->hole_fill;
+  src->depth_in_width = resample ? src->depth_width : out_width;
+  src->depth_in_height = resample ? src->depth_height : out_height;
+  if (resample) {
+    if (!src->depth_resample)
+      src->depth_resample = std::make_unique<RsDepthResample>();
+    src->depth_resample->init(src->depth_width, src->depth_height, out_width, out_height);
+    GST_INFO_OBJECT(src, "Resampling %dx%d depth to %dx%d", src->depth_width,
+        src->depth_height, out_width, out_height);
+  }
 
   return TRUE;
 }
@@ -492,11 +1178,91 @@ void gst_realsense_src_finalize(GObject *object) {
         gst_caps_unref(src->caps);
         src->caps = NULL;
     }
+    gst_realsense_src_clear_pool(&src->out_pool);
+    gst_realsense_src_clear_pool(&src->pyramid_pool);
+    src->jpeg_encoder.reset();
+    src->recorder.reset();
+    src->depth_encoder.reset();
+    src->workers.reset();
+    src->depth_resample.reset();
+    src->reprojector.reset();
+    src->guided.reset();
+    src->undistorter.reset();
+    src->floor_estimator.reset();
+    src->depth_query.reset();
+    src->adaptive_ctl.reset();
+    src->memory.reset();
+    if (src->metrics) {
+        RsMetricsRegistry::get().remove(src->metrics);
+        src->metrics.reset();
+    }
+    g_free(src->record_file);
+    src->record_file = NULL;
+    g_free(src->playback_file);
+    src->playback_file = NULL;
+    src->arena.reset();
 
     G_OBJECT_CLASS(gst_realsense_src_parent_class)->finalize(object);
 }
 
 
+/* Sizes the librealsense frame queues, the pools and the recorder queue to
+ * fit max-memory and records the bytes of the parts that are not counted
+ * as they are allocated. Pools must be created after this. */
+static void
+gst_realsense_src_plan_memory (GstRealsenseSrc * src, size_t pyramid_size)
+{
+  const uint64_t color_bytes = static_cast<uint64_t>(src->color_width) * src->color_height * 3;
+  const uint64_t depth_bytes = static_cast<uint64_t>(src->depth_width) * src->depth_height * sizeof(uint16_t);
+  uint64_t align_bytes = 0;
+  if (src->reproject_color)
+    align_bytes = 0; // both output planes live in the arena
+  else if (src->align == Align::Color)
+    align_bytes = static_cast<uint64_t>(src->color_width) * src->color_height * sizeof(uint16_t);
+  else if (src->align == Align::Depth)
+    align_bytes = static_cast<uint64_t>(src->depth_width) * src->depth_height * 3;
+  else if (src->guided)
+    align_bytes = src->guided->memory();
+  if (src->undistorter)
+    align_bytes += src->undistorter->memory();
+  if (src->floor_estimator)
+    align_bytes += src->floor_estimator->memory();
+  const uint64_t record_bytes = src->recorder ? src->depth_encoder->max_size() : 0;
+
+  const RsMemoryPlan plan = rs_memory_plan(src->max_memory, src->arena->capacity() + align_bytes,
+      color_bytes + depth_bytes, src->out_framesize + pyramid_size, record_bytes);
+  if (!plan.fits)
+    GST_ELEMENT_WARNING(src, RESOURCE, SETTINGS,
+        ("max-memory of %" G_GUINT64_FORMAT " bytes is below the %" G_GUINT64_FORMAT
+         " bytes this configuration needs with the smallest queues and pools.",
+         src->max_memory, (guint64) plan.bytes), (NULL));
+  src->pool_buffers = plan.pool_buffers;
+  src->memory_limit = src->max_memory ? MAX(src->max_memory, plan.bytes) : 0;
+  src->planned_arena = src->arena->capacity();
+
+  // Each sensor queues up to this many of its own frames
+  float frame_queue = 0;
+  for (auto &&sensor : src->rs_pipeline->get_active_profile().get_device().query_sensors()) {
+    if (!sensor.supports(RS2_OPTION_FRAMES_QUEUE_SIZE))
+      continue;
+    if (plan.frame_queue >= 0)
+      sensor.set_option(RS2_OPTION_FRAMES_QUEUE_SIZE, plan.frame_queue);
+    frame_queue = MAX(frame_queue, sensor.get_option(RS2_OPTION_FRAMES_QUEUE_SIZE));
+  }
+
+  if (src->recorder)
+    src->recorder->set_max_queued(plan.recorder_queue);
+
+  src->memory->set(RsMemFrameQueue, static_cast<int64_t>(frame_queue) * (color_bytes + depth_bytes));
+  src->memory->set(RsMemAlign, align_bytes);
+  src->memory->set(RsMemArena, src->arena->capacity());
+  src->memory->set(RsMemRecorder, src->recorder ? (plan.recorder_queue + 1) * record_bytes : 0);
+
+  GST_INFO_OBJECT(src, "Memory plan: frame queue %d, %u pool buffers, recorder queue %zu, "
+      "%" G_GUINT64_FORMAT " bytes (limit %" G_GUINT64_FORMAT ")", (gint) frame_queue,
+      src->pool_buffers, plan.recorder_queue, (guint64) plan.bytes, src->memory_limit);
+}
+
 static gboolean gst_realsense_src_calculate_caps(GstRealsenseSrc *src) {
     GST_TRACE_OBJECT(src, "gst_realsense_src_calculate_caps");
 
@@ -510,23 +1276,115 @@ static gboolean gst_realsense_src_calculate_caps(GstRealsenseSrc *src) {
             frame_set = src->aligner->process(frame_set);
 
         auto cframe = frame_set.get_color_frame();
-        width = cframe.get_width();
-        height = cframe.get_height() * 2; // top (color) + bottom (depth encoded)
-
-        // Set RGB format for CPU buffer
-        GstVideoFormat fmt = GST_VIDEO_FORMAT_RGB;
+        auto dframe = frame_set.get_depth_frame();
+
+        // Output planes: color, reduced to the alignment grid with
+        // align-scale; depth upsampled (align=3) or reprojected onto it
+        const gint color_w = rs_downscale_size(cframe.get_width(), src->align_divisor);
+        const gint color_h = rs_downscale_size(cframe.get_height(), src->align_divisor);
+        const bool depth_on_color = src->guided || src->reproject_color;
+        const gint depth_w = depth_on_color ? color_w : dframe.get_width();
+        const gint depth_h = depth_on_color ? color_h : dframe.get_height();
+
+        width = color_w;
+        height = color_h * 2; // top (color) + bottom (depth encoded)
+
+        if (src->recorder) {
+            if (!src->depth_encoder)
+                src->depth_encoder = std::make_unique<RsDepthEncoder>();
+            // Two bands per worker keeps the slowest band short
+            if (!src->depth_encoder->init(depth_w, depth_h,
+                    src->record_level, src->workers->size() * 2)) {
+                GST_ELEMENT_ERROR(src, RESOURCE, SETTINGS,
+                    ("Failed to set up depth recording: %s", src->depth_encoder->last_error().c_str()), (NULL));
+                return FALSE;
+            }
+        }
 
-        gst_video_info_init(&vinfo);
-        gst_video_info_set_format(&vinfo, fmt, width, height);
-        vinfo.fps_n = 30;
-        vinfo.fps_d = 1;
+        // Pyramid levels of both planes share one pooled buffer per frame
+        size_t pyramid_size = 0;
+        src->pyramid_built_levels = 0;
+        if (src->pyramid_levels > 0 && src->output_format == OutputMux) {
+            src->pyramid_built_levels = rs_pyramid_layout(color_w, color_h, depth_w, depth_h, src->pyramid_levels, src->pyramid, &pyramid_size);
+            if (src->pyramid_built_levels < src->pyramid_levels)
+                GST_WARNING_OBJECT(src, "Only %d of %d pyramid levels fit the frame size",
+                    src->pyramid_built_levels, src->pyramid_levels);
+        }
 
-        if (src->caps)
+        if (src->caps) {
             gst_caps_unref(src->caps);
+            src->caps = NULL;
+        }
+
+        if (src->output_format != OutputMux) {
+            if (src->output_format == OutputJpeg) {
+                height = color_h;
 
-        src->caps = gst_video_info_to_caps(&vinfo);
+                if (!src->jpeg_encoder)
+                    src->jpeg_encoder = std::make_unique<RsJpegEncoder>();
+                if (!src->jpeg_encoder->init(width, height, src->jpeg_quality, src->workers->size())) {
+                    GST_ELEMENT_ERROR(src, STREAM, ENCODE,
+                        ("Failed to set up JPEG encoder: %s", src->jpeg_encoder->last_error().c_str()), (NULL));
+                    return FALSE;
+                }
+
+                src->caps = gst_caps_new_simple("image/jpeg",
+                    "width", G_TYPE_INT, (gint) width,
+                    "height", G_TYPE_INT, (gint) height,
+                    "framerate", GST_TYPE_FRACTION, src->color_fps, 1,
+                    NULL);
+                src->out_framesize = src->jpeg_encoder->max_size();
+            } else {
+                // Points are in the coordinates of the (aligned or upsampled) depth
+                width = depth_w;
+                height = depth_h;
+
+                src->caps = gst_caps_new_simple("application/x-realsense-sparse-depth",
+                    "width", G_TYPE_INT, (gint) width,
+                    "height", G_TYPE_INT, (gint) height,
+                    "framerate", GST_TYPE_FRACTION, src->depth_fps, 1,
+                    "depth-scale", G_TYPE_DOUBLE, (gdouble) src->depth_scale,
+                    NULL);
+                src->out_framesize = rs_sparse_max_size(width, height);
+            }
+        } else {
+            // Set RGB format for CPU buffer
+            GstVideoFormat fmt = GST_VIDEO_FORMAT_RGB;
+
+            gst_video_info_init(&vinfo);
+            gst_video_info_set_format(&vinfo, fmt, width, height);
+            vinfo.fps_n = src->color_fps;
+            vinfo.fps_d = 1;
+
+            src->caps = gst_video_info_to_caps(&vinfo);
+            src->out_framesize = GST_VIDEO_INFO_SIZE(&vinfo);
+
+            // Encoded depth is in device units; consumers scale with these
+            gst_caps_set_simple(src->caps,
+                "depth-scale", G_TYPE_DOUBLE, (gdouble) src->depth_scale,
+                "depth-max", G_TYPE_DOUBLE, (gdouble) src->depth_scale * RSMux::DECIMAL_MAX_DEPTH,
+                NULL);
+        }
+
+        // Queue depths and pool sizes within max-memory; output buffers of
+        // the worst-case size are recycled through the pools
+        gst_realsense_src_plan_memory(src, pyramid_size);
+
+        gst_realsense_src_clear_pool(&src->out_pool);
+        src->out_pool = gst_realsense_src_new_pool(src, src->caps, src->out_framesize);
+        if (!src->out_pool) {
+            GST_ELEMENT_ERROR(src, RESOURCE, FAILED, ("Failed to activate output buffer pool"), (NULL));
+            return FALSE;
+        }
+        gst_realsense_src_clear_pool(&src->pyramid_pool);
+        if (src->pyramid_built_levels > 0) {
+            src->pyramid_pool = gst_realsense_src_new_pool(src, NULL, pyramid_size);
+            if (!src->pyramid_pool) {
+                GST_ELEMENT_ERROR(src, RESOURCE, FAILED, ("Failed to activate pyramid buffer pool"), (NULL));
+                return FALSE;
+            }
+        }
 
-        src->out_framesize = GST_VIDEO_INFO_SIZE(&vinfo);
         gst_base_src_set_blocksize(GST_BASE_SRC(src), src->out_framesize);
         gst_base_src_set_caps(GST_BASE_SRC(src), src->caps);
 
@@ -544,7 +1402,349 @@ static gboolean gst_realsense_src_calculate_caps(GstRealsenseSrc *src) {
 }
 
 
-static GstFlowReturn gst_realsense_src_create(GstPushSrc* psrc, GstBuffer** buf) {
+/* Keeps an rs2::frame alive for as long as a GstMemory wraps its data */
+struct RsFrameRef
+{
+  rs2::frame frame;
+  GstRealsenseSrc *src;
+  gsize size;
+};
+
+static void
+rs_frame_ref_free (gpointer data)
+{
+  auto *ref = static_cast<RsFrameRef *>(data);
+  g_atomic_int_add (&ref->src->inflight_color, -1);
+  ref->src->memory->add (RsMemDownstream, -(int64_t) ref->size);
+  gst_object_unref (ref->src);
+  delete ref;
+}
+
+static GstMemory *
+gst_realsense_src_wrap_frame (GstRealsenseSrc * src, const rs2::frame & frame)
+{
+  const gsize size = frame.get_data_size();
+  auto *ref = new RsFrameRef { frame, GST_REALSENSESRC (gst_object_ref (src)), size };
+
+  g_atomic_int_inc (&src->inflight_color);
+  src->memory->add (RsMemDownstream, size);
+  return gst_memory_new_wrapped (GST_MEMORY_FLAG_READONLY,
+      const_cast<void *>(frame.get_data()), size, 0, size, ref, rs_frame_ref_free);
+}
+
+/* Heap block charged to the memory account until its GstMemory is freed.
+ * alloc_accounted returns NULL when the allocation fails. */
+struct RsAccountedBlock
+{
+  rs_memory_ptr memory;
+  gpointer data;
+  gsize size;
+};
+
+static void
+rs_accounted_block_free (gpointer data)
+{
+  auto *block = static_cast<RsAccountedBlock *>(data);
+  block->memory->add (RsMemDownstream, -(int64_t) block->size);
+  g_free (block->data);
+  delete block;
+}
+
+static GstMemory *
+gst_realsense_src_alloc_accounted (GstRealsenseSrc * src, gsize size)
+{
+  gpointer data = g_try_malloc (size);
+  if (!data)
+    return NULL;
+  auto *block = new RsAccountedBlock { src->memory, data, size };
+
+  src->memory->add (RsMemDownstream, size);
+  return gst_memory_new_wrapped ((GstMemoryFlags) 0, block->data, size, 0, size, block,
+      rs_accounted_block_free);
+}
+
+/* Color as it goes into the output: the color frame, or with align-scale
+ * its reduction to the alignment grid */
+struct ColorPlane
+{
+  const guint8 *data;
+  size_t stride;
+  gint width;
+  gint height;
+};
+
+static ColorPlane
+gst_realsense_src_color_plane (GstRealsenseSrc * src, const rs2::video_frame & cframe)
+{
+  const auto *data = static_cast<const guint8 *>(cframe.get_data());
+  const size_t stride = cframe.get_stride_in_bytes();
+  const gint width = cframe.get_width(), height = cframe.get_height();
+  if (src->align_divisor == 1)
+    return { data, stride, width, height };
+
+  const gint out_w = rs_downscale_size(width, src->align_divisor);
+  const gint out_h = rs_downscale_size(height, src->align_divisor);
+  auto *reduced = src->arena->alloc_array<guint8>(static_cast<size_t>(out_w) * out_h * 3);
+  rs_downscale_rgb(data, stride, width, height, src->align_divisor, reduced, out_w * 3,
+      src->workers.get());
+  return { reduced, out_w * 3u, out_w, out_h };
+}
+
+/* Undistort the color plane into arena memory valid for this frame */
+static ColorPlane
+gst_realsense_src_undistort_color (GstRealsenseSrc * src, const ColorPlane & color)
+{
+  auto *out = src->arena->alloc_array<guint8>(static_cast<size_t>(color.width) * color.height * 3);
+  src->undistorter->remap(color.data, color.stride, out, color.width * 3, src->workers.get());
+  return { out, color.width * 3u, color.width, color.height };
+}
+
+/* Compress the color frame into a recycled buffer from the output pool */
+static GstFlowReturn
+gst_realsense_src_fill_jpeg (GstRealsenseSrc * src, const ColorPlane & color, GstBuffer ** buf)
+{
+  GstMapInfo minfo;
+
+  const GstFlowReturn ret = gst_realsense_src_acquire (src, src->out_pool, buf);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  if (!gst_buffer_map (*buf, &minfo, GST_MAP_WRITE)) {
+    GST_ELEMENT_ERROR (src, RESOURCE, FAILED, ("Failed to map buffer for writing"), (NULL));
+    gst_buffer_unref (*buf);
+    *buf = NULL;
+    return GST_FLOW_ERROR;
+  }
+
+  const size_t size = src->jpeg_encoder->encode (
+      color.data, color.stride, minfo.data, minfo.size, src->workers.get());
+  gst_buffer_unmap (*buf, &minfo);
+
+  if (size == 0) {
+    GST_ELEMENT_ERROR (src, STREAM, ENCODE,
+        ("JPEG encoding failed: %s", src->jpeg_encoder->last_error().c_str()), (NULL));
+    gst_buffer_unref (*buf);
+    *buf = NULL;
+    return GST_FLOW_ERROR;
+  }
+
+  gst_buffer_set_size (*buf, size);
+  return GST_FLOW_OK;
+}
+
+/* Depth as it goes into the output: aligned, reprojected or upsampled */
+struct DepthPlane
+{
+  const uint16_t *data;
+  size_t stride;
+  gint width;
+  gint height;
+};
+
+static DepthPlane
+gst_realsense_src_depth_plane (const rs2::depth_frame & depth)
+{
+  return { static_cast<const uint16_t *>(depth.get_data()),
+      static_cast<size_t>(depth.get_stride_in_bytes()), depth.get_width(), depth.get_height() };
+}
+
+/* Reproject depth onto the coarse color grid and upsample it guided by the
+ * color frame, into arena memory valid for this frame */
+static DepthPlane
+gst_realsense_src_upsample_depth (GstRealsenseSrc * src, const ColorPlane & color,
+    const rs2::depth_frame & depth)
+{
+  const RsReprojector &reprojector = *src->reprojector;
+  const size_t low_stride = reprojector.width() * sizeof(uint16_t);
+  auto *low = src->arena->alloc_array<uint16_t>(static_cast<size_t>(reprojector.width()) * reprojector.height());
+  reprojector.project(static_cast<const uint16_t *>(depth.get_data()), depth.get_stride_in_bytes(),
+      low, low_stride, src->workers.get());
+
+  const gint width = color.width, height = color.height;
+  auto *dense = src->arena->alloc_array<uint16_t>(static_cast<size_t>(width) * height);
+  src->guided->upsample(low, low_stride, color.data, color.stride, dense,
+      width * sizeof(uint16_t), src->workers.get());
+  return { dense, width * sizeof(uint16_t), width, height };
+}
+
+/* Reproject depth onto the reduced color grid of align-scale, into arena
+ * memory valid for this frame */
+static DepthPlane
+gst_realsense_src_reproject_depth (GstRealsenseSrc * src, const rs2::depth_frame & depth)
+{
+  const RsReprojector &reprojector = *src->reprojector;
+  const size_t stride = reprojector.width() * sizeof(uint16_t);
+  auto *out = src->arena->alloc_array<uint16_t>(static_cast<size_t>(reprojector.width()) * reprojector.height());
+  reprojector.project(static_cast<const uint16_t *>(depth.get_data()), depth.get_stride_in_bytes(),
+      out, stride, src->workers.get());
+  return { out, stride, reprojector.width(), reprojector.height() };
+}
+
+/* Compress the depth plane on the worker pool and queue it for the recorder */
+static void
+gst_realsense_src_record_depth (GstRealsenseSrc * src, const DepthPlane & depth, GstClockTime pts)
+{
+  auto frame = src->recorder->take_spare();
+  if (frame.size() < src->depth_encoder->max_size())
+    frame.resize(src->depth_encoder->max_size());
+
+  const size_t size = src->depth_encoder->encode(depth.data, depth.stride, frame.data(),
+      frame.size(), src->arena.get(), src->workers.get());
+  if (size == 0) {
+    GST_WARNING_OBJECT(src, "Depth compression failed: %s",
+        src->depth_encoder->last_error().c_str());
+    src->recorder->give_spare(std::move(frame));
+    return;
+  }
+
+  if (!src->recorder->push(pts, std::move(frame), size))
+    GST_LOG_OBJECT(src, "Recorder queue full, depth frame dropped");
+}
+
+/* Compact the valid depth pixels into a pooled buffer */
+static GstFlowReturn
+gst_realsense_src_fill_sparse (GstRealsenseSrc * src, const DepthPlane & depth, GstBuffer ** buf)
+{
+  GstMapInfo minfo;
+
+  const GstFlowReturn ret = gst_realsense_src_acquire (src, src->out_pool, buf);
+  if (ret != GST_FLOW_OK)
+    return ret;
+
+  if (!gst_buffer_map (*buf, &minfo, GST_MAP_WRITE)) {
+    GST_ELEMENT_ERROR (src, RESOURCE, FAILED, ("Failed to map buffer for writing"), (NULL));
+    gst_buffer_unref (*buf);
+    *buf = NULL;
+    return GST_FLOW_ERROR;
+  }
+
+  const size_t size = rs_sparse_compact (depth.data, depth.stride, depth.width, depth.height,
+      minfo.data, src->workers.get());
+  gst_buffer_unmap (*buf, &minfo);
+
+  gst_buffer_set_size (*buf, size);
+  return GST_FLOW_OK;
+}
+
+/* Encode the depth frame into an output plane with the kernel picked in set_caps */
+static gboolean
+gst_realsense_src_encode_depth (GstRealsenseSrc * src, const DepthPlane & depth, guint8 * out)
+{
+  if (depth.width != src->depth_in_width || depth.height != src->depth_in_height) {
+    GST_ELEMENT_ERROR(src, STREAM, FAILED,
+        ("Depth frame is %dx%d, expected %dx%d", depth.width, depth.height,
+         src->depth_in_width, src->depth_in_height), (NULL));
+    return FALSE;
+  }
+
+  // hole-fill may change while playing; the kernel has it built in
+  const RsHoleFill hole_fill = src->hole_fill;
+  if (hole_fill != src->depth_kernel_fill) {
+    src->depth_kernel = rs_mux_depth_kernel(src->depth_encoding, src->depth_resampled, hole_fill);
+    src->depth_kernel_fill = hole_fill;
+  }
+
+  RsMuxDepthArgs args;
+  args.depth = depth.data;
+  args.depth_stride = depth.stride;
+  args.out = out;
+  args.out_stride = src->gst_stride;
+  args.width = GST_VIDEO_INFO_WIDTH(&src->info);
+  args.height = GST_VIDEO_INFO_HEIGHT(&src->info) / 2;
+  args.n_bands = rs_mux_depth_bands(src->workers.get(), args.height);
+  args.pool = src->workers.get();
+  args.resample = src->depth_resample.get();
+  args.scratch_rows = src->depth_resampled
+      ? src->arena->alloc_array<uint16_t>(static_cast<size_t>(args.n_bands) * args.width) : nullptr;
+  args.depth_width = depth.width;
+  args.depth_height = depth.height;
+  args.fill_rows = hole_fill != RsHoleFill::Off
+      ? src->arena->alloc_array<uint16_t>(static_cast<size_t>(args.n_bands) * args.depth_width)
+      : nullptr;
+  src->depth_kernel(args);
+  return TRUE;
+}
+
+/* Build the color/depth pyramid into a pooled buffer and attach it as meta */
+static void
+gst_realsense_src_attach_pyramid (GstRealsenseSrc * src, const ColorPlane & color,
+    const DepthPlane & depth, GstBuffer * buf)
+{
+  GstBuffer *levels;
+  GstMapInfo minfo;
+
+  // Under max-memory a frame goes out without pyramid rather than waiting
+  if (gst_realsense_src_acquire (src, src->pyramid_pool, &levels) != GST_FLOW_OK)
+    return;
+  if (!gst_buffer_map (levels, &minfo, GST_MAP_WRITE)) {
+    gst_buffer_unref (levels);
+    return;
+  }
+
+  rs_pyramid_build (color.data, color.stride,
+      depth.data, depth.stride, src->pyramid, src->pyramid_built_levels, src->pyramid_depth_filter,
+      minfo.data, src->workers.get());
+  gst_buffer_unmap (levels, &minfo);
+
+  gst_buffer_add_realsense_pyramid_meta (buf, levels, src->pyramid, src->pyramid_built_levels);
+  gst_buffer_unref (levels);
+}
+
+/* Fit the floor plane to the output depth plane and attach it as meta */
+static void
+gst_realsense_src_attach_floor (GstRealsenseSrc * src, const DepthPlane & depth, GstBuffer * buf)
+{
+  const RsFloorPlane floor = src->floor_estimator->estimate(depth.data, depth.stride,
+      src->floor_budget, src->workers.get());
+  GstRealsenseFloorMeta *fmeta = gst_buffer_add_realsense_floor_meta (buf);
+  if (!fmeta)
+    return;
+
+  fmeta->found = floor.valid;
+  fmeta->samples = floor.samples;
+  fmeta->hypotheses = floor.hypotheses;
+  if (floor.valid) {
+    std::copy (floor.normal, floor.normal + 3, fmeta->plane);
+    fmeta->plane[3] = floor.distance;
+    fmeta->inlier_ratio = floor.inlier_ratio;
+  }
+}
+
+/* Last stage of the latency meta, right before the peer gets the buffer */
+static GstPadProbeReturn
+gst_realsense_src_stamp_pushed (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstRealsenseLatencyMeta *lmeta =
+      gst_buffer_get_realsense_latency_meta (GST_PAD_PROBE_INFO_BUFFER (info));
+  if (lmeta)
+    lmeta->pushed = gst_realsense_latency_now ();
+  return GST_PAD_PROBE_OK;
+}
+
+/* Stage times are g_get_monotonic_time() values taken in create() */
+static void
+gst_realsense_src_attach_latency (GstRealsenseSrc * src, const rs2::frame & cframe,
+    gint64 t_arrival, gint64 t_aligned, gint64 t_encoded, GstBuffer * buf)
+{
+  GstRealsenseLatencyMeta *lmeta = gst_buffer_add_realsense_latency_meta (buf);
+  if (!lmeta)
+    return;
+
+  lmeta->sensor_timestamp = cframe.get_timestamp ();
+  lmeta->sensor_domain = cframe.get_frame_timestamp_domain ();
+  // System and global time are host wall-clock ms; move them to the monotonic clock
+  if (lmeta->sensor_domain != RS2_TIMESTAMP_DOMAIN_HARDWARE_CLOCK) {
+    const gint64 wall_to_mono = g_get_monotonic_time () - g_get_real_time ();
+    const gint64 sensor = (gint64) (lmeta->sensor_timestamp * 1000.0) + wall_to_mono;
+    if (sensor > 0)
+      lmeta->sensor = sensor * GST_USECOND;
+  }
+  lmeta->arrival = t_arrival * GST_USECOND;
+  lmeta->aligned = t_aligned * GST_USECOND;
+  lmeta->encoded = t_encoded * GST_USECOND;
+}
+
+static GstFlowReturn gst_realsense_src_create_frame(GstPushSrc* psrc, GstBuffer** buf) {
     GstRealsenseSrc* src = GST_REALSENSESRC(psrc);
     GST_TRACE_OBJECT(src, "gst_realsense_src_create");
     GST_LOG_OBJECT (src, "create");
@@ -555,11 +1755,113 @@ static GstFlowReturn gst_realsense_src_create(GstPushSrc* psrc, GstBuffer** buf)
     GstClock *clock;
     GstClockTime clock_time;
     static int temp_ugly_buf_index = 0;
+    const gint64 t_start = g_get_monotonic_time();
+    RsInstanceMetrics &metrics = *src->metrics;
+
+    // A switch asked for by the previous frame, before anything of this one
+    if (src->adaptive_pending >= 0) {
+        const int rung = src->adaptive_pending;
+        src->adaptive_pending = -1;
+        if (!gst_realsense_src_switch_mode(src, rung))
+            return GST_FLOW_ERROR;
+    }
+
+    // Per-frame temporaries from the previous frame are dead by now
+    src->arena->reset();
+    src->memory->set(RsMemArena, src->arena->capacity());
+
+    // The arena grows to what frames really need (recording, guided
+    // upsampling, undistortion). Dropping framesets never shrinks it, so the
+    // limit grows with it rather than starving the output.
+    if (src->memory_limit && src->arena->capacity() > src->planned_arena) {
+      src->memory_limit += src->arena->capacity() - src->planned_arena;
+      src->planned_arena = src->arena->capacity();
+      GST_INFO_OBJECT(src, "Scratch arena grew to %zu bytes, memory limit now %" G_GUINT64_FORMAT,
+          src->planned_arena, src->memory_limit);
+    }
 
     try {
-      auto frame_set = src->rs_pipeline->wait_for_frames();
+      rs2::frameset frame_set;
+      bool zero_copy = false;
+
+      // Wait for a frameset we are allowed to output. With zero-copy on and
+      // downstream already holding max-inflight color frames, either copy
+      // this one or hand it straight back to librealsense and wait again.
+      for (;;) {
+        frame_set = src->rs_pipeline->wait_for_frames();
+
+        // Over max-memory, typically with buffers piling up downstream:
+        // release the frameset so usage can drain. Only pool buffers and
+        // what downstream holds ever drain; if the rest alone is over the
+        // limit, every frameset would be dropped from here on.
+        if (src->memory_limit && src->memory->total() > (gint64) src->memory_limit) {
+          const int64_t draining = src->memory->get(RsMemPools) + src->memory->get(RsMemDownstream);
+          if (src->memory->total() - draining > (gint64) src->memory_limit) {
+            GST_ELEMENT_ERROR(src, RESOURCE, NO_SPACE_LEFT,
+                ("max-memory of %" G_GUINT64_FORMAT " bytes is too low for this configuration.",
+                 src->max_memory),
+                ("%" G_GINT64_FORMAT " bytes are held by the frame queue, align, arena and "
+                 "recorder, limit %" G_GUINT64_FORMAT, src->memory->total() - draining,
+                 src->memory_limit));
+            return GST_FLOW_ERROR;
+          }
+          src->memory_drops.fetch_add(1, std::memory_order_relaxed);
+          GST_LOG_OBJECT(src, "Holding %" G_GINT64_FORMAT " of %" G_GUINT64_FORMAT
+              " bytes, dropping frameset", src->memory->total(), src->memory_limit);
+          if (src->stop_requested)
+            return GST_FLOW_FLUSHING;
+          continue;
+        }
+
+        zero_copy = src->zero_copy && src->output_format == OutputMux && src->align_divisor == 1
+            && !src->undistorter;
+        if (!zero_copy ||
+            g_atomic_int_get(&src->inflight_color) < (gint) src->max_inflight)
+          break;
+
+        if (src->inflight_policy == InflightCopy) {
+          zero_copy = false;
+          src->copy_fallbacks.fetch_add(1, std::memory_order_relaxed);
+          break;
+        }
+
+        src->inflight_drops.fetch_add(1, std::memory_order_relaxed);
+        RsInstanceMetrics::add(metrics.inflight_drops);
+        GST_LOG_OBJECT(src, "%d color frames in flight, dropping frameset",
+            g_atomic_int_get(&src->inflight_color));
+        if (src->stop_requested)
+          return GST_FLOW_FLUSHING;
+      }
+
+      const gint64 t_wait = g_get_monotonic_time();
+      metrics.stages[RsStageWait].observe(t_wait - t_start);
+
       if(src->aligner != nullptr)
         frame_set = src->aligner->process(frame_set);
+
+      const auto& cframe = frame_set.get_color_frame();
+      const auto& depth = frame_set.get_depth_frame();
+      // Undistortion is done by the mux color copy unless the plane is
+      // needed before (guide, pyramid) or encoded (JPEG). Sparse output
+      // without guide or pyramid never reads color, so it is left as is.
+      const bool color_used = src->output_format != OutputSparse || src->guided
+          || src->pyramid_pool;
+      ColorPlane color = color_used ? gst_realsense_src_color_plane(src, cframe)
+          : ColorPlane { static_cast<const guint8 *>(cframe.get_data()),
+              static_cast<size_t>(cframe.get_stride_in_bytes()), cframe.get_width(),
+              cframe.get_height() };
+      const bool fused_undistort = src->undistorter && src->output_format == OutputMux
+          && !src->guided && !src->pyramid_pool;
+      if (src->undistorter && color_used && !fused_undistort)
+          color = gst_realsense_src_undistort_color(src, color);
+
+      // Guided upsampling and in-element alignment stand in for rs2::align
+      // and are timed as that stage
+      const DepthPlane plane = src->guided ? gst_realsense_src_upsample_depth(src, color, depth)
+          : src->reproject_color ? gst_realsense_src_reproject_depth(src, depth)
+          : gst_realsense_src_depth_plane(depth);
+      const gint64 t_align = g_get_monotonic_time();
+      metrics.stages[RsStageAlign].observe(t_align - t_wait);
       
       GST_CAT_DEBUG(gst_realsense_src_debug, "received frame from realsense");
     // ----> Clock update
@@ -568,60 +1870,115 @@ static GstFlowReturn gst_realsense_src_create(GstPushSrc* psrc, GstBuffer** buf)
       gst_object_unref(clock);
       // <---- Clock update
 
-      /* create GstBuffer then release */
-      *buf = gst_buffer_new_and_alloc(src->out_framesize);
-      if (!*buf) {
-        GST_ELEMENT_ERROR(src, RESOURCE, FAILED, ("failed to allocate buffer"), (NULL));
-        throw std::runtime_error("failed to allocate buffer");
-      }
-      if (FALSE == gst_buffer_map(*buf, &minfo, GST_MAP_WRITE)) {
-        GST_ELEMENT_ERROR(src, RESOURCE, FAILED, ("Failed to map buffer for writing"), (NULL));
-        return GST_FLOW_ERROR;
-      }
+      src->depth_query->update(depth);
 
-      const auto& cframe = frame_set.get_color_frame();
-      const auto& depth = frame_set.get_depth_frame();
+      const gsize half_size = src->out_framesize / 2;
 
-      const auto color_data = static_cast<const guint8*>(cframe.get_data());
-      const auto depth_data = reinterpret_cast<const uint16_t*>(depth.get_data());
+      const GstClockTime pts =
+          GST_CLOCK_DIFF(gst_element_get_base_time(GST_ELEMENT(src)), clock_time);
 
-      int width = cframe.get_width();
-      int height = cframe.get_height();
-      int num_pixels = width * height;
+      if (src->recorder)
+        gst_realsense_src_record_depth(src, plane, pts);
 
-      guint8* top_half = minfo.data;
-      guint8* bottom_half = minfo.data + minfo.size / 2;
+      // The wrapped color frame must be laid out exactly like the top half
+      if (zero_copy && static_cast<gsize>(cframe.get_data_size()) != half_size) {
+        zero_copy = false;
+        src->copy_fallbacks.fetch_add(1, std::memory_order_relaxed);
+      }
 
-      // ----> Top half: RGB color
-      memcpy(top_half, color_data, minfo.size / 2);
+      if (src->output_format == OutputJpeg) {
+        GstFlowReturn ret = gst_realsense_src_fill_jpeg(src, color, buf);
+        if (ret != GST_FLOW_OK)
+          return ret;
+      } else if (src->output_format == OutputSparse) {
+        GstFlowReturn ret = gst_realsense_src_fill_sparse(src, plane, buf);
+        if (ret != GST_FLOW_OK)
+          return ret;
+      } else if (zero_copy) {
+        /* Top half references the color frame, bottom half is freshly encoded */
+        GstMemory *depth_mem = gst_realsense_src_alloc_accounted(src, half_size);
+        if (!depth_mem) {
+          GST_ELEMENT_ERROR(src, RESOURCE, NO_SPACE_LEFT,
+              ("Failed to allocate %zu bytes for the depth plane", half_size), (NULL));
+          return GST_FLOW_ERROR;
+        }
+        if (!gst_memory_map(depth_mem, &minfo, GST_MAP_WRITE)) {
+          GST_ELEMENT_ERROR(src, RESOURCE, FAILED, ("Failed to map buffer for writing"), (NULL));
+          gst_memory_unref(depth_mem);
+          return GST_FLOW_ERROR;
+        }
+        const gboolean encoded = gst_realsense_src_encode_depth(src, plane, minfo.data);
+        gst_memory_unmap(depth_mem, &minfo);
+        if (!encoded) {
+          gst_memory_unref(depth_mem);
+          return GST_FLOW_ERROR;
+        }
 
-      // ----> Bottom half: Depth encoded to RGB
-      for (int i = 0; i < num_pixels; ++i) {
-                uint16_t depth_val = depth_data[i];
-          guint8* pixel = bottom_half + i * 3;
+        *buf = gst_buffer_new();
+        gst_buffer_append_memory(*buf, gst_realsense_src_wrap_frame(src, cframe));
+        gst_buffer_append_memory(*buf, depth_mem);
+        src->zero_copy_frames.fetch_add(1, std::memory_order_relaxed);
+      } else {
+        /* Recycled buffer from the output pool */
+        GstFlowReturn ret = gst_realsense_src_acquire(src, src->out_pool, buf);
+        if (ret != GST_FLOW_OK)
+          return ret;
+        if (FALSE == gst_buffer_map(*buf, &minfo, GST_MAP_WRITE)) {
+          gst_buffer_unref(*buf);
+          *buf = NULL;
+          GST_ELEMENT_ERROR(src, RESOURCE, FAILED, ("Failed to map buffer for writing"), (NULL));
+          return GST_FLOW_ERROR;
+        }
 
-          if (depth_val < 2560) {
-              pixel[0] = depth_val % 10;         // R
-              pixel[1] = depth_val / 10;         // G
-              pixel[2] = depth_val % 10;         // B
-          } else {
-              pixel[0] = pixel[1] = pixel[2] = 0;
-          }
+        guint8* top_half = minfo.data;
+        guint8* bottom_half = minfo.data + minfo.size / 2;
+
+        // ----> Top half: RGB color
+        if (fused_undistort)
+          src->undistorter->remap(color.data, color.stride, top_half, src->gst_stride,
+              src->workers.get());
+        else
+          rs_mux_copy_color(color.data, color.stride, top_half, src->gst_stride,
+              static_cast<size_t>(color.width) * 3, color.height);
+
+        // ----> Bottom half: Depth encoded to RGB
+        const gboolean encoded = gst_realsense_src_encode_depth(src, plane, bottom_half);
+
+        gst_buffer_unmap(*buf, &minfo);
+        if (!encoded) {
+          gst_buffer_unref(*buf);
+          *buf = NULL;
+          return GST_FLOW_ERROR;
+        }
       }
 
+    if (src->pyramid_pool)
+      gst_realsense_src_attach_pyramid(src, color, plane, *buf);
+    if (src->floor_estimator)
+      gst_realsense_src_attach_floor(src, plane, *buf);
+
+    const gint64 t_output = g_get_monotonic_time();
+    if (src->latency_meta)
+      gst_realsense_src_attach_latency(src, cframe, t_wait, t_align, t_output, *buf);
+    metrics.stages[RsStageOutput].observe(t_output - t_align);
+    metrics.stages[RsStageCreate].observe(t_output - t_start);
+    if (src->adaptive_ctl)
+        src->adaptive_pending = src->adaptive_ctl->observe_frame(t_output, t_output - t_wait);
+    RsInstanceMetrics::add(metrics.frames);
+    RsInstanceMetrics::add(metrics.bytes, gst_buffer_get_size(*buf));
+
     // ----> Timestamp meta-data
     GST_CAT_DEBUG(gst_realsense_src_debug, "setting timestamp.");        
-    GST_BUFFER_TIMESTAMP(*buf) =
-    GST_CLOCK_DIFF(gst_element_get_base_time(GST_ELEMENT(src)), clock_time);
+    GST_BUFFER_TIMESTAMP(*buf) = pts;
     GST_BUFFER_DTS(*buf) = GST_BUFFER_TIMESTAMP(*buf);
     GST_BUFFER_OFFSET(*buf) = temp_ugly_buf_index++;
     // <---- Timestamp meta-data
-    ++(src->frame_count);
+    src->frame_count.fetch_add(1, std::memory_order_relaxed);
     GST_LOG_OBJECT(src, "Creating meta data depth info for rgb"); 
-    gst_buffer_unmap(*buf, &minfo);   
     return src->stop_requested ? GST_FLOW_FLUSHING : GST_FLOW_OK;
 
     } catch (const rs2::error& e) {
+        RsInstanceMetrics::add(metrics.errors);
         GST_ELEMENT_ERROR(src, RESOURCE, FAILED,
             ("RealSense error calling %s (%s)",
             e.get_failed_function().c_str(), e.get_failed_args().c_str()),
@@ -630,102 +1987,536 @@ static GstFlowReturn gst_realsense_src_create(GstPushSrc* psrc, GstBuffer** buf)
     }
 }
 
+static GstFlowReturn gst_realsense_src_create(GstPushSrc* psrc, GstBuffer** buf) {
+    GstRealsenseSrc* src = GST_REALSENSESRC(psrc);
+    GstFlowReturn ret;
+
+    // Frames whose output buffer did not fit max-memory are skipped
+    while ((ret = gst_realsense_src_create_frame(psrc, buf)) == RS_FLOW_DROPPED) {
+        src->memory_drops.fetch_add(1, std::memory_order_relaxed);
+        if (src->stop_requested)
+            return GST_FLOW_FLUSHING;
+    }
+    return ret;
+}
+
+static gboolean
+gst_realsense_src_is_playback(GstRealsenseSrc* src)
+{
+    return src->playback_file && src->playback_file[0] != '\0';
+}
+
+static void
+gst_realsense_src_enable_streams(GstRealsenseSrc* src, rs2::config& cfg, const std::string& serial_number)
+{
+    // A recording only holds the modes it was made with
+    if (gst_realsense_src_is_playback(src)) {
+        cfg.enable_device_from_file(src->playback_file, true);
+        cfg.enable_stream(RS2_STREAM_COLOR, RS2_FORMAT_RGB8);
+        cfg.enable_stream(RS2_STREAM_DEPTH, RS2_FORMAT_Z16);
+        return;
+    }
+    cfg.enable_device(serial_number);
+    cfg.enable_stream(RS2_STREAM_COLOR, src->color_width, src->color_height, RS2_FORMAT_RGB8, src->color_fps);
+    cfg.enable_stream(RS2_STREAM_DEPTH, src->depth_width, src->depth_height, RS2_FORMAT_Z16, src->depth_fps);
+}
+
+// Size the scratch arena for one color and one depth plane at output
+// resolution; it grows on its own if a stage needs more.
+static gboolean
+gst_realsense_src_reserve_arena(GstRealsenseSrc* src)
+{
+    const gint out_w = (src->align == Align::Depth) ? src->depth_width
+        : rs_downscale_size(src->color_width, src->align_divisor);
+    const gint out_h = (src->align == Align::Depth) ? src->depth_height
+        : rs_downscale_size(src->color_height, src->align_divisor);
+    const size_t plane_pixels = static_cast<size_t>(out_w) * out_h;
+    if (!src->arena) {
+        GST_OBJECT_LOCK(src);
+        src->arena = std::make_unique<RsArena>();
+        GST_OBJECT_UNLOCK(src);
+    }
+    if (!src->arena->reserve(plane_pixels * 3 + plane_pixels * sizeof(uint16_t))) {
+        GST_ELEMENT_ERROR(src, RESOURCE, NO_SPACE_LEFT,
+            ("Failed to allocate %zu bytes of scratch memory.", plane_pixels * 5), (NULL));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Set up the undistortion table, depth lookups and the reprojection the
+ * align mode needs. With align=3, reprojection onto the color grid divided
+ * by the color/depth size ratio, so the coarse grid holds about one sample
+ * per depth pixel, and the upsampler back to color resolution. With
+ * reproject_color, reprojection onto the color grid reduced by
+ * align_divisor instead of rs2::align. Both target the undistorted color
+ * image when there is one. */
+static gboolean
+gst_realsense_src_configure_depth(GstRealsenseSrc* src, const rs2::pipeline_profile& profile)
+{
+    auto depth = profile.get_stream(RS2_STREAM_DEPTH).as<rs2::video_stream_profile>();
+    auto color = profile.get_stream(RS2_STREAM_COLOR).as<rs2::video_stream_profile>();
+    rs2_intrinsics color_intrin = color.get_intrinsics();
+
+    src->undistorter.reset();
+    if (src->undistort && src->align != Align::Depth) {
+        src->undistorter = std::make_unique<RsUndistorter>();
+        if (src->undistorter->configure(rs_scale_intrinsics(color_intrin, 1.0f / src->align_divisor))) {
+            color_intrin.model = RS2_DISTORTION_NONE;
+            std::fill(std::begin(color_intrin.coeffs), std::end(color_intrin.coeffs), 0.0f);
+        } else {
+            GST_INFO_OBJECT(src, "Color stream reports no distortion, not undistorting");
+            src->undistorter.reset();
+        }
+    }
+
+    // Unaligned color pixels have to be projected into depth to be looked up
+    src->depth_query->configure(profile, src->align == Align::None || src->align == Align::Guided
+        || src->reproject_color, 1.0f / src->align_divisor, src->undistorter != nullptr);
+
+    // The floor is fit in the camera frame of the output depth plane
+    const float depth_scale = profile.get_device().first<rs2::depth_sensor>().get_depth_scale();
+    src->floor_estimator.reset();
+    if (src->floor_plane) {
+        const bool on_color = src->align == Align::Color || src->align == Align::Guided;
+        src->floor_estimator = std::make_unique<RsFloorEstimator>();
+        src->floor_estimator->configure(on_color
+            ? rs_scale_intrinsics(color_intrin, 1.0f / src->align_divisor) : depth.get_intrinsics(),
+            depth_scale);
+    }
+
+    if (src->align != Align::Guided && !src->reproject_color) {
+        src->reprojector.reset();
+        src->guided.reset();
+        return TRUE;
+    }
+
+    if (!src->reprojector)
+        src->reprojector = std::make_unique<RsReprojector>();
+
+    if (src->reproject_color) {
+        src->guided.reset();
+        src->reprojector->configure(depth.get_intrinsics(), color_intrin,
+            depth.get_extrinsics_to(color), depth_scale, 1.0f / src->align_divisor);
+        GST_INFO_OBJECT(src, "Aligning %dx%d depth to a %dx%d grid, 1/%d of the color image",
+            depth.width(), depth.height(), src->reprojector->width(), src->reprojector->height(),
+            src->align_divisor);
+        return TRUE;
+    }
+
+    const int factor = MAX(1, (int) std::lround((double) color.width() / depth.width()));
+    if (!src->guided)
+        src->guided = std::make_unique<RsGuidedUpsampler>();
+    if (!src->guided->init(color.width(), color.height(), factor, GUIDED_SIGMA_SPACE, GUIDED_SIGMA_COLOR)) {
+        GST_ELEMENT_ERROR(src, RESOURCE, SETTINGS,
+            ("Cannot upsample %dx%d depth to %dx%d.", depth.width(), depth.height(),
+             color.width(), color.height()), (NULL));
+        return FALSE;
+    }
+    src->reprojector->configure(depth.get_intrinsics(), color_intrin,
+        depth.get_extrinsics_to(color), depth_scale, 1.0f / factor);
+
+    GST_INFO_OBJECT(src, "Guided upsampling of %dx%d depth from a %dx%d grid to %dx%d",
+        depth.width(), depth.height(), src->reprojector->width(), src->reprojector->height(),
+        color.width(), color.height());
+    return TRUE;
+}
+
+/* Restart the camera on another rung of the adaptive ladder and renegotiate.
+ * Runs on the streaming thread between two frames. */
+static gboolean
+gst_realsense_src_switch_mode(GstRealsenseSrc* src, int rung)
+{
+    const RsLadderRung from = src->adaptive_ctl->ladder()[src->adaptive_ctl->rung()];
+    const RsLadderRung to = src->adaptive_ctl->ladder()[rung];
+    const double load = src->adaptive_ctl->load();
+
+    GST_INFO_OBJECT(src, "Switching to %dx%d@%d color, %dx%d@%d depth (%s, load %.2f)",
+        to.color.width, to.color.height, to.color.fps,
+        to.depth.width, to.depth.height, to.depth.fps, src->adaptive_ctl->reason(), load);
+
+    try {
+        const std::string serial = src->rs_pipeline->get_active_profile().get_device()
+            .get_info(RS2_CAMERA_INFO_SERIAL_NUMBER);
+        src->depth_query->clear();
+        src->rs_pipeline->stop();
+
+        src->color_width = to.color.width;
+        src->color_height = to.color.height;
+        src->color_fps = to.color.fps;
+        src->depth_width = to.depth.width;
+        src->depth_height = to.depth.height;
+        src->depth_fps = to.depth.fps;
+
+        rs2::config cfg;
+        gst_realsense_src_enable_streams(src, cfg, serial);
+        auto profile = src->rs_pipeline->start(cfg);
+        if (!gst_realsense_src_configure_depth(src, profile))
+            return FALSE;
+    } catch (const rs2::error& e) {
+        GST_ELEMENT_ERROR(src, RESOURCE, FAILED,
+            ("RealSense error switching modes, calling %s (%s)",
+                e.get_failed_function().c_str(), e.get_failed_args().c_str()),
+            (NULL));
+        return FALSE;
+    }
+
+    // New caps go out before the first buffer of the new mode
+    if (!gst_realsense_src_reserve_arena(src) || !gst_realsense_src_calculate_caps(src))
+        return FALSE;
+    src->adaptive_ctl->switched(rung, g_get_monotonic_time());
+
+    GstStructure *s = gst_structure_new("realsense-mode-change",
+        "reason", G_TYPE_STRING, src->adaptive_ctl->reason(),
+        "load", G_TYPE_DOUBLE, load,
+        "rung", G_TYPE_INT, rung,
+        "rungs", G_TYPE_INT, (gint) src->adaptive_ctl->ladder().size(),
+        "from-color-width", G_TYPE_INT, from.color.width,
+        "from-color-height", G_TYPE_INT, from.color.height,
+        "from-color-fps", G_TYPE_INT, from.color.fps,
+        "from-depth-width", G_TYPE_INT, from.depth.width,
+        "from-depth-height", G_TYPE_INT, from.depth.height,
+        "from-depth-fps", G_TYPE_INT, from.depth.fps,
+        "color-width", G_TYPE_INT, to.color.width,
+        "color-height", G_TYPE_INT, to.color.height,
+        "color-fps", G_TYPE_INT, to.color.fps,
+        "depth-width", G_TYPE_INT, to.depth.width,
+        "depth-height", G_TYPE_INT, to.depth.height,
+        "depth-fps", G_TYPE_INT, to.depth.fps,
+        NULL);
+    gst_element_post_message(GST_ELEMENT(src), gst_message_new_element(GST_OBJECT(src), s));
+    return TRUE;
+}
+
+/* Store the time since *mark as the duration of phase and restart the mark */
+static void
+gst_realsense_src_end_phase(GstRealsenseSrc* src, StartupPhase phase, gint64* mark)
+{
+    const gint64 now = g_get_monotonic_time();
+    GST_OBJECT_LOCK(src);
+    src->startup[phase] = now - *mark;
+    GST_OBJECT_UNLOCK(src);
+    *mark = now;
+}
+
+/* Set the depth sensor's units. The device rounds to the step it supports;
+ * the scale actually used is read back once the pipeline runs. */
+static void
+gst_realsense_src_apply_depth_units(GstRealsenseSrc* src, const rs2::device& dev)
+{
+    auto sensor = dev.first<rs2::depth_sensor>();
+    if (!sensor.supports(RS2_OPTION_DEPTH_UNITS)) {
+        GST_ELEMENT_WARNING(src, RESOURCE, SETTINGS,
+            ("The depth sensor does not support setting depth-units."), (NULL));
+        return;
+    }
+    const rs2::option_range range = sensor.get_option_range(RS2_OPTION_DEPTH_UNITS);
+    const gfloat units = CLAMP(src->depth_units, range.min, range.max);
+    if (units != src->depth_units)
+        GST_ELEMENT_WARNING(src, RESOURCE, SETTINGS,
+            ("depth-units %g is outside the device range [%g, %g], using %g.",
+                src->depth_units, range.min, range.max, units), (NULL));
+    sensor.set_option(RS2_OPTION_DEPTH_UNITS, units);
+}
+
+/* Pick the first camera in ctx and load the preset file into it, timing
+ * each step from *mark. May throw rs2::error. */
+static gboolean
+gst_realsense_src_open_device(GstRealsenseSrc* src, const rs2::context& ctx,
+    std::string& serial_number, gint64* mark)
+{
+    const auto dev_list = ctx.query_devices();
+    gst_realsense_src_end_phase(src, StartupQueryDevices, mark);
+    if (dev_list.size() == 0) {
+        GST_ELEMENT_ERROR(src, RESOURCE, FAILED,
+            ("No RealSense devices found. Cannot start pipeline."),
+            (NULL));
+        return FALSE;
+    }
+
+    serial_number = std::string(dev_list[0].get_info(RS2_CAMERA_INFO_SERIAL_NUMBER));
+
+    // -----> Load ShortRangePreset.json for D435i
+    if (strcmp(dev_list[0].get_info(RS2_CAMERA_INFO_NAME), "Intel RealSense D435I") == 0) {
+        if (src->preset_file && src->preset_file[0] != '\0') {
+            std::string json_file = src->preset_file;
+            GST_INFO_OBJECT(src, "Preset file path at start: %s", json_file.c_str());
+            auto advanced_mode_dev = dev_list[0].as<rs400::advanced_mode>();
+
+            if (!advanced_mode_dev.is_enabled()) {
+                advanced_mode_dev.toggle_advanced_mode(true);
+                GST_LOG_OBJECT(src, "Advanced mode enabled.");
+            }
+            gst_realsense_src_end_phase(src, StartupAdvancedMode, mark);
+
+            std::ifstream f(json_file);
+            if (!f) {
+                GST_ELEMENT_WARNING(src, RESOURCE, SETTINGS,
+                    ("Could not open preset file: %s", json_file.c_str()), (NULL));
+            } else {
+                std::string preset((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+                advanced_mode_dev.load_json(preset);
+            }
+            gst_realsense_src_end_phase(src, StartupLoadPreset, mark);
+        } // else: no preset file set, use camera's default configuration
+    } else {
+        GST_ELEMENT_ERROR(src, RESOURCE, FAILED,
+            ("Selected device is not an Intel RealSense D435i."),
+            (NULL));
+        return FALSE;
+    }
+
+    // After the preset, which may set depth units too
+    if (src->depth_units > 0.0f)
+        gst_realsense_src_apply_depth_units(src, dev_list[0]);
+
+    return TRUE;
+}
+
+/* Optional Prometheus exporter shared by every instance in the process.
+ * Started by the first instance that starts rather than when the plugin
+ * loads, so gst-inspect and the registry scanner never bind the endpoint. */
+static void
+gst_realsense_src_start_exporter(GstRealsenseSrc* src)
+{
+    static gsize done = 0;
+    if (!g_once_init_enter(&done))
+        return;
+    const gchar *endpoint = g_getenv("GST_REALSENSE_METRICS");
+    if (endpoint && *endpoint) {
+        static RsMetricsExporter exporter;
+        if (!exporter.start(endpoint))
+            GST_WARNING_OBJECT(src, "Metrics exporter on '%s' not started: %s", endpoint,
+                exporter.last_error().c_str());
+        else
+            GST_INFO_OBJECT(src, "Serving metrics on '%s'", endpoint);
+    }
+    g_once_init_leave(&done, 1);
+}
+
+/* Undo a start that fails once the recorder is open: close the recorder
+ * and, if started, stop the RealSense pipeline */
+static void
+gst_realsense_src_abort_start(GstRealsenseSrc* src, gboolean started)
+{
+    GST_OBJECT_LOCK(src);
+    src->recorder.reset();
+    GST_OBJECT_UNLOCK(src);
+    src->memory->set(RsMemRecorder, 0);
+    if (!started)
+        return;
+    try {
+        src->depth_query->clear();
+        src->rs_pipeline->stop();
+    } catch (const rs2::error& e) {
+        GST_WARNING_OBJECT(src, "Failed to stop the RealSense pipeline: %s", e.what());
+    }
+}
+
 static gboolean
 gst_realsense_src_start(GstBaseSrc* basesrc)
 {
     auto* src = GST_REALSENSESRC(basesrc);
     GST_TRACE_OBJECT(src, "gst_realsense_src_start");
 
+    gst_realsense_src_start_exporter(src);
+
+    const gint64 t_start = g_get_monotonic_time();
+    const gboolean playback = gst_realsense_src_is_playback(src);
+    const gboolean synthetic = src->synthetic && !playback;
+
+    GST_OBJECT_LOCK(src);
+    std::fill(src->startup, src->startup + StartupPhaseCount, 0);
+    GST_OBJECT_UNLOCK(src);
+
     // Validate color and depth mode before starting pipeline
-    if (!is_valid_mode(valid_color_modes, src->color_width, src->color_height, src->color_fps)) {
+    if (!playback && !is_valid_mode(valid_color_modes, src->color_width, src->color_height, src->color_fps)) {
         GST_ELEMENT_ERROR(src, RESOURCE, SETTINGS,
             ("Invalid color mode: %dx%d@%d. Not starting pipeline.", src->color_width, src->color_height, src->color_fps), (NULL));
         return FALSE;
     }
-    if (!is_valid_mode(valid_depth_modes, src->depth_width, src->depth_height, src->depth_fps)) {
+    if (!playback && !is_valid_mode(valid_depth_modes, src->depth_width, src->depth_height, src->depth_fps)) {
         GST_ELEMENT_ERROR(src, RESOURCE, SETTINGS,
             ("Invalid depth mode: %dx%d@%d. Not starting pipeline.", src->depth_width, src->depth_height, src->depth_fps), (NULL));
         return FALSE;
     }
 
+    // basesrc does not call stop() after a failed start, so every failure
+    // once the RealSense pipeline runs stops it again
+    gboolean started = FALSE;
+    // Each phase ends where the next begins, so they add up to the total
+    gint64 mark = t_start;
     try {
+        rs2::context ctx;
+        gst_realsense_src_end_phase(src, StartupContext, &mark);
+
+        // One context serves the device query and the pipeline
         GST_LOG_OBJECT(src, "Creating RealSense pipeline");
-        src->rs_pipeline = std::make_unique<rs2::pipeline>();
+        src->rs_pipeline = std::make_unique<rs2::pipeline>(ctx);
         if (!src->rs_pipeline) {
             GST_ELEMENT_ERROR(src, RESOURCE, FAILED, ("Failed to create RealSense pipeline."), (NULL));
             return FALSE;
         }
 
         rs2::config cfg;
-        rs2::context ctx;
-        const auto dev_list = ctx.query_devices();
         std::string serial_number;
-
-        if (dev_list.size() == 0) {
-            GST_ELEMENT_ERROR(src, RESOURCE, FAILED,
-                ("No RealSense devices found. Cannot start pipeline."),
-                (NULL));
-            return FALSE;
-        }
-
-        serial_number = std::string(dev_list[0].get_info(RS2_CAMERA_INFO_SERIAL_NUMBER));
-
-        // -----> Load ShortRangePreset.json for D435i
-        if (strcmp(dev_list[0].get_info(RS2_CAMERA_INFO_NAME), "Intel RealSense D435I") == 0) {
-            if (src->preset_file && src->preset_file[0] != '\0') {
-                std::string json_file = src->preset_file;
-                GST_INFO_OBJECT(src, "Preset file path at start: %s", json_file.c_str());
-                auto advanced_mode_dev = dev_list[0].as<rs400::advanced_mode>();
-
-                if (!advanced_mode_dev.is_enabled()) {
-                    advanced_mode_dev.toggle_advanced_mode(true);
-                    GST_LOG_OBJECT(src, "Advanced mode enabled.");
-                }
-
-                std::ifstream f(json_file);
-                if (!f) {
-                    GST_ELEMENT_WARNING(src, RESOURCE, SETTINGS,
-                        ("Could not open preset file: %s", json_file.c_str()), (NULL));
-                } else {
-                    std::string preset((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
-                    advanced_mode_dev.load_json(preset);
-                }
-            } // else: no preset file set, use camera's default configuration
-        } else {
-            GST_ELEMENT_ERROR(src, RESOURCE, FAILED,
-                ("Selected device is not an Intel RealSense D435i."),
-                (NULL));
+        if (playback) {
+            GST_INFO_OBJECT(src, "Playing back %s", src->playback_file);
+        } else if (synthetic) {
+            src->synthetic_camera = std::make_unique<RsSyntheticCamera>();
+            src->synthetic_camera->add_to(ctx, valid_color_modes, valid_depth_modes,
+                src->depth_units > 0.0f ? src->depth_units : 0.001f);
+            serial_number = RsSyntheticCamera::SERIAL;
+            gst_realsense_src_end_phase(src, StartupQueryDevices, &mark);
+        } else if (!gst_realsense_src_open_device(src, ctx, serial_number, &mark)) {
             return FALSE;
         }
 
-        cfg.enable_device(serial_number);
-        cfg.enable_stream(RS2_STREAM_COLOR, src->color_width, src->color_height, RS2_FORMAT_RGB8, src->color_fps);
-        cfg.enable_stream(RS2_STREAM_DEPTH, src->depth_width, src->depth_height, RS2_FORMAT_Z16, src->depth_fps);
+        gst_realsense_src_enable_streams(src, cfg, serial_number);
 
         // -----> Handle stream alignment (Color or Depth)
+        src->aligner.reset();
+        src->align_divisor = 1;
+        src->reproject_color = FALSE;
+        if (src->align_scale < 1.0f && src->align != Align::Color)
+            GST_ELEMENT_WARNING(src, RESOURCE, SETTINGS,
+                ("align-scale only applies to align=1."), (NULL));
+        if (src->undistort && src->align == Align::Depth)
+            GST_ELEMENT_WARNING(src, RESOURCE, SETTINGS,
+                ("undistort has no effect with align=2."), (NULL));
+        if (src->undistort && src->zero_copy)
+            GST_ELEMENT_WARNING(src, RESOURCE, SETTINGS,
+                ("zero-copy has no effect with undistort."), (NULL));
         switch (src->align) {
             case Align::None:
                 break;
             case Align::Color:
-                src->aligner = std::make_unique<rs2::align>(RS2_STREAM_COLOR);
+                // A reduced or undistorted grid is reprojected in-element
+                // once the pipeline runs
+                src->align_divisor = CLAMP((gint) std::lround(1.0f / src->align_scale), 1,
+                    RS_DOWNSCALE_MAX_FACTOR);
+                src->reproject_color = src->align_divisor > 1 || src->undistort;
+                if (!src->reproject_color)
+                    src->aligner = std::make_unique<rs2::align>(RS2_STREAM_COLOR);
+                else if (src->zero_copy && src->align_divisor > 1)
+                    GST_ELEMENT_WARNING(src, RESOURCE, SETTINGS,
+                        ("zero-copy has no effect with align-scale below 1."), (NULL));
                 break;
             case Align::Depth:
                 src->aligner = std::make_unique<rs2::align>(RS2_STREAM_DEPTH);
                 break;
+            case Align::Guided:
+                // Set up from the calibration once the pipeline runs
+                break;
             default:
                 GST_ELEMENT_WARNING(src, RESOURCE, SETTINGS,
                     ("Unknown alignment parameter %d", src->align), (NULL));
         }
 
+        if (src->output_format == OutputJpeg && !RsJpegEncoder::available()) {
+            GST_ELEMENT_ERROR(src, RESOURCE, SETTINGS,
+                ("JPEG output requested but the plugin was built without libjpeg-turbo."), (NULL));
+            return FALSE;
+        }
+
+        // -----> Slice parallelism on the process-wide executor
+        {
+            guint n_threads = src->encode_threads;
+            if (n_threads == 0)
+                n_threads = MIN(g_get_num_processors(), 4);
+            if (!src->workers || src->workers->size() != n_threads)
+                src->workers = std::make_unique<RsWorkerPool>(n_threads, src->priority);
+        }
+
+        if (!gst_realsense_src_reserve_arena(src))
+            return FALSE;
+
+        // -----> Lossless depth recording, last of what can fail before the
+        // pipeline runs so a failure leaves no writer thread behind
+        if (src->record_file && src->record_file[0] != '\0') {
+            if (!RsDepthEncoder::available()) {
+                GST_ELEMENT_ERROR(src, RESOURCE, SETTINGS,
+                    ("Depth recording requested but the plugin was built without zstd."), (NULL));
+                return FALSE;
+            }
+            auto recorder = std::make_unique<RsDepthRecorder>();
+            if (!recorder->open(src->record_file, 8)) {
+                GST_ELEMENT_ERROR(src, RESOURCE, OPEN_WRITE,
+                    ("Could not open record file: %s", src->record_file), (NULL));
+                return FALSE;
+            }
+            GST_OBJECT_LOCK(src);
+            src->recorder = std::move(recorder);
+            GST_OBJECT_UNLOCK(src);
+        }
+
+        if (src->latency_meta && !src->latency_probe)
+            src->latency_probe = gst_pad_add_probe(GST_BASE_SRC_PAD(src), GST_PAD_PROBE_TYPE_BUFFER,
+                gst_realsense_src_stamp_pushed, NULL, NULL);
+
+        // -----> Mode ladder for the adaptive controller, topped by the configured modes
+        if (src->adaptive && playback)
+            GST_ELEMENT_WARNING(src, RESOURCE, SETTINGS,
+                ("adaptive has no effect when playing back a recording."), (NULL));
+        if (src->adaptive && !playback) {
+            if (!src->adaptive_ctl)
+                src->adaptive_ctl = std::make_unique<RsAdaptiveController>();
+            src->adaptive_ctl->reset(rs_adaptive_ladder(valid_color_modes, valid_depth_modes,
+                { { src->color_width, src->color_height, src->color_fps },
+                  { src->depth_width, src->depth_height, src->depth_fps } }));
+            src->adaptive_pending = -1;
+            GST_INFO_OBJECT(src, "Adaptive ladder has %zu rungs", src->adaptive_ctl->ladder().size());
+        } else {
+            src->adaptive_ctl.reset();
+        }
+
         // -----> Start the RealSense pipeline
-        src->rs_pipeline->start(cfg);
+        gst_realsense_src_end_phase(src, StartupSetup, &mark);
+        auto profile = src->rs_pipeline->start(cfg);
+        started = TRUE;
+        gst_realsense_src_end_phase(src, StartupPipelineStart, &mark);
+
+        // The mode properties report what the recording holds
+        if (playback) {
+            auto color = profile.get_stream(RS2_STREAM_COLOR).as<rs2::video_stream_profile>();
+            auto depth = profile.get_stream(RS2_STREAM_DEPTH).as<rs2::video_stream_profile>();
+            src->color_width = color.width();
+            src->color_height = color.height();
+            src->color_fps = color.fps();
+            src->depth_width = depth.width();
+            src->depth_height = depth.height();
+            src->depth_fps = depth.fps();
+            GST_INFO_OBJECT(src, "Recording holds %dx%d@%d color, %dx%d@%d depth",
+                src->color_width, src->color_height, src->color_fps,
+                src->depth_width, src->depth_height, src->depth_fps);
+            if (!gst_realsense_src_reserve_arena(src)) {
+                gst_realsense_src_abort_start(src, TRUE);
+                return FALSE;
+            }
+        }
+
+        src->depth_scale = profile.get_device().first<rs2::depth_sensor>().get_depth_scale();
+        GST_INFO_OBJECT(src, "Depth scale %g m, mux depth range %.3f m",
+            src->depth_scale, src->depth_scale * RSMux::DECIMAL_MAX_DEPTH);
+
+        if (!gst_realsense_src_configure_depth(src, profile)) {
+            gst_realsense_src_abort_start(src, TRUE);
+            return FALSE;
+        }
+
+        if (!src->metrics)
+            src->metrics = RsMetricsRegistry::get().add(GST_OBJECT_NAME(src));
+        RsInstanceMetrics::add(src->metrics->starts);
 
         GST_LOG_OBJECT(src, "RealSense pipeline started");
 
         // Calculate caps using actual RealSense output
+        gst_realsense_src_end_phase(src, StartupConfigure, &mark);
         if (!gst_realsense_src_calculate_caps(src)) {
+            gst_realsense_src_abort_start(src, TRUE);
             return FALSE;
         }
+        gst_realsense_src_end_phase(src, StartupFirstFrame, &mark);
 
     } catch (const rs2::error& e) {
         GST_ERROR_OBJECT(src, "RealSense error calling %s (%s)",
@@ -736,9 +2527,19 @@ gst_realsense_src_start(GstBaseSrc* basesrc)
                 e.get_failed_function().c_str(),
                 e.get_failed_args().c_str()),
             (NULL));
+        gst_realsense_src_abort_start(src, started);
         return FALSE;
     }
 
+    GST_OBJECT_LOCK(src);
+    src->startup[StartupTotal] = mark - t_start;
+    GST_OBJECT_UNLOCK(src);
+    GST_INFO_OBJECT(src, "Started in %" G_GINT64_FORMAT " us (pipeline start %" G_GINT64_FORMAT
+        " us, first frame %" G_GINT64_FORMAT " us)", src->startup[StartupTotal],
+        src->startup[StartupPipelineStart], src->startup[StartupFirstFrame]);
+    gst_element_post_message(GST_ELEMENT(src),
+        gst_message_new_element(GST_OBJECT(src), gst_realsense_src_create_startup_stats(src)));
+
     return TRUE;
 }
 
@@ -23,12 +23,33 @@
 #include <gst/gst.h>
 #include <gst/base/gstpushsrc.h>
 
+#include <atomic>
+
 #include <gst/video/gstvideometa.h>
 #include <gst/video/gstvideopool.h>
 
 #include <librealsense2/rs.hpp>
 #include <librealsense2/rs_advanced_mode.hpp>
 
+#include "gstrealsensepool.h"
+#include "rsadaptive.h"
+#include "rsarena.h"
+#include "rsdepthcodec.h"
+#include "rsdepthquery.h"
+#include "rsdownscale.h"
+#include "rsfloor.h"
+#include "rsguided.h"
+#include "rsjpegenc.h"
+#include "rsmemory.h"
+#include "rsmetrics.h"
+#include "rsmuxkernels.h"
+#include "rspyramid.h"
+#include "rsreproject.h"
+#include "rssparse.h"
+#include "rssynthetic.h"
+#include "rsundistort.h"
+#include "rsworkerpool.h"
+
 G_BEGIN_DECLS
 
 /* #defines don't like whitespacey bits */
@@ -59,11 +80,56 @@ enum Align
 {
   None,
   Color,
-  Depth
+  Depth,
+  Guided // depth upsampled to color resolution with the color image as guide
+};
+
+enum OutputFormat
+{
+  OutputMux,    // RGB, color on top and encoded depth below
+  OutputJpeg,   // image/jpeg, color only
+  OutputSparse  // application/x-realsense-sparse-depth, valid depth pixels only
+};
+
+// Phases of start(), timed for startup-stats and the realsense-startup message
+enum StartupPhase
+{
+  StartupContext,       // rs2::context creation
+  StartupQueryDevices,  // device enumeration
+  StartupAdvancedMode,  // advanced mode check and toggle
+  StartupLoadPreset,    // reading and loading the preset file
+  StartupSetup,         // streams, alignment, workers, recorder, arena, adaptive ladder
+  StartupPipelineStart, // rs2::pipeline::start
+  StartupConfigure,     // depth scale, alignment tables, metrics registration
+  StartupFirstFrame,    // first frameset and caps
+  StartupTotal,         // sum of the above
+  StartupPhaseCount
+};
+
+// What to do when a stream already has max-inflight zero-copy buffers downstream
+enum InflightPolicy
+{
+  InflightCopy, // fall back to copying the frame into a fresh buffer
+  InflightDrop  // release the frameset and wait for the next one
 };
 
 using rs_pipe_ptr = std::unique_ptr<rs2::pipeline>;
 using rs_aligner_ptr = std::unique_ptr<rs2::align>;
+using rs_arena_ptr = std::unique_ptr<RsArena>;
+using rs_worker_pool_ptr = std::unique_ptr<RsWorkerPool>;
+using rs_jpeg_encoder_ptr = std::unique_ptr<RsJpegEncoder>;
+using rs_depth_encoder_ptr = std::unique_ptr<RsDepthEncoder>;
+using rs_depth_recorder_ptr = std::unique_ptr<RsDepthRecorder>;
+using rs_depth_resample_ptr = std::unique_ptr<RsDepthResample>;
+using rs_metrics_ptr = std::shared_ptr<RsInstanceMetrics>;
+using rs_depth_query_ptr = std::unique_ptr<RsDepthQuery>;
+using rs_memory_ptr = std::shared_ptr<RsMemoryAccount>;
+using rs_adaptive_ptr = std::unique_ptr<RsAdaptiveController>;
+using rs_reprojector_ptr = std::unique_ptr<RsReprojector>;
+using rs_guided_ptr = std::unique_ptr<RsGuidedUpsampler>;
+using rs_synthetic_ptr = std::unique_ptr<RsSyntheticCamera>;
+using rs_undistorter_ptr = std::unique_ptr<RsUndistorter>;
+using rs_floor_ptr = std::unique_ptr<RsFloorEstimator>;
 using namespace rs400;
 constexpr const auto DEFAULT_PROP_CAM_SN = 0;
 
@@ -85,15 +151,94 @@ struct _GstRealsenseSrc
   GstAudioFormat accel_format = GST_AUDIO_FORMAT_UNKNOWN;
   GstAudioFormat gyro_format = GST_AUDIO_FORMAT_UNKNOWN;
   GstClockTime prev_time = 0;
-  guint64 frame_count = 0;
+
+  // Counters written by the streaming thread and read by the stats
+  // property from any thread, hence relaxed atomics
+  std::atomic<guint64> frame_count{0};
 
   // Realsense vars
   rs_pipe_ptr rs_pipeline = nullptr;
   rs_aligner_ptr aligner = nullptr;
   bool has_imu = false;
+
+  // align=3: depth reprojected onto a coarse color grid, then upsampled.
+  // align=1 with align-scale or undistort (reproject_color): depth
+  // reprojected in-element onto the color grid reduced by align_divisor,
+  // and color box filtered down to it.
+  rs_reprojector_ptr reprojector = nullptr;
+  rs_guided_ptr guided = nullptr;
+  gint align_divisor = 1;
+  gboolean reproject_color = FALSE;
+
+  // Remap table of the output color plane, with undistort
+  rs_undistorter_ptr undistorter = nullptr;
+
+  // Floor plane fit on the output depth plane, with floor-plane
+  rs_floor_ptr floor_estimator = nullptr;
+
+  // Generated frames instead of a camera, with synthetic=true
+  rs_synthetic_ptr synthetic_camera = nullptr;
+
+  // Duration of each phase of the last start, in microseconds
+  gint64 startup[StartupPhaseCount] = {};
+
+  // Scratch memory for per-frame temporaries, reset at the top of create()
+  rs_arena_ptr arena = nullptr;
+
+  // Slice-parallel encoders and the pool recycling their output buffers
+  rs_worker_pool_ptr workers = nullptr;
+  rs_jpeg_encoder_ptr jpeg_encoder = nullptr;
+  GstBufferPool *out_pool = nullptr;
+
+  // Compressed depth recording, written on the recorder's own thread
+  rs_depth_encoder_ptr depth_encoder = nullptr;
+  rs_depth_recorder_ptr recorder = nullptr;
+
+  // Layout of the pyramid meta levels and the pool recycling their buffers
+  RsPyramidLevel pyramid[RS_PYRAMID_MAX_LEVELS];
+  gint pyramid_built_levels = 0;
+  GstBufferPool *pyramid_pool = nullptr;
+
+  // Depth plane kernel picked in set_caps (again when hole-fill changes),
+  // what it was picked for, and its expected input size
+  RsMuxDepthKernel depth_kernel = nullptr;
+  RSMux::DepthEncoding depth_encoding = RSMux::DepthEncoding::Decimal;
+  bool depth_resampled = false;
+  RsHoleFill depth_kernel_fill = RsHoleFill::Off;
+  rs_depth_resample_ptr depth_resample = nullptr;
+  gint depth_in_width = 0;
+  gint depth_in_height = 0;
+
+  // This instance's entry in the process-wide metrics registry
+  rs_metrics_ptr metrics = nullptr;
+
+  // Bytes held by this instance; shared with its buffer pools. pool_buffers
+  // and memory_limit are picked from max-memory in calculate_caps.
+  rs_memory_ptr memory = nullptr;
+  guint pool_buffers = 0;
+  guint64 memory_limit = 0;
+  gsize planned_arena = 0;  // arena capacity memory_limit accounts for
+  std::atomic<guint64> memory_drops{0};
+
+  // Mode ladder controller, and the rung the last frame asked to switch to
+  rs_adaptive_ptr adaptive_ctl = nullptr;
+  gint adaptive_pending = -1;
+
+  // Reference to the last depth frame, for the get-distances signal
+  rs_depth_query_ptr depth_query = nullptr;
+
+  // Buffers downstream that still reference color rs2::frame memory (only
+  // the color plane is ever wrapped). Decremented from whatever thread
+  // drops the last buffer ref.
+  gint inflight_color = 0;
+  std::atomic<guint64> zero_copy_frames{0};
+  std::atomic<guint64> copy_fallbacks{0};
+  std::atomic<guint64> inflight_drops{0};
   
   // Properties
   Align align = Align::None;
+  gfloat align_scale = 1.0f;
+  gboolean undistort = FALSE;
 
   // New properties for color and depth stream configuration
   gint color_width = 1280;
@@ -106,12 +251,65 @@ struct _GstRealsenseSrc
   // Preset file path property
   gchar *preset_file = nullptr;
 
+  // librealsense .bag recording played instead of a camera
+  gchar *playback_file = nullptr;
+
+  // Stream from a software device generating frames
+  gboolean synthetic = FALSE;
+
+  // Depth units to set on the sensor (0 = leave as is), and the metres per
+  // unit of the running stream, which the depth encodings carry
+  gfloat depth_units = 0.0f;
+  gfloat depth_scale = 0.001f;
+
+  // Zero-copy output of the color plane and its in-flight cap
+  gboolean zero_copy = FALSE;
+  guint max_inflight = 4;
+  InflightPolicy inflight_policy = InflightCopy;
+
+  // Output format and in-element encoding
+  OutputFormat output_format = OutputMux;
+  gint jpeg_quality = 85;
+  guint encode_threads = 0;
+  RsTaskPriority priority = RsTaskPriority::Normal;
+
+  // Lossless depth recording
+  gchar *record_file = nullptr;
+  gint record_level = 3;
+
+  // Image pyramid attached as GstRealsensePyramidMeta
+  gint pyramid_levels = 0;
+  RsPyramidDepthFilter pyramid_depth_filter = RsPyramidDepthMin;
+
+  // Validity codes in the B channel of the encoded depth
+  gboolean depth_mask = FALSE;
+
+  // Memory budget in bytes, 0 = unlimited
+  guint64 max_memory = 0;
+
+  // Step camera modes down and up under CPU pressure
+  gboolean adaptive = FALSE;
+
+  // Hole filling of the encoded depth plane
+  RsHoleFill hole_fill = RsHoleFill::Off;
+
+  // Per-buffer stage times, the last one stamped by a probe on the src pad
+  gboolean latency_meta = FALSE;
+  gulong latency_probe = 0;
+
+  // Floor plane attached as GstRealsenseFloorMeta, budget in microseconds
+  gboolean floor_plane = FALSE;
+  guint floor_budget = 2000;
+
   uint64_t serial_number = 0;
 };
 
 struct _GstRealsenseSrcClass 
 {
   GstPushSrcClass parent_class;
+
+  /* actions */
+  GArray *(*get_distances) (GstRealsenseSrc * src, GArray * points, gboolean color_space);
 };
 
 GType gst_realsense_src_get_type (void);
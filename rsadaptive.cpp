@@ -0,0 +1,204 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rsadaptive.h"
+
+#include <algorithm>
+
+static constexpr double LOAD_SMOOTHING = 0.1;
+static constexpr double LOAD_HIGH = 0.9;   // step down above this
+static constexpr double LOAD_LOW = 0.7;    // step up if the upper rung stays below this
+static constexpr double MIN_SAVING = 0.75; // next rung costs at most this share
+static constexpr int64_t DOWN_AFTER_US = 1000000;
+static constexpr int64_t UP_AFTER_US = 5000000;
+static constexpr int64_t UP_AFTER_MAX_US = 60000000;
+static constexpr int64_t HOLD_US = 3000000;
+static constexpr int64_t QOS_STALE_US = 2000000;
+static constexpr int64_t FLAP_US = 10000000;
+
+static uint64_t
+pixels (const std::tuple<int, int, int> & mode)
+{
+  return static_cast<uint64_t> (std::get<0> (mode)) * std::get<1> (mode);
+}
+
+/* Distinct resolutions at fps no larger than max_pixels, largest first */
+static RsModeTable
+resolutions_at (const RsModeTable & modes, int fps, uint64_t max_pixels)
+{
+  RsModeTable out;
+  for (const auto &mode : modes)
+    if (std::get<2> (mode) == fps && pixels (mode) <= max_pixels)
+      out.push_back (mode);
+  std::stable_sort (out.begin (), out.end (), [] (const std::tuple<int, int, int> &a,
+          const std::tuple<int, int, int> &b) { return pixels (a) > pixels (b); });
+  return out;
+}
+
+static bool
+has_mode (const RsModeTable & modes, int width, int height, int fps)
+{
+  return std::find (modes.begin (), modes.end (), std::make_tuple (width, height, fps)) != modes.end ();
+}
+
+std::vector<RsLadderRung>
+rs_adaptive_ladder (const RsModeTable & color_modes, const RsModeTable & depth_modes,
+    const RsLadderRung & top)
+{
+  std::vector<RsLadderRung> ladder = { top };
+  const int fps = top.color.fps;
+  const uint64_t top_color = static_cast<uint64_t> (top.color.width) * top.color.height;
+  const uint64_t top_depth = static_cast<uint64_t> (top.depth.width) * top.depth.height;
+
+  auto push = [&] (const RsLadderRung &rung) {
+    if (rung.cost () <= ladder.back ().cost () * MIN_SAVING)
+      ladder.push_back (rung);
+  };
+
+  /* Resolution steps at the top frame rate */
+  const RsModeTable colors = resolutions_at (color_modes, fps, top_color);
+  const RsModeTable depths = resolutions_at (depth_modes, top.depth.fps, top_depth);
+  if (depths.empty ())
+    return ladder;
+  for (const auto &color : colors) {
+    const double scale = static_cast<double> (pixels (color)) / top_color;
+    auto depth = depths.back ();
+    for (const auto &d : depths) {
+      if (pixels (d) <= top_depth * scale) {
+        depth = d;
+        break;
+      }
+    }
+    push ({ { std::get<0> (color), std::get<1> (color), fps },
+        { std::get<0> (depth), std::get<1> (depth), top.depth.fps } });
+  }
+
+  /* Frame rate steps at the smallest resolution, color and depth together */
+  RsLadderRung base = ladder.back ();
+  std::vector<int> rates;
+  for (const auto &mode : color_modes)
+    if (std::get<2> (mode) < std::min (base.color.fps, base.depth.fps))
+      rates.push_back (std::get<2> (mode));
+  std::sort (rates.rbegin (), rates.rend ());
+  rates.erase (std::unique (rates.begin (), rates.end ()), rates.end ());
+  for (int rate : rates) {
+    if (!has_mode (color_modes, base.color.width, base.color.height, rate) ||
+        !has_mode (depth_modes, base.depth.width, base.depth.height, rate))
+      continue;
+    RsLadderRung rung = base;
+    rung.color.fps = rate;
+    rung.depth.fps = rate;
+    push (rung);
+  }
+  return ladder;
+}
+
+void
+RsAdaptiveController::reset (std::vector<RsLadderRung> ladder)
+{
+  ladder_ = std::move (ladder);
+  rung_ = 0;
+  load_ = 0.0;
+  qos_.store (0.0);
+  qos_time_us_.store (0);
+  hold_until_us_ = 0;
+  over_since_us_ = -1;
+  under_since_us_ = -1;
+  last_up_us_ = -1;
+  up_delay_us_ = UP_AFTER_US;
+  reason_ = "";
+}
+
+void
+RsAdaptiveController::observe_qos (double proportion, int64_t now_us)
+{
+  qos_.store (proportion, std::memory_order_relaxed);
+  qos_time_us_.store (now_us, std::memory_order_relaxed);
+}
+
+int
+RsAdaptiveController::observe_frame (int64_t now_us, int64_t busy_us)
+{
+  if (ladder_.empty ())
+    return -1;
+
+  const RsLadderRung &current = ladder_[rung_];
+  const double period_us = 1e6 / std::max (1, std::min (current.color.fps, current.depth.fps));
+  load_ += LOAD_SMOOTHING * (busy_us / period_us - load_);
+
+  double pressure = load_;
+  bool from_qos = false;
+  if (now_us - qos_time_us_.load (std::memory_order_relaxed) < QOS_STALE_US) {
+    const double qos = qos_.load (std::memory_order_relaxed);
+    if (qos > pressure) {
+      pressure = qos;
+      from_qos = true;
+    }
+  }
+
+  if (now_us < hold_until_us_)
+    return -1;
+
+  if (pressure > LOAD_HIGH) {
+    under_since_us_ = -1;
+    if (over_since_us_ < 0)
+      over_since_us_ = now_us;
+    if (now_us - over_since_us_ >= DOWN_AFTER_US && rung_ + 1 < ladder_.size ()) {
+      /* Undoing a recent up step: be slower to try again */
+      if (last_up_us_ >= 0 && now_us - last_up_us_ < FLAP_US)
+        up_delay_us_ = std::min (up_delay_us_ * 2, UP_AFTER_MAX_US);
+      reason_ = from_qos ? "qos" : "overload";
+      return static_cast<int> (rung_ + 1);
+    }
+    return -1;
+  }
+  over_since_us_ = -1;
+
+  if (rung_ == 0)
+    return -1;
+  const double projected = pressure * ladder_[rung_ - 1].cost () / current.cost ();
+  if (projected >= LOAD_LOW) {
+    under_since_us_ = -1;
+    return -1;
+  }
+  if (under_since_us_ < 0)
+    under_since_us_ = now_us;
+  if (now_us - under_since_us_ >= up_delay_us_) {
+    reason_ = "headroom";
+    return static_cast<int> (rung_ - 1);
+  }
+  return -1;
+}
+
+void
+RsAdaptiveController::switched (size_t rung, int64_t now_us)
+{
+  if (rung < rung_)
+    last_up_us_ = now_us;
+  else if (last_up_us_ >= 0 && now_us - last_up_us_ >= UP_AFTER_MAX_US)
+    up_delay_us_ = UP_AFTER_US;
+  /* Start the new rung from its projected load: the same work per pixel
+   * at the new pixel rate */
+  const uint64_t from_cost = ladder_[rung_].cost ();
+  load_ = from_cost ? load_ * static_cast<double> (ladder_[rung].cost ()) / from_cost : 0.0;
+  rung_ = rung;
+  hold_until_us_ = now_us + HOLD_US;
+  over_since_us_ = -1;
+  under_since_us_ = -1;
+}
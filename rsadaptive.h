@@ -0,0 +1,103 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_ADAPTIVE_H__
+#define __RS_ADAPTIVE_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+struct RsCameraMode
+{
+  int width;
+  int height;
+  int fps;
+};
+
+/* One step of the ladder: the color and depth modes streamed together */
+struct RsLadderRung
+{
+  RsCameraMode color;
+  RsCameraMode depth;
+
+  /* Pixels per second of both streams, the unit loads are scaled by */
+  uint64_t cost() const
+  {
+    return (static_cast<uint64_t>(color.width) * color.height * color.fps)
+        + (static_cast<uint64_t>(depth.width) * depth.height * depth.fps);
+  }
+};
+
+using RsModeTable = std::vector<std::tuple<int, int, int>>;
+
+/* Ladder from `top` downwards: first smaller color resolutions at the top
+ * frame rate, each paired with the largest depth resolution scaled down
+ * by at least as much, then lower frame rates at the smallest resolution.
+ * Only modes present in both tables are used; rungs that save less than
+ * a quarter of the previous cost are skipped. */
+std::vector<RsLadderRung> rs_adaptive_ladder(const RsModeTable &color_modes,
+    const RsModeTable &depth_modes, const RsLadderRung &top);
+
+/* Decides when to move along the ladder.
+ *
+ * The load is the smoothed share of the frame period the streaming thread
+ * spends on a frame outside waiting for librealsense, or the downstream
+ * QoS proportion if that is higher. Sustained overload steps one rung
+ * down; sustained headroom, judged by the load the rung above would have,
+ * steps one rung up. Every switch is followed by a hold period, and an up
+ * step that is undone soon after doubles the time needed for the next. */
+class RsAdaptiveController
+{
+public:
+  void reset(std::vector<RsLadderRung> ladder);
+
+  const std::vector<RsLadderRung> &ladder() const { return ladder_; }
+  size_t rung() const { return rung_; }
+  double load() const { return load_; }
+  /* Why the last observe_frame() asked for a switch */
+  const char *reason() const { return reason_; }
+
+  /* From any thread; proportion as in GST_EVENT_QOS */
+  void observe_qos(double proportion, int64_t now_us);
+
+  /* Returns the rung to switch to, or -1 to stay. The caller switches and
+   * then calls switched(). */
+  int observe_frame(int64_t now_us, int64_t busy_us);
+  void switched(size_t rung, int64_t now_us);
+
+private:
+  std::vector<RsLadderRung> ladder_;
+  size_t rung_ = 0;
+
+  double load_ = 0.0;
+  std::atomic<double> qos_{0.0};
+  std::atomic<int64_t> qos_time_us_{0};
+
+  int64_t hold_until_us_ = 0;
+  int64_t over_since_us_ = -1;
+  int64_t under_since_us_ = -1;
+  int64_t last_up_us_ = -1;
+  int64_t up_delay_us_ = 0;
+  const char *reason_ = "";
+};
+
+#endif /* __RS_ADAPTIVE_H__ */
@@ -0,0 +1,113 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rsarena.h"
+
+#include <cstdlib>
+
+static inline size_t
+round_up_cache_line (size_t bytes)
+{
+  return (bytes + RS_CACHE_LINE_SIZE - 1) & ~(RS_CACHE_LINE_SIZE - 1);
+}
+
+static void *
+aligned_block (size_t bytes)
+{
+  void *ptr = nullptr;
+  if (posix_memalign (&ptr, RS_CACHE_LINE_SIZE, round_up_cache_line (bytes)) != 0)
+    return nullptr;
+  return ptr;
+}
+
+RsArena::~RsArena ()
+{
+  release ();
+}
+
+bool
+RsArena::reserve (size_t bytes)
+{
+  reset ();
+  bytes = round_up_cache_line (bytes);
+  if (bytes <= capacity ())
+    return true;
+
+  void *block = aligned_block (bytes);
+  if (block == nullptr)
+    return false;
+
+  free (base_);
+  base_ = static_cast<uint8_t *> (block);
+  capacity_.store (bytes, std::memory_order_relaxed);
+  return true;
+}
+
+void
+RsArena::reset ()
+{
+  for (auto *chunk : overflow_chunks_)
+    free (chunk);
+  overflow_chunks_.clear ();
+
+  /* Grow to what the last frame really needed, so the next one fits. */
+  const size_t needed = used_ + overflow_bytes_;
+  used_ = 0;
+  overflow_bytes_ = 0;
+  if (needed > capacity ()) {
+    void *block = aligned_block (needed);
+    if (block != nullptr) {
+      free (base_);
+      base_ = static_cast<uint8_t *> (block);
+      capacity_.store (round_up_cache_line (needed), std::memory_order_relaxed);
+    }
+  }
+}
+
+void
+RsArena::release ()
+{
+  reset ();
+  free (base_);
+  base_ = nullptr;
+  capacity_.store (0, std::memory_order_relaxed);
+}
+
+void *
+RsArena::alloc (size_t bytes)
+{
+  bytes = round_up_cache_line (bytes);
+
+  void *ptr = nullptr;
+  if (base_ != nullptr && used_ + bytes <= capacity ()) {
+    ptr = base_ + used_;
+    used_ += bytes;
+  } else {
+    ptr = aligned_block (bytes);
+    if (ptr == nullptr)
+      return nullptr;
+    overflow_chunks_.push_back (ptr);
+    overflow_bytes_ += bytes;
+    overflows_.fetch_add (1, std::memory_order_relaxed);
+  }
+
+  if (used_ + overflow_bytes_ > high_water ())
+    high_water_.store (used_ + overflow_bytes_, std::memory_order_relaxed);
+  return ptr;
+}
@@ -0,0 +1,82 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_ARENA_H__
+#define __RS_ARENA_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+constexpr const size_t RS_CACHE_LINE_SIZE = 64;
+
+/* Per-instance scratch memory for per-frame temporaries.
+ *
+ * The arena is a single cache-line aligned block that is sized once at
+ * start from the negotiated stream modes and handed out with a bump
+ * pointer. reset() is called at the top of every frame, so nothing
+ * allocated from it may outlive the frame. Requests that do not fit are
+ * served from overflow chunks; the next reset() grows the main block to
+ * the observed high-water mark so steady state never touches the heap.
+ *
+ * Only one thread allocates; capacity(), high_water() and overflows() may
+ * be read from any other thread for statistics.
+ */
+class RsArena
+{
+public:
+  RsArena() = default;
+  ~RsArena();
+
+  RsArena(const RsArena &) = delete;
+  RsArena &operator=(const RsArena &) = delete;
+
+  /* (Re)allocate the main block. Only call between frames. */
+  bool reserve(size_t bytes);
+  /* Drop all allocations of the current frame. */
+  void reset();
+  /* Free everything, including the main block. */
+  void release();
+
+  /* Returns RS_CACHE_LINE_SIZE aligned memory valid until reset(). */
+  void *alloc(size_t bytes);
+
+  template <typename T>
+  T *alloc_array(size_t count)
+  {
+    return static_cast<T *>(alloc(count * sizeof(T)));
+  }
+
+  size_t capacity() const { return capacity_.load(std::memory_order_relaxed); }
+  size_t used() const { return used_ + overflow_bytes_; }
+  size_t high_water() const { return high_water_.load(std::memory_order_relaxed); }
+  uint64_t overflows() const { return overflows_.load(std::memory_order_relaxed); }
+
+private:
+  uint8_t *base_ = nullptr;
+  std::atomic<size_t> capacity_{0};
+  size_t used_ = 0;
+  size_t overflow_bytes_ = 0;
+  std::atomic<size_t> high_water_{0};
+  std::atomic<uint64_t> overflows_{0};
+  std::vector<void *> overflow_chunks_;
+};
+
+#endif /* __RS_ARENA_H__ */
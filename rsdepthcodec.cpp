@@ -0,0 +1,513 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rsdepthcodec.h"
+
+#include <cstring>
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+static const uint8_t FRAME_MAGIC[4] = { 'R', 'S', 'Z', '1' };
+static const uint8_t RECORD_MAGIC[8] = { 'R', 'S', 'D', 'R', 'E', 'C', '0', '1' };
+constexpr const size_t FRAME_HEADER_SIZE = 12;
+
+static inline void
+put_le16 (uint8_t * p, uint16_t v)
+{
+  p[0] = static_cast<uint8_t> (v);
+  p[1] = static_cast<uint8_t> (v >> 8);
+}
+
+static inline void
+put_le32 (uint8_t * p, uint32_t v)
+{
+  for (int i = 0; i < 4; ++i)
+    p[i] = static_cast<uint8_t> (v >> (8 * i));
+}
+
+static inline void
+put_le64 (uint8_t * p, uint64_t v)
+{
+  for (int i = 0; i < 8; ++i)
+    p[i] = static_cast<uint8_t> (v >> (8 * i));
+}
+
+static inline uint16_t
+get_le16 (const uint8_t * p)
+{
+  return static_cast<uint16_t> (p[0] | (p[1] << 8));
+}
+
+static inline uint32_t
+get_le32 (const uint8_t * p)
+{
+  return static_cast<uint32_t> (p[0]) | (static_cast<uint32_t> (p[1]) << 8) |
+      (static_cast<uint32_t> (p[2]) << 16) | (static_cast<uint32_t> (p[3]) << 24);
+}
+
+static inline uint64_t
+get_le64 (const uint8_t * p)
+{
+  return static_cast<uint64_t> (get_le32 (p)) |
+      (static_cast<uint64_t> (get_le32 (p + 4)) << 32);
+}
+
+#ifdef HAVE_ZSTD
+/* Left-neighbour prediction of one band into zigzag lo/hi byte planes */
+static void
+predict_band (const uint16_t * depth, size_t stride, int width, int rows, uint8_t * lo,
+    uint8_t * hi)
+{
+  for (int y = 0; y < rows; ++y) {
+    const uint16_t *row = depth + y * stride;
+    uint8_t *row_lo = lo + static_cast<size_t> (y) * width;
+    uint8_t *row_hi = hi + static_cast<size_t> (y) * width;
+
+    const uint16_t first = (y == 0) ? row[0] : static_cast<uint16_t> (row[0] - row[-static_cast<ptrdiff_t> (stride)]);
+    const int16_t r0 = static_cast<int16_t> (first);
+    const uint16_t z0 = static_cast<uint16_t> ((static_cast<uint16_t> (r0) << 1) ^
+        static_cast<uint16_t> (r0 >> 15));
+    row_lo[0] = static_cast<uint8_t> (z0);
+    row_hi[0] = static_cast<uint8_t> (z0 >> 8);
+
+    /* No loop-carried dependency: vectorizes */
+    for (int x = 1; x < width; ++x) {
+      const int16_t r = static_cast<int16_t> (row[x] - row[x - 1]);
+      const uint16_t z = static_cast<uint16_t> ((static_cast<uint16_t> (r) << 1) ^
+          static_cast<uint16_t> (r >> 15));
+      row_lo[x] = static_cast<uint8_t> (z);
+      row_hi[x] = static_cast<uint8_t> (z >> 8);
+    }
+  }
+}
+
+/* Inverse of predict_band */
+static void
+reconstruct_band (const uint8_t * lo, const uint8_t * hi, int width, int rows, uint16_t * depth)
+{
+  for (int y = 0; y < rows; ++y) {
+    uint16_t *row = depth + static_cast<size_t> (y) * width;
+    const uint8_t *row_lo = lo + static_cast<size_t> (y) * width;
+    const uint8_t *row_hi = hi + static_cast<size_t> (y) * width;
+
+    uint16_t pred = (y == 0) ? 0 : row[-width];
+    for (int x = 0; x < width; ++x) {
+      const uint16_t z = static_cast<uint16_t> (row_lo[x] | (row_hi[x] << 8));
+      const uint16_t r = static_cast<uint16_t> ((z >> 1) ^ (0u - (z & 1u)));
+      pred = static_cast<uint16_t> (pred + r);
+      row[x] = pred;
+    }
+  }
+}
+#endif
+
+RsDepthEncoder::~RsDepthEncoder ()
+{
+  release ();
+}
+
+bool
+RsDepthEncoder::available ()
+{
+#ifdef HAVE_ZSTD
+  return true;
+#else
+  return false;
+#endif
+}
+
+void
+RsDepthEncoder::release ()
+{
+#ifdef HAVE_ZSTD
+  for (auto *ctx : contexts_)
+    ZSTD_freeCCtx (ctx);
+#endif
+  contexts_.clear ();
+  max_size_ = 0;
+}
+
+bool
+RsDepthEncoder::init (int width, int height, int level, unsigned bands)
+{
+  release ();
+
+#ifdef HAVE_ZSTD
+  if (width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF) {
+    error_ = "unsupported frame size";
+    return false;
+  }
+
+  width_ = width;
+  height_ = height;
+  level_ = level;
+  if (bands == 0)
+    bands = 1;
+  band_rows_ = (height + static_cast<int> (bands) - 1) / static_cast<int> (bands);
+  const int n_bands = (height + band_rows_ - 1) / band_rows_;
+
+  for (int i = 0; i < n_bands; ++i) {
+    auto *ctx = ZSTD_createCCtx ();
+    if (ctx == nullptr) {
+      error_ = "failed to create zstd context";
+      release ();
+      return false;
+    }
+    contexts_.push_back (ctx);
+  }
+
+  const size_t band_bound = ZSTD_compressBound (static_cast<size_t> (width) * band_rows_ * 2);
+  max_size_ = FRAME_HEADER_SIZE + 4 * contexts_.size () + band_bound * contexts_.size ();
+  return true;
+#else
+  (void) width;
+  (void) height;
+  (void) level;
+  (void) bands;
+  error_ = "built without zstd";
+  return false;
+#endif
+}
+
+size_t
+RsDepthEncoder::encode (const uint16_t * depth, size_t depth_stride, uint8_t * out,
+    size_t out_size, RsArena * arena, RsWorkerPool * pool)
+{
+#ifdef HAVE_ZSTD
+  const size_t n_bands = contexts_.size ();
+  if (n_bands == 0 || out_size < max_size_)
+    return 0;
+
+  const size_t header_size = FRAME_HEADER_SIZE + 4 * n_bands;
+  const size_t band_bound = ZSTD_compressBound (static_cast<size_t> (width_) * band_rows_ * 2);
+  uint8_t *planes = arena->alloc_array<uint8_t> (static_cast<size_t> (width_) * height_ * 2);
+  size_t *sizes = arena->alloc_array<size_t> (n_bands);
+  if (planes == nullptr || sizes == nullptr)
+    return 0;
+
+  /* Each band compresses into its own worst-case slot, compacted below */
+  auto encode_band = [&] (size_t i) {
+    const int y0 = static_cast<int> (i) * band_rows_;
+    const int rows = (y0 + band_rows_ <= height_) ? band_rows_ : height_ - y0;
+    const size_t n = static_cast<size_t> (width_) * rows;
+    uint8_t *lo = planes + static_cast<size_t> (width_) * y0 * 2;
+
+    const size_t stride = depth_stride / sizeof (uint16_t);
+    predict_band (depth + stride * y0, stride, width_, rows, lo, lo + n);
+
+    const size_t res = ZSTD_compressCCtx (contexts_[i], out + header_size + i * band_bound,
+        band_bound, lo, n * 2, level_);
+    sizes[i] = ZSTD_isError (res) ? 0 : res;
+  };
+  if (pool != nullptr)
+    pool->parallel_for (n_bands, encode_band);
+  else
+    for (size_t i = 0; i < n_bands; ++i)
+      encode_band (i);
+
+  memcpy (out, FRAME_MAGIC, sizeof (FRAME_MAGIC));
+  put_le16 (out + 4, static_cast<uint16_t> (width_));
+  put_le16 (out + 6, static_cast<uint16_t> (height_));
+  put_le16 (out + 8, static_cast<uint16_t> (n_bands));
+  put_le16 (out + 10, static_cast<uint16_t> (band_rows_));
+
+  size_t pos = header_size;
+  for (size_t i = 0; i < n_bands; ++i) {
+    if (sizes[i] == 0) {
+      error_ = "zstd compression failed";
+      return 0;
+    }
+    put_le32 (out + FRAME_HEADER_SIZE + 4 * i, static_cast<uint32_t> (sizes[i]));
+    memmove (out + pos, out + header_size + i * band_bound, sizes[i]);
+    pos += sizes[i];
+  }
+  return pos;
+#else
+  (void) depth;
+  (void) depth_stride;
+  (void) out;
+  (void) out_size;
+  (void) arena;
+  (void) pool;
+  return 0;
+#endif
+}
+
+RsDepthDecoder::~RsDepthDecoder ()
+{
+#ifdef HAVE_ZSTD
+  for (auto *ctx : contexts_)
+    ZSTD_freeDCtx (ctx);
+#endif
+}
+
+bool
+RsDepthDecoder::peek (const uint8_t * in, size_t size, int *width, int *height)
+{
+  if (size < FRAME_HEADER_SIZE || memcmp (in, FRAME_MAGIC, sizeof (FRAME_MAGIC)) != 0)
+    return false;
+  *width = get_le16 (in + 4);
+  *height = get_le16 (in + 6);
+  return true;
+}
+
+bool
+RsDepthDecoder::decode (const uint8_t * in, size_t size, uint16_t * out, RsWorkerPool * pool)
+{
+#ifdef HAVE_ZSTD
+  int width = 0, height = 0;
+  if (!peek (in, size, &width, &height)) {
+    error_ = "not a compressed depth frame";
+    return false;
+  }
+  const size_t n_bands = get_le16 (in + 8);
+  const int band_rows = get_le16 (in + 10);
+  const size_t header_size = FRAME_HEADER_SIZE + 4 * n_bands;
+  if (n_bands == 0 || band_rows == 0 || size < header_size ||
+      (height + band_rows - 1) / band_rows != static_cast<int> (n_bands)) {
+    error_ = "corrupt depth frame header";
+    return false;
+  }
+
+  std::vector<size_t> offsets (n_bands + 1);
+  offsets[0] = header_size;
+  for (size_t i = 0; i < n_bands; ++i)
+    offsets[i + 1] = offsets[i] + get_le32 (in + FRAME_HEADER_SIZE + 4 * i);
+  if (offsets[n_bands] > size) {
+    error_ = "truncated depth frame";
+    return false;
+  }
+
+  while (contexts_.size () < n_bands) {
+    auto *ctx = ZSTD_createDCtx ();
+    if (ctx == nullptr) {
+      error_ = "failed to create zstd context";
+      return false;
+    }
+    contexts_.push_back (ctx);
+  }
+  planes_.resize (n_bands);
+
+  std::vector<char> ok (n_bands, 0);
+  auto decode_band = [&] (size_t i) {
+    const int y0 = static_cast<int> (i) * band_rows;
+    const int rows = (y0 + band_rows <= height) ? band_rows : height - y0;
+    const size_t n = static_cast<size_t> (width) * rows;
+
+    auto &plane = planes_[i];
+    if (plane.size () < n * 2)
+      plane.resize (n * 2);
+    const size_t res = ZSTD_decompressDCtx (contexts_[i], plane.data (), n * 2,
+        in + offsets[i], offsets[i + 1] - offsets[i]);
+    if (ZSTD_isError (res) || res != n * 2)
+      return;
+
+    reconstruct_band (plane.data (), plane.data () + n, width, rows,
+        out + static_cast<size_t> (width) * y0);
+    ok[i] = 1;
+  };
+  if (pool != nullptr)
+    pool->parallel_for (n_bands, decode_band);
+  else
+    for (size_t i = 0; i < n_bands; ++i)
+      decode_band (i);
+
+  for (char band_ok : ok) {
+    if (!band_ok) {
+      error_ = "zstd decompression failed";
+      return false;
+    }
+  }
+  return true;
+#else
+  (void) in;
+  (void) size;
+  (void) out;
+  (void) pool;
+  error_ = "built without zstd";
+  return false;
+#endif
+}
+
+RsDepthRecorder::~RsDepthRecorder ()
+{
+  close ();
+}
+
+bool
+RsDepthRecorder::open (const std::string & path, size_t max_queued)
+{
+  close ();
+
+  file_ = fopen (path.c_str (), "wb");
+  if (file_ == nullptr)
+    return false;
+  if (fwrite (RECORD_MAGIC, 1, sizeof (RECORD_MAGIC), file_) != sizeof (RECORD_MAGIC)) {
+    fclose (file_);
+    file_ = nullptr;
+    return false;
+  }
+
+  max_queued_ = max_queued ? max_queued : 1;
+  quit_ = false;
+  written_ = 0;
+  dropped_ = 0;
+  bytes_ = sizeof (RECORD_MAGIC);
+  writer_ = std::thread (&RsDepthRecorder::writer_loop, this);
+  return true;
+}
+
+void
+RsDepthRecorder::close ()
+{
+  if (file_ == nullptr)
+    return;
+
+  {
+    std::lock_guard<std::mutex> guard (lock_);
+    quit_ = true;
+  }
+  wake_.notify_one ();
+  writer_.join ();
+
+  fclose (file_);
+  file_ = nullptr;
+  spare_.clear ();
+}
+
+std::vector<uint8_t>
+RsDepthRecorder::take_spare ()
+{
+  std::lock_guard<std::mutex> guard (lock_);
+  if (spare_.empty ())
+    return {};
+  auto frame = std::move (spare_.back ());
+  spare_.pop_back ();
+  return frame;
+}
+
+void
+RsDepthRecorder::give_spare (std::vector<uint8_t> && frame)
+{
+  std::lock_guard<std::mutex> guard (lock_);
+  if (spare_.size () < max_queued_)
+    spare_.push_back (std::move (frame));
+}
+
+void
+RsDepthRecorder::set_max_queued (size_t max_queued)
+{
+  std::lock_guard<std::mutex> guard (lock_);
+  max_queued_ = max_queued ? max_queued : 1;
+  if (spare_.size () > max_queued_)
+    spare_.resize (max_queued_);
+}
+
+bool
+RsDepthRecorder::push (uint64_t timestamp_ns, std::vector<uint8_t> && frame, size_t size)
+{
+  std::lock_guard<std::mutex> guard (lock_);
+  if (queue_.size () >= max_queued_) {
+    ++dropped_;
+    spare_.push_back (std::move (frame));
+    return false;
+  }
+  queue_.push_back (Entry { timestamp_ns, std::move (frame), size });
+  wake_.notify_one ();
+  return true;
+}
+
+void
+RsDepthRecorder::writer_loop ()
+{
+  std::unique_lock<std::mutex> guard (lock_);
+  for (;;) {
+    wake_.wait (guard, [&] { return quit_ || !queue_.empty (); });
+    if (queue_.empty ())
+      return; /* quit_ with nothing left to flush */
+
+    Entry entry = std::move (queue_.front ());
+    queue_.pop_front ();
+    guard.unlock ();
+
+    uint8_t header[12];
+    put_le64 (header, entry.timestamp_ns);
+    put_le32 (header + 8, static_cast<uint32_t> (entry.size));
+    const bool ok = fwrite (header, 1, sizeof (header), file_) == sizeof (header) &&
+        fwrite (entry.data.data (), 1, entry.size, file_) == entry.size;
+
+    guard.lock ();
+    if (ok) {
+      ++written_;
+      bytes_ += sizeof (header) + entry.size;
+    } else {
+      ++dropped_;
+    }
+    spare_.push_back (std::move (entry.data));
+  }
+}
+
+RsDepthReader::~RsDepthReader ()
+{
+  if (file_ != nullptr)
+    fclose (file_);
+}
+
+bool
+RsDepthReader::open (const std::string & path)
+{
+  if (file_ != nullptr)
+    fclose (file_);
+
+  file_ = fopen (path.c_str (), "rb");
+  if (file_ == nullptr)
+    return false;
+
+  uint8_t magic[sizeof (RECORD_MAGIC)];
+  if (fread (magic, 1, sizeof (magic), file_) != sizeof (magic) ||
+      memcmp (magic, RECORD_MAGIC, sizeof (magic)) != 0) {
+    fclose (file_);
+    file_ = nullptr;
+    return false;
+  }
+  return true;
+}
+
+bool
+RsDepthReader::next (uint64_t * timestamp_ns, int *width, int *height,
+    std::vector<uint16_t> & depth, RsWorkerPool * pool)
+{
+  if (file_ == nullptr)
+    return false;
+
+  uint8_t header[12];
+  if (fread (header, 1, sizeof (header), file_) != sizeof (header))
+    return false;
+  *timestamp_ns = get_le64 (header);
+  payload_.resize (get_le32 (header + 8));
+  if (fread (payload_.data (), 1, payload_.size (), file_) != payload_.size ())
+    return false;
+
+  if (!RsDepthDecoder::peek (payload_.data (), payload_.size (), width, height))
+    return false;
+  depth.resize (static_cast<size_t> (*width) * *height);
+  return decoder_.decode (payload_.data (), payload_.size (), depth.data (), pool);
+}
@@ -0,0 +1,194 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_DEPTH_CODEC_H__
+#define __RS_DEPTH_CODEC_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rsarena.h"
+#include "rsworkerpool.h"
+
+/* Lossless Z16 depth compression for recording.
+ *
+ * A frame is split into bands of whole rows. Within a band every pixel is
+ * predicted from its left neighbour (the first pixel of a row from the one
+ * above), the residual is zigzag coded and split into a low-byte and a
+ * high-byte plane, and each band is compressed with zstd on its own. Bands
+ * are independent, so encode and decode both run one band per worker.
+ *
+ * Frame layout, little endian:
+ *   u32 magic "RSZ1", u16 width, u16 height, u16 bands, u16 rows per band,
+ *   u32 compressed size of each band, then the band payloads.
+ *
+ * Without zstd (HAVE_ZSTD unset) init() always fails.
+ */
+
+struct ZSTD_CCtx_s;
+struct ZSTD_DCtx_s;
+
+class RsDepthEncoder
+{
+public:
+  RsDepthEncoder() = default;
+  ~RsDepthEncoder();
+
+  RsDepthEncoder(const RsDepthEncoder &) = delete;
+  RsDepthEncoder &operator=(const RsDepthEncoder &) = delete;
+
+  static bool available();
+
+  bool init(int width, int height, int level, unsigned bands);
+
+  size_t max_size() const { return max_size_; }
+
+  /* depth is width x height with rows depth_stride bytes apart. Residual
+   * planes come from arena; returns bytes written or 0. */
+  size_t encode(const uint16_t *depth, size_t depth_stride, uint8_t *out, size_t out_size,
+      RsArena *arena, RsWorkerPool *pool);
+
+  const std::string &last_error() const { return error_; }
+
+private:
+  void release();
+
+  int width_ = 0;
+  int height_ = 0;
+  int level_ = 3;
+  int band_rows_ = 0;
+  size_t max_size_ = 0;
+  std::vector<ZSTD_CCtx_s *> contexts_;
+  std::string error_;
+};
+
+class RsDepthDecoder
+{
+public:
+  RsDepthDecoder() = default;
+  ~RsDepthDecoder();
+
+  RsDepthDecoder(const RsDepthDecoder &) = delete;
+  RsDepthDecoder &operator=(const RsDepthDecoder &) = delete;
+
+  /* Reads the frame dimensions without decoding. */
+  static bool peek(const uint8_t *in, size_t size, int *width, int *height);
+
+  /* out must hold width * height pixels; pool may be nullptr. */
+  bool decode(const uint8_t *in, size_t size, uint16_t *out, RsWorkerPool *pool);
+
+  const std::string &last_error() const { return error_; }
+
+private:
+  std::vector<ZSTD_DCtx_s *> contexts_;
+  std::vector<std::vector<uint8_t>> planes_;
+  std::string error_;
+};
+
+/* Appends compressed depth frames to a recording on a writer thread.
+ *
+ * File layout: 8 byte magic "RSDREC01", then per frame a u64 timestamp in
+ * nanoseconds, a u32 payload size and one RsDepthEncoder frame. The queue
+ * to the writer is bounded so a slow disk drops frames instead of
+ * stalling capture.
+ */
+class RsDepthRecorder
+{
+public:
+  RsDepthRecorder() = default;
+  ~RsDepthRecorder();
+
+  RsDepthRecorder(const RsDepthRecorder &) = delete;
+  RsDepthRecorder &operator=(const RsDepthRecorder &) = delete;
+
+  bool open(const std::string &path, size_t max_queued);
+  void close();
+
+  /* Changes the queue bound; frames already queued are kept, surplus
+   * spare vectors are freed. */
+  void set_max_queued(size_t max_queued);
+
+  /* Queues the first size bytes of frame and takes ownership of it;
+   * returns false if it had to be dropped. */
+  bool push(uint64_t timestamp_ns, std::vector<uint8_t> &&frame, size_t size);
+
+  /* Hands out a recycled frame vector so steady state does not allocate.
+   * Its size is whatever it was last pushed with. */
+  std::vector<uint8_t> take_spare();
+  /* Returns a vector from take_spare() that was not pushed */
+  void give_spare(std::vector<uint8_t> &&frame);
+
+  uint64_t written() const { return written_; }
+  uint64_t dropped() const { return dropped_; }
+  uint64_t bytes() const { return bytes_; }
+
+private:
+  struct Entry
+  {
+    uint64_t timestamp_ns;
+    std::vector<uint8_t> data;
+    size_t size;
+  };
+
+  void writer_loop();
+
+  FILE *file_ = nullptr;
+  std::thread writer_;
+  std::mutex lock_;
+  std::condition_variable wake_;
+  std::deque<Entry> queue_;
+  std::vector<std::vector<uint8_t>> spare_;
+  size_t max_queued_ = 4;
+  bool quit_ = false;
+  std::atomic<uint64_t> written_{0};
+  std::atomic<uint64_t> dropped_{0};
+  std::atomic<uint64_t> bytes_{0};
+};
+
+/* Sequential reader for recordings written by RsDepthRecorder. */
+class RsDepthReader
+{
+public:
+  RsDepthReader() = default;
+  ~RsDepthReader();
+
+  RsDepthReader(const RsDepthReader &) = delete;
+  RsDepthReader &operator=(const RsDepthReader &) = delete;
+
+  bool open(const std::string &path);
+
+  /* Reads the next frame into depth (resized to fit); false at the end. */
+  bool next(uint64_t *timestamp_ns, int *width, int *height,
+      std::vector<uint16_t> &depth, RsWorkerPool *pool = nullptr);
+
+private:
+  FILE *file_ = nullptr;
+  std::vector<uint8_t> payload_;
+  RsDepthDecoder decoder_;
+};
+
+#endif /* __RS_DEPTH_CODEC_H__ */
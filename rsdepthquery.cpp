@@ -0,0 +1,101 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rsdepthquery.h"
+
+#include <algorithm>
+
+#include <librealsense2/rsutil.h>
+
+#include "rsreproject.h"
+
+/* Search range along the color ray when projecting into depth, in metres */
+static constexpr float PROJECT_MIN_DEPTH = 0.1f;
+static constexpr float PROJECT_MAX_DEPTH = 10.0f;
+
+void
+RsDepthQuery::configure (const rs2::pipeline_profile & profile, bool project_color,
+    float color_scale, bool undistorted_color)
+{
+  Calibration calibration;
+  calibration.depth_scale = profile.get_device ().first<rs2::depth_sensor> ().get_depth_scale ();
+  calibration.project_color = project_color;
+  if (project_color) {
+    auto depth = profile.get_stream (RS2_STREAM_DEPTH).as<rs2::video_stream_profile> ();
+    auto color = profile.get_stream (RS2_STREAM_COLOR).as<rs2::video_stream_profile> ();
+    calibration.depth_intrin = depth.get_intrinsics ();
+    calibration.color_intrin = rs_scale_intrinsics (color.get_intrinsics (), color_scale);
+    if (undistorted_color) {
+      calibration.color_intrin.model = RS2_DISTORTION_NONE;
+      std::fill (std::begin (calibration.color_intrin.coeffs),
+          std::end (calibration.color_intrin.coeffs), 0.0f);
+    }
+    calibration.color_to_depth = color.get_extrinsics_to (depth);
+    calibration.depth_to_color = depth.get_extrinsics_to (color);
+  }
+
+  std::lock_guard<std::mutex> guard (lock_);
+  calibration_ = calibration;
+}
+
+void
+RsDepthQuery::update (const rs2::frame & depth)
+{
+  std::lock_guard<std::mutex> guard (lock_);
+  frame_ = depth;
+}
+
+void
+RsDepthQuery::clear ()
+{
+  std::lock_guard<std::mutex> guard (lock_);
+  frame_ = rs2::frame ();
+}
+
+bool
+RsDepthQuery::query (const float *points, size_t n, bool color_space, float *metres) const
+{
+  rs2::frame frame;
+  Calibration c;
+  {
+    std::lock_guard<std::mutex> guard (lock_);
+    frame = frame_;
+    c = calibration_;
+  }
+  if (!frame)
+    return false;
+
+  const rs2::video_frame depth (frame);
+  const auto *data = static_cast<const uint16_t *> (depth.get_data ());
+  const int width = depth.get_width ();
+  const int height = depth.get_height ();
+  const size_t stride = depth.get_stride_in_bytes () / sizeof (uint16_t);
+
+  for (size_t i = 0; i < n; ++i) {
+    float pixel[2] = { points[2 * i], points[2 * i + 1] };
+    if (color_space && c.project_color) {
+      const float from[2] = { pixel[0], pixel[1] };
+      rs2_project_color_pixel_to_depth_pixel (pixel, data, c.depth_scale, PROJECT_MIN_DEPTH,
+          PROJECT_MAX_DEPTH, &c.depth_intrin, &c.color_intrin, &c.color_to_depth,
+          &c.depth_to_color, from);
+    }
+    metres[i] = rs_depth_at (data, stride, width, height, c.depth_scale, pixel[0], pixel[1]);
+  }
+  return true;
+}
@@ -0,0 +1,84 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_DEPTH_QUERY_H__
+#define __RS_DEPTH_QUERY_H__
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+#include <librealsense2/rs.hpp>
+
+/* Depth in metres at pixel (x, y) of a depth plane with stride in pixels,
+ * 0 outside the plane or where there is no depth. Pixel (i, j) covers
+ * [i, i + 1) x [j, j + 1). */
+inline float
+rs_depth_at(const uint16_t *data, size_t stride, int width, int height, float depth_scale,
+    float x, float y)
+{
+  const float fx = std::floor(x), fy = std::floor(y);
+  if (!(fx >= 0 && fy >= 0 && fx < width && fy < height))
+    return 0.0f;
+  return data[static_cast<size_t>(fy) * stride + static_cast<size_t>(fx)] * depth_scale;
+}
+
+/* Point queries against the most recent depth frame.
+ *
+ * The streaming thread hands over a reference to each depth frame with
+ * update(); only the frame handle is swapped under the lock, the pixels
+ * are never copied. Queries take their own reference and read outside
+ * the lock, so a slow query cannot stall streaming. */
+class RsDepthQuery
+{
+public:
+  /* Depth scale and, when color pixels must be projected (depth not
+   * aligned), the stream intrinsics/extrinsics of the active profile.
+   * Color pixels are on the color image scaled by color_scale, and with
+   * undistorted_color on its undistorted version. */
+  void configure(const rs2::pipeline_profile &profile, bool project_color,
+      float color_scale = 1.0f, bool undistorted_color = false);
+
+  void update(const rs2::frame &depth);
+  /* Drop the cached frame, e.g. before the pipeline stops */
+  void clear();
+
+  /* points holds n (x, y) pairs in color (color_space) or depth pixels.
+   * Writes n distances in metres, 0 where there is no depth. Returns
+   * false if no frame has been received yet. */
+  bool query(const float *points, size_t n, bool color_space, float *metres) const;
+
+private:
+  struct Calibration
+  {
+    float depth_scale = 0.001f;
+    bool project_color = false;
+    rs2_intrinsics depth_intrin = {};
+    rs2_intrinsics color_intrin = {};
+    rs2_extrinsics color_to_depth = {};
+    rs2_extrinsics depth_to_color = {};
+  };
+
+  mutable std::mutex lock_;
+  rs2::frame frame_;
+  Calibration calibration_;
+};
+
+#endif /* __RS_DEPTH_QUERY_H__ */
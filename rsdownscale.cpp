@@ -0,0 +1,133 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rsdownscale.h"
+
+#include <algorithm>
+#include <cstring>
+
+static constexpr int MAX_BANDS = 64;
+/* Output pixels per column-sum chunk; the sums stay in L1 */
+static constexpr int CHUNK = 64;
+
+/* Rounded mean of the count samples summing to sum, with recip =
+ * ceil(2^32 / count). Exact for count <= 64 and sums of 8-bit samples. */
+static inline uint8_t
+block_mean (uint32_t sum, uint32_t count, uint64_t recip)
+{
+  return static_cast<uint8_t> (((sum + count / 2) * recip) >> 32);
+}
+
+static inline uint64_t
+reciprocal (uint32_t count)
+{
+  return ((uint64_t (1) << 32) + count - 1) / count;
+}
+
+/* Fixed is the factor when known at compile time (common 2 and 4, which
+ * lets the block loops unroll), 0 to use factor */
+template <int Fixed>
+static void
+downscale_rows (const uint8_t * in, size_t in_stride, int width, int height, int factor,
+    uint8_t * out, size_t out_stride, int oy0, int oy1)
+{
+  if (Fixed)
+    factor = Fixed;
+  const int out_width = rs_downscale_size (width, factor);
+  /* Output columns whose block lies fully inside the image */
+  const int full_width = width / factor;
+  /* Column sums of one chunk: at most 8 rows of 255 fit 16 bits */
+  uint16_t sums[CHUNK * RS_DOWNSCALE_MAX_FACTOR * 3];
+
+  for (int oy = oy0; oy < oy1; ++oy) {
+    const int y0 = oy * factor, y1 = std::min (y0 + factor, height);
+    const uint32_t count = factor * (y1 - y0);
+    const uint64_t recip = reciprocal (count);
+    uint8_t *dst = out + oy * out_stride;
+
+    for (int ox0 = 0; ox0 < out_width; ox0 += CHUNK) {
+      const int ox1 = std::min (ox0 + CHUNK, out_width);
+      const int x0 = ox0 * factor, x1 = std::min (ox1 * factor, width);
+      const int n = (x1 - x0) * 3;
+
+      const uint8_t *row = in + y0 * in_stride + x0 * 3;
+      for (int i = 0; i < n; ++i)
+        sums[i] = row[i];
+      for (int y = y0 + 1; y < y1; ++y) {
+        row = in + y * in_stride + x0 * 3;
+        for (int i = 0; i < n; ++i)
+          sums[i] += row[i];
+      }
+
+      const int full_end = std::min (ox1, full_width);
+      for (int ox = ox0; ox < full_end; ++ox) {
+        const uint16_t *block = sums + (ox - ox0) * factor * 3;
+        for (int c = 0; c < 3; ++c) {
+          uint32_t sum = 0;
+          for (int k = 0; k < factor; ++k)
+            sum += block[3 * k + c];
+          dst[3 * ox + c] = block_mean (sum, count, recip);
+        }
+      }
+      /* The last column, cut by the right edge */
+      if (full_end < ox1) {
+        const int bx0 = (full_end - ox0) * factor, bx1 = x1 - x0;
+        const uint32_t edge_count = (bx1 - bx0) * (y1 - y0);
+        const uint64_t edge_recip = reciprocal (edge_count);
+        for (int c = 0; c < 3; ++c) {
+          uint32_t sum = 0;
+          for (int x = bx0; x < bx1; ++x)
+            sum += sums[3 * x + c];
+          dst[3 * full_end + c] = block_mean (sum, edge_count, edge_recip);
+        }
+      }
+    }
+  }
+}
+
+void
+rs_downscale_rgb (const uint8_t * in, size_t in_stride, int width, int height, int factor,
+    uint8_t * out, size_t out_stride, RsWorkerPool * pool)
+{
+  factor = std::max (1, std::min (factor, RS_DOWNSCALE_MAX_FACTOR));
+  if (factor == 1) {
+    for (int y = 0; y < height; ++y)
+      memcpy (out + y * out_stride, in + y * in_stride, static_cast<size_t> (width) * 3);
+    return;
+  }
+
+  const int out_height = rs_downscale_size (height, factor);
+  const int n_bands = pool ? std::min<int> ({ static_cast<int> (pool->size ()) * 2, MAX_BANDS,
+      std::max (out_height, 1) }) : 1;
+  auto run = [&] (size_t band) {
+    const int oy0 = static_cast<int> (band * out_height / n_bands);
+    const int oy1 = static_cast<int> ((band + 1) * out_height / n_bands);
+    if (factor == 2)
+      downscale_rows<2> (in, in_stride, width, height, factor, out, out_stride, oy0, oy1);
+    else if (factor == 4)
+      downscale_rows<4> (in, in_stride, width, height, factor, out, out_stride, oy0, oy1);
+    else
+      downscale_rows<0> (in, in_stride, width, height, factor, out, out_stride, oy0, oy1);
+  };
+
+  if (n_bands > 1)
+    pool->parallel_for (n_bands, run);
+  else
+    run (0);
+}
@@ -0,0 +1,45 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_DOWNSCALE_H__
+#define __RS_DOWNSCALE_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "rsworkerpool.h"
+
+constexpr const int RS_DOWNSCALE_MAX_FACTOR = 8;
+
+/* Size of a width x height image reduced by factor, rounded up like the
+ * grids of rs_scale_intrinsics() */
+inline int
+rs_downscale_size (int size, int factor)
+{
+  return (size + factor - 1) / factor;
+}
+
+/* Box filters RGB by an integer factor (1 to RS_DOWNSCALE_MAX_FACTOR): each
+ * output pixel is the rounded mean of its factor x factor input block, or
+ * of the part of it inside the image at the right and bottom edges. Output
+ * rows are split into bands across pool when given. */
+void rs_downscale_rgb(const uint8_t *in, size_t in_stride, int width, int height,
+    int factor, uint8_t *out, size_t out_stride, RsWorkerPool *pool);
+
+#endif /* __RS_DOWNSCALE_H__ */
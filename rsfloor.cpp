@@ -0,0 +1,325 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rsfloor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+#include <librealsense2/rsutil.h>
+
+static constexpr int MAX_BANDS = 64;
+static constexpr int MIN_SAMPLES = 64;
+static constexpr int MAX_HYPOTHESES = 1024;
+/* Hypotheses between two clock reads */
+static constexpr int BATCH = 16;
+/* Inlier tolerance in metres: base plus a share of the range, as depth
+ * noise grows with distance */
+static constexpr float TOLERANCE_BASE = 0.01f;
+static constexpr float TOLERANCE_SLOPE = 0.01f;
+/* Floor normals are within 45 degrees of -y */
+static constexpr float MIN_UP = 0.7071f;
+/* The previous plane is kept while it holds this share of the inliers its
+ * last RANSAC fit had, and at least TRACK_MIN_RATIO of the samples */
+static constexpr float TRACK_KEEP = 0.9f;
+static constexpr float TRACK_MIN_RATIO = 0.1f;
+/* Confidence that one all-inlier hypothesis was drawn, for stopping early */
+static constexpr double CONFIDENCE = 0.99;
+
+using Clock = std::chrono::steady_clock;
+
+void
+RsFloorEstimator::configure (const rs2_intrinsics & intrin, float depth_scale)
+{
+  depth_scale_ = depth_scale;
+  width_ = intrin.width;
+  height_ = intrin.height;
+  previous_ = {};
+
+  /* Square grid of at most MAX_SAMPLES pixels, centred in its cells */
+  const int step = std::max (1, static_cast<int> (std::ceil (std::sqrt (
+      static_cast<double> (width_) * height_ / MAX_SAMPLES))));
+  offsets_.clear ();
+  rays_.clear ();
+  for (int y = step / 2; y < height_; y += step) {
+    for (int x = step / 2; x < width_; x += step) {
+      const float pixel[2] = { static_cast<float> (x), static_cast<float> (y) };
+      float ray[3];
+      rs2_deproject_pixel_to_point (ray, &intrin, pixel, 1.0f);
+      offsets_.push_back (static_cast<uint32_t> (y) * width_ + x);
+      rays_.push_back (ray[0]);
+      rays_.push_back (ray[1]);
+    }
+  }
+  points_.reserve (offsets_.size () * 4);
+}
+
+namespace {
+
+struct Hypothesis
+{
+  float n[3];
+  float d;
+};
+
+inline uint32_t
+xorshift (uint32_t * state)
+{
+  uint32_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  return *state = x;
+}
+
+/* Plane through three points, oriented to the camera; false unless it is
+ * well defined and floor-like */
+bool
+plane_from_points (const float *a, const float *b, const float *c, Hypothesis * h)
+{
+  const float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+  const float v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+  float n[3] = { u[1] * v[2] - u[2] * v[1], u[2] * v[0] - u[0] * v[2], u[0] * v[1] - u[1] * v[0] };
+  const float len = std::sqrt (n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+  if (len < 1e-9f)
+    return false;
+  float d = -(n[0] * a[0] + n[1] * a[1] + n[2] * a[2]) / len;
+  const float sign = d < 0.0f ? -1.0f : 1.0f;
+  for (int i = 0; i < 3; ++i)
+    h->n[i] = sign * n[i] / len;
+  h->d = sign * d;
+  return -h->n[1] >= MIN_UP;
+}
+
+int
+count_inliers (const std::vector<float> & points, const Hypothesis & h)
+{
+  const float *p = points.data ();
+  const size_t n = points.size () / 4;
+  int count = 0;
+  for (size_t i = 0; i < n; ++i, p += 4)
+    count += std::fabs (h.n[0] * p[0] + h.n[1] * p[1] + h.n[2] * p[2] + h.d) <= p[3];
+  return count;
+}
+
+/* Hypotheses needed to draw one all-inlier sample with CONFIDENCE */
+int
+needed_hypotheses (int inliers, int samples)
+{
+  const double w = static_cast<double> (inliers) / samples;
+  const double p = w * w * w;
+  if (p >= 1.0)
+    return 1;
+  if (p <= 0.0)
+    return MAX_HYPOTHESES;
+  return static_cast<int> (std::min<double> (MAX_HYPOTHESES,
+      std::ceil (std::log (1.0 - CONFIDENCE) / std::log (1.0 - p))));
+}
+
+/* Eigenvector of the smallest eigenvalue of a symmetric 3x3 matrix, by
+ * cyclic Jacobi rotations */
+void
+smallest_eigenvector (double a[3][3], float *out)
+{
+  double v[3][3] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+  for (int sweep = 0; sweep < 16; ++sweep) {
+    const double off = a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2];
+    if (off < 1e-20)
+      break;
+    for (int p = 0; p < 2; ++p) {
+      for (int q = p + 1; q < 3; ++q) {
+        if (a[p][q] == 0.0)
+          continue;
+        const double theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+        const double t = (theta >= 0 ? 1.0 : -1.0)
+            / (std::fabs (theta) + std::sqrt (theta * theta + 1.0));
+        const double c = 1.0 / std::sqrt (t * t + 1.0), s = t * c;
+        for (int k = 0; k < 3; ++k) {
+          const double akp = a[k][p], akq = a[k][q];
+          a[k][p] = c * akp - s * akq;
+          a[k][q] = s * akp + c * akq;
+        }
+        for (int k = 0; k < 3; ++k) {
+          const double apk = a[p][k], aqk = a[q][k];
+          a[p][k] = c * apk - s * aqk;
+          a[q][k] = s * apk + c * aqk;
+        }
+        for (int k = 0; k < 3; ++k) {
+          const double vkp = v[k][p], vkq = v[k][q];
+          v[k][p] = c * vkp - s * vkq;
+          v[k][q] = s * vkp + c * vkq;
+        }
+      }
+    }
+  }
+  int min = 0;
+  for (int i = 1; i < 3; ++i)
+    if (a[i][i] < a[min][min])
+      min = i;
+  for (int k = 0; k < 3; ++k)
+    out[k] = static_cast<float> (v[k][min]);
+}
+
+/* Least squares plane through the inliers of h; keeps h if the refit is
+ * degenerate or no longer floor-like */
+Hypothesis
+refine (const std::vector<float> & points, const Hypothesis & h)
+{
+  double sum[3] = { 0, 0, 0 }, sq[3][3] = { { 0 } };
+  int count = 0;
+  const float *p = points.data ();
+  for (size_t i = 0; i < points.size () / 4; ++i, p += 4) {
+    if (std::fabs (h.n[0] * p[0] + h.n[1] * p[1] + h.n[2] * p[2] + h.d) > p[3])
+      continue;
+    for (int j = 0; j < 3; ++j) {
+      sum[j] += p[j];
+      for (int k = j; k < 3; ++k)
+        sq[j][k] += static_cast<double> (p[j]) * p[k];
+    }
+    ++count;
+  }
+  if (count < 3)
+    return h;
+
+  double cov[3][3];
+  double mean[3];
+  for (int j = 0; j < 3; ++j)
+    mean[j] = sum[j] / count;
+  for (int j = 0; j < 3; ++j)
+    for (int k = j; k < 3; ++k)
+      cov[j][k] = cov[k][j] = sq[j][k] / count - mean[j] * mean[k];
+
+  Hypothesis fit;
+  smallest_eigenvector (cov, fit.n);
+  fit.d = -static_cast<float> (fit.n[0] * mean[0] + fit.n[1] * mean[1] + fit.n[2] * mean[2]);
+  if (fit.d < 0.0f) {
+    for (float &c : fit.n)
+      c = -c;
+    fit.d = -fit.d;
+  }
+  return -fit.n[1] >= MIN_UP ? fit : h;
+}
+
+}  // namespace
+
+RsFloorPlane
+RsFloorEstimator::estimate (const uint16_t * depth, size_t stride, int64_t budget_us,
+    RsWorkerPool * pool)
+{
+  const auto deadline = Clock::now () + std::chrono::microseconds (budget_us);
+  RsFloorPlane result = {};
+
+  /* Valid samples as points, each with its inlier tolerance */
+  points_.clear ();
+  const auto *base = reinterpret_cast<const uint8_t *> (depth);
+  for (size_t i = 0; i < offsets_.size (); ++i) {
+    const uint32_t y = offsets_[i] / width_, x = offsets_[i] % width_;
+    const uint16_t raw = reinterpret_cast<const uint16_t *> (base + y * stride)[x];
+    if (!raw)
+      continue;
+    const float z = raw * depth_scale_;
+    points_.insert (points_.end (), { rays_[2 * i] * z, rays_[2 * i + 1] * z, z,
+        TOLERANCE_BASE + TOLERANCE_SLOPE * z });
+  }
+  const int n_points = static_cast<int> (points_.size () / 4);
+  result.samples = n_points;
+  if (n_points < MIN_SAMPLES) {
+    previous_.valid = false;
+    return result;
+  }
+
+  Hypothesis best = {};
+  int best_count = 0;
+  if (previous_.valid) {
+    std::copy (previous_.normal, previous_.normal + 3, best.n);
+    best.d = previous_.distance;
+    best_count = count_inliers (points_, best);
+  }
+
+  /* Tracking: the previous plane still explains the scene. The reference is
+   * the last RANSAC fit, not the previous frame, so it cannot decay. */
+  const bool tracked = previous_.valid
+      && best_count >= std::max (TRACK_KEEP * fit_ratio_, TRACK_MIN_RATIO) * n_points;
+  if (!tracked) {
+    const int n_bands = pool ? std::min<int> ({ static_cast<int> (pool->size ()), MAX_BANDS,
+        MAX_HYPOTHESES / BATCH }) : 1;
+    std::atomic<int> shared_count (best_count);
+    std::atomic<int> tried (0);
+    struct Band { Hypothesis h; int count; } bands[MAX_BANDS];
+    const uint32_t seed = seed_;
+    seed_ = seed_ * 1664525u + 1013904223u;
+
+    auto run = [&] (size_t band) {
+      uint32_t rng = (seed ^ static_cast<uint32_t> (band * 0x9E3779B9u)) | 1u;
+      Band local = { best, best_count };
+      while (Clock::now () < deadline) {
+        const int done = tried.load (std::memory_order_relaxed);
+        if (done >= needed_hypotheses (shared_count.load (std::memory_order_relaxed), n_points))
+          break;
+        for (int i = 0; i < BATCH; ++i) {
+          const float *a = &points_[4 * (xorshift (&rng) % n_points)];
+          const float *b = &points_[4 * (xorshift (&rng) % n_points)];
+          const float *c = &points_[4 * (xorshift (&rng) % n_points)];
+          Hypothesis h;
+          if (!plane_from_points (a, b, c, &h))
+            continue;
+          const int count = count_inliers (points_, h);
+          if (count > local.count) {
+            local = { h, count };
+            int shared = shared_count.load (std::memory_order_relaxed);
+            while (count > shared && !shared_count.compare_exchange_weak (shared, count)) {
+            }
+          }
+        }
+        tried.fetch_add (BATCH, std::memory_order_relaxed);
+      }
+      bands[band] = local;
+    };
+
+    if (n_bands > 1)
+      pool->parallel_for (n_bands, run);
+    else
+      run (0);
+
+    for (int band = 0; band < n_bands; ++band) {
+      if (bands[band].count > best_count) {
+        best = bands[band].h;
+        best_count = bands[band].count;
+      }
+    }
+    result.hypotheses = tried.load ();
+  }
+
+  if (best_count == 0) {
+    previous_.valid = false;
+    return result;
+  }
+
+  best = refine (points_, best);
+  std::copy (best.n, best.n + 3, result.normal);
+  result.distance = best.d;
+  result.inlier_ratio = static_cast<float> (count_inliers (points_, best)) / n_points;
+  result.valid = true;
+  previous_ = result;
+  if (!tracked)
+    fit_ratio_ = result.inlier_ratio;
+  return result;
+}
@@ -0,0 +1,87 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_FLOOR_H__
+#define __RS_FLOOR_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <librealsense2/rs.hpp>
+
+#include "rsworkerpool.h"
+
+/* A plane n.p + d = 0 in camera coordinates (metres, x right, y down,
+ * z forward). n has unit length and points to the camera side, so d is
+ * the height of the camera above the plane. */
+struct RsFloorPlane
+{
+  float normal[3];
+  float distance;
+  float inlier_ratio;   // share of the samples within tolerance of the plane
+  uint32_t samples;     // valid depth samples the fit ran on
+  uint32_t hypotheses;  // RANSAC hypotheses scored, 0 when tracked
+  bool valid;
+};
+
+/* Floor plane estimation with a per-frame time budget.
+ *
+ * configure() deprojects a grid of at most MAX_SAMPLES pixels of the depth
+ * plane to unit rays once. Each frame, the rays are scaled by their depth
+ * and the previous plane is scored first: if it still holds nearly as many
+ * inliers, it is only refined (tracking). Otherwise RANSAC hypotheses from
+ * three samples each are scored across the pool, seeded with the previous
+ * plane, until enough have been tried for the best inlier ratio or the
+ * budget runs out. Only planes whose normal is within MAX_TILT of the
+ * camera's up axis (-y) count as floor. The winner is refit to its inliers
+ * by least squares. */
+class RsFloorEstimator
+{
+public:
+  static constexpr int MAX_SAMPLES = 2048;
+
+  /* Depth planes of these intrinsics and depth units (metres per unit) */
+  void configure(const rs2_intrinsics &intrin, float depth_scale);
+
+  /* Fits the plane to Z16 depth of the configured size (stride in bytes).
+   * Spends about budget_us microseconds at most on hypotheses. */
+  RsFloorPlane estimate(const uint16_t *depth, size_t stride, int64_t budget_us,
+      RsWorkerPool *pool);
+
+  /* Forget the previous plane, e.g. after a restart */
+  void reset() { previous_.valid = false; }
+
+  size_t memory() const
+  {
+    return (rays_.size() + points_.size()) * sizeof(float) + offsets_.size() * sizeof(uint32_t);
+  }
+
+private:
+  float depth_scale_ = 0.001f;
+  int width_ = 0, height_ = 0;
+  std::vector<uint32_t> offsets_;  // pixel of each ray: y * width + x
+  std::vector<float> rays_;        // x, y per grid pixel, z = 1
+  std::vector<float> points_;      // x, y, z, tolerance per valid sample
+  uint32_t seed_ = 1;
+  RsFloorPlane previous_ = {};
+  float fit_ratio_ = 0.0f;         // inlier_ratio of the last RANSAC fit
+};
+
+#endif /* __RS_FLOOR_H__ */
@@ -0,0 +1,214 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rsguided.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+/* Taps reach RADIUS coarse samples either side of the nearest one */
+static constexpr int RADIUS = 2;
+static constexpr int TAPS = 2 * RADIUS + 1;
+static constexpr int MAX_BANDS = 64;
+/* Output pixels accumulated together in the vertical pass */
+static constexpr int CHUNK = 64;
+/* Below this total weight an output pixel is left without depth */
+static constexpr float MIN_WEIGHT = 1e-4f;
+
+bool
+RsGuidedUpsampler::init (int width, int height, int factor, float sigma_space, float sigma_color)
+{
+  if (width <= 0 || height <= 0 || factor < 1 || sigma_space <= 0.0f || sigma_color <= 0.0f)
+    return false;
+
+  width_ = width;
+  height_ = height;
+  factor_ = factor;
+  low_width_ = (width + factor - 1) / factor;
+  low_height_ = (height + factor - 1) / factor;
+
+  /* Output pixel p of a coarse pixel sits at (p + 0.5) / factor - 0.5 in
+   * coarse coordinates; tap k is coarse sample RADIUS - k away from it */
+  space_.resize (static_cast<size_t> (factor) * TAPS);
+  for (int p = 0; p < factor; ++p) {
+    const float centre = (p + 0.5f) / factor - 0.5f;
+    for (int k = 0; k < TAPS; ++k) {
+      const float d = centre - (k - RADIUS);
+      space_[p * TAPS + k] = std::exp (-d * d / (2.0f * sigma_space * sigma_space));
+    }
+  }
+
+  range_.resize (3 * 255 + 1);
+  for (size_t d = 0; d < range_.size (); ++d) {
+    const float mean = d / 3.0f;
+    range_[d] = std::exp (-mean * mean / (2.0f * sigma_color * sigma_color));
+  }
+
+  guide_.resize (static_cast<size_t> (low_width_) * low_height_ * 3);
+  valid_.resize (static_cast<size_t> (low_width_) * low_height_);
+  sum_.resize (static_cast<size_t> (width) * low_height_);
+  weight_.resize (static_cast<size_t> (width) * low_height_);
+  return true;
+}
+
+size_t
+RsGuidedUpsampler::memory () const
+{
+  return guide_.size () + (valid_.size () + sum_.size () + weight_.size ()) * sizeof (float);
+}
+
+/* The output row whose color stands for coarse row j in the vertical pass */
+inline int
+RsGuidedUpsampler::guide_row (int j) const
+{
+  return std::min (j * factor_ + factor_ / 2, height_ - 1);
+}
+
+static inline int
+color_distance (const uint8_t * a, const uint8_t * b)
+{
+  return std::abs (a[0] - b[0]) + std::abs (a[1] - b[1]) + std::abs (a[2] - b[2]);
+}
+
+void
+RsGuidedUpsampler::horizontal_rows (const uint16_t * low, size_t low_stride,
+    const uint8_t * color, size_t color_stride, int j0, int j1)
+{
+  const int f = factor_;
+  for (int j = j0; j < j1; ++j) {
+    const auto *depth = reinterpret_cast<const uint16_t *> (
+        reinterpret_cast<const uint8_t *> (low) + j * low_stride);
+
+    /* Box average of the color block under each coarse pixel of this row */
+    uint8_t *guide = &guide_[static_cast<size_t> (j) * low_width_ * 3];
+    const int by0 = j * f, by1 = std::min (by0 + f, height_);
+    for (int i = 0; i < low_width_; ++i) {
+      const int bx0 = i * f, bx1 = std::min (bx0 + f, width_);
+      unsigned acc[3] = { 0, 0, 0 };
+      for (int y = by0; y < by1; ++y) {
+        const uint8_t *px = color + y * color_stride + bx0 * 3;
+        for (int x = bx0; x < bx1; ++x, px += 3) {
+          acc[0] += px[0];
+          acc[1] += px[1];
+          acc[2] += px[2];
+        }
+      }
+      const unsigned n = (by1 - by0) * (bx1 - bx0);
+      for (int c = 0; c < 3; ++c)
+        guide[i * 3 + c] = static_cast<uint8_t> ((acc[c] + n / 2) / n);
+    }
+
+    /* Samples without depth get zero weight instead of a branch */
+    float *valid = &valid_[static_cast<size_t> (j) * low_width_];
+    for (int i = 0; i < low_width_; ++i)
+      valid[i] = depth[i] ? 1.0f : 0.0f;
+
+    const uint8_t *row = color + guide_row (j) * color_stride;
+    float *sum = &sum_[static_cast<size_t> (j) * width_];
+    float *weight = &weight_[static_cast<size_t> (j) * width_];
+    for (int c = 0; c < low_width_; ++c) {
+      const int first = c - RADIUS;
+      const int k0 = std::max (0, -first);
+      const int k1 = std::min (TAPS, low_width_ - first);
+      for (int p = 0, x = c * f; p < f && x < width_; ++p, ++x) {
+        const float *space = &space_[p * TAPS];
+        float s = 0.0f, w = 0.0f;
+        for (int k = k0; k < k1; ++k) {
+          const int i = first + k;
+          const float wk = space[k] * valid[i] * range_[color_distance (row + x * 3, guide + i * 3)];
+          s += wk * depth[i];
+          w += wk;
+        }
+        sum[x] = s;
+        weight[x] = w;
+      }
+    }
+  }
+}
+
+void
+RsGuidedUpsampler::vertical_rows (const uint8_t * color, size_t color_stride, uint16_t * out,
+    size_t out_stride, int y0, int y1) const
+{
+  const int f = factor_;
+  for (int y = y0; y < y1; ++y) {
+    const uint8_t *row = color + y * color_stride;
+    const float *space = &space_[(y % f) * TAPS];
+    const int first = y / f - RADIUS;
+    const int k0 = std::max (0, -first);
+    const int k1 = std::min (TAPS, low_height_ - first);
+
+    const uint8_t *guides[TAPS];
+    const float *sums[TAPS];
+    const float *weights[TAPS];
+    for (int k = k0; k < k1; ++k) {
+      const int j = first + k;
+      guides[k] = color + guide_row (j) * color_stride;
+      sums[k] = &sum_[static_cast<size_t> (j) * width_];
+      weights[k] = &weight_[static_cast<size_t> (j) * width_];
+    }
+
+    auto *dst = reinterpret_cast<uint16_t *> (reinterpret_cast<uint8_t *> (out) + y * out_stride);
+    for (int x0 = 0; x0 < width_; x0 += CHUNK) {
+      const int n = std::min (CHUNK, width_ - x0);
+      float s[CHUNK] = {}, w[CHUNK] = {};
+      for (int k = k0; k < k1; ++k) {
+        const uint8_t *a = row + x0 * 3, *b = guides[k] + x0 * 3;
+        const float *sk = sums[k] + x0, *wk = weights[k] + x0;
+        for (int x = 0; x < n; ++x) {
+          const float r = space[k] * range_[color_distance (a + x * 3, b + x * 3)];
+          s[x] += r * sk[x];
+          w[x] += r * wk[x];
+        }
+      }
+      for (int x = 0; x < n; ++x)
+        dst[x0 + x] = w[x] > MIN_WEIGHT ? static_cast<uint16_t> (std::min (s[x] / w[x] + 0.5f, 65535.0f)) : 0;
+    }
+  }
+}
+
+void
+RsGuidedUpsampler::upsample (const uint16_t * low, size_t low_stride, const uint8_t * color,
+    size_t color_stride, uint16_t * out, size_t out_stride, RsWorkerPool * pool)
+{
+  const int tiles = pool ? std::min (static_cast<int> (pool->size ()) * 2, MAX_BANDS) : 1;
+
+  const int low_tiles = std::min (tiles, low_height_);
+  auto horizontal = [&] (size_t tile) {
+    horizontal_rows (low, low_stride, color, color_stride,
+        static_cast<int> (tile * low_height_ / low_tiles),
+        static_cast<int> ((tile + 1) * low_height_ / low_tiles));
+  };
+  const int out_tiles = std::min (tiles, height_);
+  auto vertical = [&] (size_t tile) {
+    vertical_rows (color, color_stride, out, out_stride,
+        static_cast<int> (tile * height_ / out_tiles),
+        static_cast<int> ((tile + 1) * height_ / out_tiles));
+  };
+
+  if (low_tiles > 1)
+    pool->parallel_for (low_tiles, horizontal);
+  else
+    horizontal (0);
+  if (out_tiles > 1)
+    pool->parallel_for (out_tiles, vertical);
+  else
+    vertical (0);
+}
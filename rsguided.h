@@ -0,0 +1,75 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_GUIDED_H__
+#define __RS_GUIDED_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "rsworkerpool.h"
+
+/* Joint-bilateral depth upsampling guided by the color image.
+ *
+ * Depth on a coarse grid, the color grid divided by an integer factor (see
+ * RsReprojector), is upsampled to color resolution. Each coarse sample is
+ * weighted by its distance and by how close its color is to the output
+ * pixel's, so depth edges follow color edges instead of the coarse grid.
+ * The 2D kernel is split into a horizontal pass on the coarse rows and a
+ * vertical pass at full resolution, both in row tiles across the worker
+ * pool. Samples without depth get no weight: small holes are filled from
+ * their neighbours, pixels with no sample in reach stay 0. */
+class RsGuidedUpsampler
+{
+public:
+  /* width x height is the color (output) size. sigma_space is in coarse
+   * pixels, sigma_color in 8-bit levels of the mean RGB difference. */
+  bool init(int width, int height, int factor, float sigma_space, float sigma_color);
+
+  int factor() const { return factor_; }
+  int low_width() const { return low_width_; }
+  int low_height() const { return low_height_; }
+  /* Bytes of the intermediate planes */
+  size_t memory() const;
+
+  /* low is low_width() x low_height() depth, color is RGB8 at output size */
+  void upsample(const uint16_t *low, size_t low_stride, const uint8_t *color,
+      size_t color_stride, uint16_t *out, size_t out_stride, RsWorkerPool *pool);
+
+private:
+  void horizontal_rows(const uint16_t *low, size_t low_stride, const uint8_t *color,
+      size_t color_stride, int j0, int j1);
+  void vertical_rows(const uint8_t *color, size_t color_stride, uint16_t *out,
+      size_t out_stride, int y0, int y1) const;
+  int guide_row(int j) const;
+
+  int width_ = 0, height_ = 0;
+  int factor_ = 1;
+  int low_width_ = 0, low_height_ = 0;
+  std::vector<float> space_;   // per output phase within a coarse pixel, per tap
+  std::vector<float> range_;   // by summed absolute RGB difference
+  std::vector<uint8_t> guide_; // box-averaged color of each coarse pixel
+  std::vector<float> valid_;   // 1 where the coarse sample has depth
+  /* Horizontal pass: weighted depth sum and weight at full width, coarse rows */
+  std::vector<float> sum_;
+  std::vector<float> weight_;
+};
+
+#endif /* __RS_GUIDED_H__ */
@@ -0,0 +1,256 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rsholefill.h"
+
+#include <algorithm>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/* ----> Scalar, for the frame edges and row tails */
+
+static inline uint16_t
+sample (const uint16_t * row, int x, int width)
+{
+  return (row && x >= 0 && x < width) ? row[x] : 0;
+}
+
+template <bool Farthest>
+static inline uint16_t
+around_scalar (const uint16_t * above, const uint16_t * row, const uint16_t * below,
+    int x, int width)
+{
+  const uint16_t *rows[3] = { above, row, below };
+  uint16_t best = 0;
+  for (const uint16_t *r : rows) {
+    for (int dx = -1; dx <= 1; ++dx) {
+      const uint16_t v = sample (r, x + dx, width);
+      if (v == 0)
+        continue;
+      if (best == 0 || (Farthest ? v > best : v < best))
+        best = v;
+    }
+  }
+  return best;
+}
+
+template <bool Farthest>
+static void
+fill_around_scalar (const uint16_t * above, const uint16_t * row, const uint16_t * below,
+    int width, int x0, int x1, uint16_t * out)
+{
+  for (int x = x0; x < x1; ++x)
+    out[x] = row[x] ? row[x] : around_scalar<Farthest> (above, row, below, x, width);
+}
+
+/* ----> SIMD, 8 pixels per iteration */
+
+#if defined(__SSE2__)
+
+/* SSE2 only compares signed 16-bit lanes; flipping the sign bit maps
+ * unsigned order onto signed order */
+static inline __m128i
+max_epu16 (__m128i a, __m128i b)
+{
+  const __m128i bias = _mm_set1_epi16 (static_cast<short> (0x8000));
+  return _mm_xor_si128 (_mm_max_epi16 (_mm_xor_si128 (a, bias), _mm_xor_si128 (b, bias)), bias);
+}
+
+static inline __m128i
+min_epu16 (__m128i a, __m128i b)
+{
+  const __m128i bias = _mm_set1_epi16 (static_cast<short> (0x8000));
+  return _mm_xor_si128 (_mm_min_epi16 (_mm_xor_si128 (a, bias), _mm_xor_si128 (b, bias)), bias);
+}
+
+static inline __m128i
+load (const uint16_t * p)
+{
+  return _mm_loadu_si128 (reinterpret_cast<const __m128i *> (p));
+}
+
+/* v with its zero lanes replaced by fill */
+static inline __m128i
+fill_zeros (__m128i v, __m128i fill)
+{
+  const __m128i holes = _mm_cmpeq_epi16 (v, _mm_setzero_si128 ());
+  return _mm_or_si128 (v, _mm_and_si128 (holes, fill));
+}
+
+static void
+fill_left (const uint16_t * row, int width, uint16_t * out)
+{
+  __m128i carry = _mm_setzero_si128 ();
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    __m128i v = load (row + x);
+    /* Log-step scan: after shifts of 1, 2 and 4 lanes each hole holds the
+     * nearest valid sample up to 7 lanes to its left */
+    v = fill_zeros (v, _mm_slli_si128 (v, 2));
+    v = fill_zeros (v, _mm_slli_si128 (v, 4));
+    v = fill_zeros (v, _mm_slli_si128 (v, 8));
+    v = fill_zeros (v, carry);
+    _mm_storeu_si128 (reinterpret_cast<__m128i *> (out + x), v);
+    /* Broadcast lane 7 as the carry into the next block */
+    const __m128i hi = _mm_shufflehi_epi16 (v, 0xFF);
+    carry = _mm_unpackhi_epi64 (hi, hi);
+  }
+  uint16_t last = static_cast<uint16_t> (_mm_cvtsi128_si32 (carry));
+  for (; x < width; ++x) {
+    if (row[x])
+      last = row[x];
+    out[x] = last;
+  }
+}
+
+template <bool Farthest>
+static void
+fill_around (const uint16_t * above, const uint16_t * row, const uint16_t * below,
+    int width, uint16_t * out)
+{
+  const __m128i one = _mm_set1_epi16 (1);
+  const __m128i zero = _mm_setzero_si128 ();
+  const uint16_t *rows[3] = { above, row, below };
+
+  /* Column 0 and the tail read outside the row, so they stay scalar */
+  fill_around_scalar<Farthest> (above, row, below, width, 0, std::min (1, width), out);
+  int x = 1;
+  for (; x + 9 <= width; x += 8) {
+    /* Nearest: v - 1 wraps 0 to 0xFFFF, so the unsigned minimum skips
+     * holes, and adding 1 back leaves 0 if all nine were holes */
+    __m128i best = Farthest ? zero : _mm_set1_epi16 (-1);
+    for (const uint16_t *r : rows) {
+      if (!r)
+        continue;
+      for (int dx = -1; dx <= 1; ++dx) {
+        const __m128i v = load (r + x + dx);
+        best = Farthest ? max_epu16 (best, v) : min_epu16 (best, _mm_sub_epi16 (v, one));
+      }
+    }
+    if (!Farthest)
+      best = _mm_add_epi16 (best, one);
+    _mm_storeu_si128 (reinterpret_cast<__m128i *> (out + x), fill_zeros (load (row + x), best));
+  }
+  fill_around_scalar<Farthest> (above, row, below, width, x, width, out);
+}
+
+#elif defined(__aarch64__)
+
+static void
+fill_left (const uint16_t * row, int width, uint16_t * out)
+{
+  const uint16x8_t zero = vdupq_n_u16 (0);
+  uint16x8_t carry = zero;
+  int x = 0;
+  for (; x + 8 <= width; x += 8) {
+    uint16x8_t v = vld1q_u16 (row + x);
+    v = vbslq_u16 (vceqq_u16 (v, zero), vextq_u16 (zero, v, 7), v);
+    v = vbslq_u16 (vceqq_u16 (v, zero), vextq_u16 (zero, v, 6), v);
+    v = vbslq_u16 (vceqq_u16 (v, zero), vextq_u16 (zero, v, 4), v);
+    v = vbslq_u16 (vceqq_u16 (v, zero), carry, v);
+    vst1q_u16 (out + x, v);
+    carry = vdupq_laneq_u16 (v, 7);
+  }
+  uint16_t last = vgetq_lane_u16 (carry, 0);
+  for (; x < width; ++x) {
+    if (row[x])
+      last = row[x];
+    out[x] = last;
+  }
+}
+
+template <bool Farthest>
+static void
+fill_around (const uint16_t * above, const uint16_t * row, const uint16_t * below,
+    int width, uint16_t * out)
+{
+  const uint16x8_t one = vdupq_n_u16 (1);
+  const uint16x8_t zero = vdupq_n_u16 (0);
+  const uint16_t *rows[3] = { above, row, below };
+
+  fill_around_scalar<Farthest> (above, row, below, width, 0, std::min (1, width), out);
+  int x = 1;
+  for (; x + 9 <= width; x += 8) {
+    uint16x8_t best = Farthest ? zero : vdupq_n_u16 (0xFFFF);
+    for (const uint16_t *r : rows) {
+      if (!r)
+        continue;
+      for (int dx = -1; dx <= 1; ++dx) {
+        const uint16x8_t v = vld1q_u16 (r + x + dx);
+        best = Farthest ? vmaxq_u16 (best, v) : vminq_u16 (best, vsubq_u16 (v, one));
+      }
+    }
+    if (!Farthest)
+      best = vaddq_u16 (best, one);
+    const uint16x8_t c = vld1q_u16 (row + x);
+    vst1q_u16 (out + x, vbslq_u16 (vceqq_u16 (c, zero), best, c));
+  }
+  fill_around_scalar<Farthest> (above, row, below, width, x, width, out);
+}
+
+#else
+
+static void
+fill_left (const uint16_t * row, int width, uint16_t * out)
+{
+  uint16_t last = 0;
+  for (int x = 0; x < width; ++x) {
+    if (row[x])
+      last = row[x];
+    out[x] = last;
+  }
+}
+
+template <bool Farthest>
+static void
+fill_around (const uint16_t * above, const uint16_t * row, const uint16_t * below,
+    int width, uint16_t * out)
+{
+  fill_around_scalar<Farthest> (above, row, below, width, 0, width, out);
+}
+
+#endif
+
+template <RsHoleFill Mode>
+void
+rs_hole_fill_row (const uint16_t * above, const uint16_t * row, const uint16_t * below,
+    int width, uint16_t * out)
+{
+  if (Mode == RsHoleFill::Left)
+    fill_left (row, width, out);
+  else if (Mode == RsHoleFill::Farthest)
+    fill_around<true> (above, row, below, width, out);
+  else if (Mode == RsHoleFill::Nearest)
+    fill_around<false> (above, row, below, width, out);
+  else
+    std::copy (row, row + width, out);
+}
+
+template void rs_hole_fill_row<RsHoleFill::Off> (const uint16_t *, const uint16_t *,
+    const uint16_t *, int, uint16_t *);
+template void rs_hole_fill_row<RsHoleFill::Left> (const uint16_t *, const uint16_t *,
+    const uint16_t *, int, uint16_t *);
+template void rs_hole_fill_row<RsHoleFill::Farthest> (const uint16_t *, const uint16_t *,
+    const uint16_t *, int, uint16_t *);
+template void rs_hole_fill_row<RsHoleFill::Nearest> (const uint16_t *, const uint16_t *,
+    const uint16_t *, int, uint16_t *);
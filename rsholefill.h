@@ -0,0 +1,44 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_HOLE_FILL_H__
+#define __RS_HOLE_FILL_H__
+
+#include <cstdint>
+
+/* Hole filling modes, named after librealsense's hole filling filter */
+enum class RsHoleFill
+{
+  Off,
+  Left,      // row scan: take the nearest valid pixel to the left
+  Farthest,  // take the farthest valid pixel of the 3x3 neighbourhood
+  Nearest    // take the nearest valid pixel of the 3x3 neighbourhood
+};
+
+/* Writes row with its zero (no data) pixels filled to out. above and
+ * below are the neighbouring rows of the unfilled frame, nullptr at the
+ * frame edges; Left ignores them. Neighbourhood modes only look at
+ * unfilled samples, so rows can be filled in any order and in parallel.
+ * Pixels with no valid source stay 0. The mode is a template parameter so
+ * kernels pick it once per configuration; Off copies the row. */
+template <RsHoleFill Mode>
+void rs_hole_fill_row(const uint16_t *above, const uint16_t *row, const uint16_t *below,
+    int width, uint16_t *out);
+
+#endif /* __RS_HOLE_FILL_H__ */
@@ -0,0 +1,235 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rsjpegenc.h"
+
+#include <cstring>
+
+#ifdef HAVE_TURBOJPEG
+#include <turbojpeg.h>
+#endif
+
+/* 4:2:0 chroma subsampling: one MCU covers 16x16 pixels */
+constexpr const int MCU_SIZE = 16;
+
+/* Offsets of the markers we need inside one slice's JPEG stream */
+struct JpegLayout
+{
+  size_t sof = 0;   // start of frame, holds the image height
+  size_t sos = 0;   // start of scan header
+  size_t scan = 0;  // first byte of entropy-coded data
+  size_t end = 0;   // EOI marker
+};
+
+static bool
+parse_layout (const uint8_t * jpg, size_t size, JpegLayout & layout)
+{
+  if (size < 4 || jpg[0] != 0xFF || jpg[1] != 0xD8)
+    return false;
+  if (jpg[size - 2] != 0xFF || jpg[size - 1] != 0xD9)
+    return false;
+
+  bool have_sof = false;
+  size_t pos = 2;
+  while (pos + 4 <= size) {
+    if (jpg[pos] != 0xFF)
+      return false;
+    const uint8_t marker = jpg[pos + 1];
+    const size_t len = (static_cast<size_t> (jpg[pos + 2]) << 8) | jpg[pos + 3];
+
+    if (marker == 0xC0) {
+      layout.sof = pos;
+      have_sof = true;
+    } else if (marker == 0xDA) {
+      layout.sos = pos;
+      layout.scan = pos + 2 + len;
+      layout.end = size - 2;
+      return have_sof && layout.scan <= layout.end;
+    }
+    pos += 2 + len;
+  }
+  return false;
+}
+
+RsJpegEncoder::~RsJpegEncoder ()
+{
+  release ();
+}
+
+bool
+RsJpegEncoder::available ()
+{
+#ifdef HAVE_TURBOJPEG
+  return true;
+#else
+  return false;
+#endif
+}
+
+void
+RsJpegEncoder::release ()
+{
+#ifdef HAVE_TURBOJPEG
+  for (auto &slice : slices_) {
+    if (slice.handle)
+      tjDestroy (slice.handle);
+    tjFree (slice.buf);
+  }
+#endif
+  slices_.clear ();
+  max_size_ = 0;
+}
+
+bool
+RsJpegEncoder::init (int width, int height, int quality, unsigned slices)
+{
+  release ();
+
+#ifdef HAVE_TURBOJPEG
+  width_ = width;
+  height_ = height;
+  quality_ = quality;
+
+  /* Every slice but the last is a whole number of MCU rows */
+  const int mcu_rows = (height + MCU_SIZE - 1) / MCU_SIZE;
+  const int mcus_per_row = (width + MCU_SIZE - 1) / MCU_SIZE;
+  if (slices == 0)
+    slices = 1;
+  if (slices > static_cast<unsigned> (mcu_rows))
+    slices = mcu_rows;
+  slice_rows_ = ((mcu_rows + slices - 1) / slices) * MCU_SIZE;
+
+  /* The restart interval (one slice) is a 16-bit MCU count */
+  while (static_cast<long> (slice_rows_ / MCU_SIZE) * mcus_per_row > 0xFFFF)
+    slice_rows_ -= MCU_SIZE;
+
+  max_size_ = 64;
+  for (int y0 = 0; y0 < height; y0 += slice_rows_) {
+    Slice slice;
+    slice.y0 = y0;
+    slice.rows = (y0 + slice_rows_ <= height) ? slice_rows_ : height - y0;
+    slice.capacity = tjBufSize (width, slice.rows, TJSAMP_420);
+    slice.buf = tjAlloc (static_cast<int> (slice.capacity));
+    slice.handle = tjInitCompress ();
+    slices_.push_back (slice);
+    if (!slice.buf || !slice.handle) {
+      error_ = "failed to allocate libjpeg-turbo compressor";
+      release ();
+      return false;
+    }
+    max_size_ += slice.capacity + 2;
+  }
+  return true;
+#else
+  (void) width;
+  (void) height;
+  (void) quality;
+  (void) slices;
+  error_ = "built without libjpeg-turbo";
+  return false;
+#endif
+}
+
+bool
+RsJpegEncoder::compress_slice (Slice & slice, const uint8_t * rgb, int stride)
+{
+#ifdef HAVE_TURBOJPEG
+  slice.size = slice.capacity;
+  slice.ok = tjCompress2 (slice.handle, rgb + static_cast<size_t> (slice.y0) * stride,
+      width_, stride, slice.rows, TJPF_RGB, &slice.buf, &slice.size,
+      TJSAMP_420, quality_, TJFLAG_NOREALLOC | TJFLAG_FASTDCT) == 0;
+  return slice.ok;
+#else
+  (void) rgb;
+  (void) stride;
+  slice.ok = false;
+  return false;
+#endif
+}
+
+size_t
+RsJpegEncoder::encode (const uint8_t * rgb, int stride, uint8_t * out,
+    size_t out_size, RsWorkerPool * pool)
+{
+  if (slices_.empty () || out_size < max_size_)
+    return 0;
+
+  if (pool != nullptr)
+    pool->parallel_for (slices_.size (),
+        [&] (size_t i) { compress_slice (slices_[i], rgb, stride); });
+  else
+    for (auto &slice : slices_)
+      compress_slice (slice, rgb, stride);
+
+  for (const auto &slice : slices_) {
+    if (!slice.ok) {
+#ifdef HAVE_TURBOJPEG
+      error_ = tjGetErrorStr2 (slice.handle);
+#endif
+      return 0;
+    }
+  }
+
+  /* A single slice is already a complete image */
+  if (slices_.size () == 1) {
+    memcpy (out, slices_[0].buf, slices_[0].size);
+    return slices_[0].size;
+  }
+
+  JpegLayout head;
+  if (!parse_layout (slices_[0].buf, slices_[0].size, head)) {
+    error_ = "unexpected JPEG stream layout";
+    return 0;
+  }
+
+  /* Headers of the first slice, patched to the full image height */
+  uint8_t *p = out;
+  memcpy (p, slices_[0].buf, head.sos);
+  p[head.sof + 5] = static_cast<uint8_t> (height_ >> 8);
+  p[head.sof + 6] = static_cast<uint8_t> (height_ & 0xFF);
+  p += head.sos;
+
+  /* Define restart interval: one slice worth of MCUs */
+  const int interval = ((width_ + MCU_SIZE - 1) / MCU_SIZE) * (slice_rows_ / MCU_SIZE);
+  const uint8_t dri[] = { 0xFF, 0xDD, 0x00, 0x04,
+      static_cast<uint8_t> (interval >> 8), static_cast<uint8_t> (interval & 0xFF) };
+  memcpy (p, dri, sizeof (dri));
+  p += sizeof (dri);
+
+  memcpy (p, slices_[0].buf + head.sos, head.scan - head.sos);
+  p += head.scan - head.sos;
+
+  for (size_t i = 0; i < slices_.size (); ++i) {
+    JpegLayout layout;
+    if (!parse_layout (slices_[i].buf, slices_[i].size, layout)) {
+      error_ = "unexpected JPEG stream layout";
+      return 0;
+    }
+    if (i > 0) {
+      *p++ = 0xFF;
+      *p++ = static_cast<uint8_t> (0xD0 + ((i - 1) & 7));
+    }
+    memcpy (p, slices_[i].buf + layout.scan, layout.end - layout.scan);
+    p += layout.end - layout.scan;
+  }
+  *p++ = 0xFF;
+  *p++ = 0xD9;
+
+  return static_cast<size_t> (p - out);
+}
@@ -0,0 +1,87 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_JPEG_ENC_H__
+#define __RS_JPEG_ENC_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "rsworkerpool.h"
+
+/* Baseline 4:2:0 JPEG encoder for RGB8 frames built on libjpeg-turbo.
+ *
+ * The frame is cut into horizontal slices of whole MCU rows, each slice is
+ * compressed independently on the worker pool, and the entropy-coded
+ * segments are stitched into one image separated by restart markers. All
+ * slices share the standard Huffman tables and the same quantisation
+ * tables, so the result is a single conformant JPEG with a restart
+ * interval of one slice.
+ *
+ * Without libjpeg-turbo (HAVE_TURBOJPEG unset) init() always fails.
+ */
+class RsJpegEncoder
+{
+public:
+  RsJpegEncoder() = default;
+  ~RsJpegEncoder();
+
+  RsJpegEncoder(const RsJpegEncoder &) = delete;
+  RsJpegEncoder &operator=(const RsJpegEncoder &) = delete;
+
+  static bool available();
+
+  bool init(int width, int height, int quality, unsigned slices);
+
+  /* Upper bound of encode() output, for sizing output buffers. */
+  size_t max_size() const { return max_size_; }
+
+  /* Returns the JPEG size written to out, or 0 on failure. */
+  size_t encode(const uint8_t *rgb, int stride, uint8_t *out, size_t out_size,
+      RsWorkerPool *pool);
+
+  const std::string &last_error() const { return error_; }
+
+private:
+  struct Slice
+  {
+    void *handle = nullptr;
+    unsigned char *buf = nullptr;
+    unsigned long capacity = 0;
+    unsigned long size = 0;
+    int y0 = 0;
+    int rows = 0;
+    bool ok = false;
+  };
+
+  void release();
+  bool compress_slice(Slice &slice, const uint8_t *rgb, int stride);
+
+  int width_ = 0;
+  int height_ = 0;
+  int quality_ = 85;
+  int slice_rows_ = 0;
+  size_t max_size_ = 0;
+  std::vector<Slice> slices_;
+  std::string error_;
+};
+
+#endif /* __RS_JPEG_ENC_H__ */
@@ -0,0 +1,87 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rsmemory.h"
+
+/* Defaults without a budget, and the ceilings when growing within one */
+static constexpr int FRAME_QUEUE_DEFAULT = -1;
+static constexpr int FRAME_QUEUE_MIN = 1;
+static constexpr int FRAME_QUEUE_MAX = 16;
+static constexpr unsigned POOL_MIN = 2;
+static constexpr unsigned POOL_MAX = 8;
+static constexpr size_t RECORDER_MIN = 1;
+static constexpr size_t RECORDER_MAX = 8;
+
+void
+RsMemoryAccount::add (RsMemoryKind kind, int64_t delta)
+{
+  bytes_[kind].fetch_add (delta, std::memory_order_relaxed);
+  const int64_t total = total_.fetch_add (delta, std::memory_order_relaxed) + delta;
+  int64_t peak = peak_.load (std::memory_order_relaxed);
+  while (total > peak && !peak_.compare_exchange_weak (peak, total, std::memory_order_relaxed))
+    ;
+}
+
+const char *
+RsMemoryAccount::kind_name (RsMemoryKind kind)
+{
+  static const char *names[RsMemKindCount] = {
+    "frame-queue", "align", "arena", "pools", "downstream", "recorder",
+  };
+  return names[kind];
+}
+
+RsMemoryPlan
+rs_memory_plan (uint64_t budget, uint64_t fixed, uint64_t frameset_bytes,
+    uint64_t pool_bytes, uint64_t record_bytes)
+{
+  if (budget == 0)
+    return { FRAME_QUEUE_DEFAULT, 0, RECORDER_MAX, 0, true };
+
+  RsMemoryPlan plan = { FRAME_QUEUE_MIN, POOL_MIN, RECORDER_MIN, 0, true };
+  /* The recorder keeps one spare vector besides its queue */
+  uint64_t used = fixed + FRAME_QUEUE_MIN * frameset_bytes + POOL_MIN * pool_bytes
+      + (RECORDER_MIN + 1) * record_bytes;
+  if (used > budget) {
+    plan.bytes = used;
+    plan.fits = false;
+    return plan;
+  }
+
+  for (bool grown = true; grown;) {
+    grown = false;
+    if (plan.pool_buffers < POOL_MAX && used + pool_bytes <= budget) {
+      ++plan.pool_buffers;
+      used += pool_bytes;
+      grown = true;
+    }
+    if (plan.frame_queue < FRAME_QUEUE_MAX && used + frameset_bytes <= budget) {
+      ++plan.frame_queue;
+      used += frameset_bytes;
+      grown = true;
+    }
+    if (record_bytes && plan.recorder_queue < RECORDER_MAX && used + record_bytes <= budget) {
+      ++plan.recorder_queue;
+      used += record_bytes;
+      grown = true;
+    }
+  }
+  plan.bytes = used;
+  return plan;
+}
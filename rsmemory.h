@@ -0,0 +1,76 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_MEMORY_H__
+#define __RS_MEMORY_H__
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+enum RsMemoryKind
+{
+  RsMemFrameQueue,  // framesets queued inside librealsense (estimated)
+  RsMemAlign,       // align block output frames (estimated)
+  RsMemArena,       // per-frame scratch arena
+  RsMemPools,       // buffers allocated by the output and pyramid pools
+  RsMemDownstream,  // zero-copy frames and depth planes held downstream
+  RsMemRecorder,    // depth recorder queue
+  RsMemKindCount
+};
+
+/* Bytes held by one element, by kind. Updated from the streaming thread,
+ * pool threads and whichever thread drops the last buffer ref, so all
+ * counters are relaxed atomics; peak() is the high-water of total(). */
+class RsMemoryAccount
+{
+public:
+  void set(RsMemoryKind kind, int64_t bytes) { add(kind, bytes - bytes_[kind].load(std::memory_order_relaxed)); }
+  void add(RsMemoryKind kind, int64_t delta);
+
+  int64_t get(RsMemoryKind kind) const { return bytes_[kind].load(std::memory_order_relaxed); }
+  int64_t total() const { return total_.load(std::memory_order_relaxed); }
+  int64_t peak() const { return peak_.load(std::memory_order_relaxed); }
+
+  static const char *kind_name(RsMemoryKind kind);
+
+private:
+  std::atomic<int64_t> bytes_[RsMemKindCount] = {};
+  std::atomic<int64_t> total_{0};
+  std::atomic<int64_t> peak_{0};
+};
+
+/* Queue and pool depths picked to fit a memory budget */
+struct RsMemoryPlan
+{
+  int frame_queue;        // librealsense frames queue size, -1 = leave default
+  unsigned pool_buffers;  // max buffers per pool, 0 = unlimited
+  size_t recorder_queue;  // depth recorder queue length
+  uint64_t bytes;         // planned usage, or the minimum if it does not fit
+  bool fits;              // false if even the minimum exceeds the budget
+};
+
+/* Splits budget - fixed bytes between the librealsense queue (frameset
+ * bytes per slot), the output pools (pool_bytes per buffer) and the
+ * recorder queue (record_bytes per entry, 0 without recording), growing
+ * each one slot at a time from its minimum. budget 0 means unlimited. */
+RsMemoryPlan rs_memory_plan(uint64_t budget, uint64_t fixed, uint64_t frameset_bytes,
+    uint64_t pool_bytes, uint64_t record_bytes);
+
+#endif /* __RS_MEMORY_H__ */
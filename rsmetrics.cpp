@@ -0,0 +1,359 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rsmetrics.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* ----> Histogram */
+
+const uint64_t RsLatencyHistogram::bounds_us[N_BUCKETS - 1] = {
+  500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 250000
+};
+
+void
+RsLatencyHistogram::observe (uint64_t us)
+{
+  const int bucket = static_cast<int> (
+      std::lower_bound (bounds_us, bounds_us + N_BUCKETS - 1, us) - bounds_us);
+  buckets_[bucket].fetch_add (1, std::memory_order_relaxed);
+  sum_us_.fetch_add (us, std::memory_order_relaxed);
+  count_.fetch_add (1, std::memory_order_relaxed);
+}
+
+static void
+append_sample (std::string & out, const std::string & name, const std::string & labels,
+    const char *value)
+{
+  out += name;
+  if (!labels.empty ()) {
+    out += '{';
+    out += labels;
+    out += '}';
+  }
+  out += ' ';
+  out += value;
+  out += '\n';
+}
+
+void
+RsLatencyHistogram::render (std::string & out, const std::string & name,
+    const std::string & labels) const
+{
+  char value[64];
+  uint64_t cumulative = 0;
+  for (int i = 0; i < N_BUCKETS; ++i) {
+    cumulative += buckets_[i].load (std::memory_order_relaxed);
+    char le[32];
+    if (i < N_BUCKETS - 1)
+      snprintf (le, sizeof (le), "%g", bounds_us[i] / 1e6);
+    else
+      snprintf (le, sizeof (le), "+Inf");
+    snprintf (value, sizeof (value), "%llu", static_cast<unsigned long long> (cumulative));
+    append_sample (out, name + "_bucket", labels + ",le=\"" + le + "\"", value);
+  }
+  snprintf (value, sizeof (value), "%g", sum_us_.load (std::memory_order_relaxed) / 1e6);
+  append_sample (out, name + "_sum", labels, value);
+  snprintf (value, sizeof (value), "%llu",
+      static_cast<unsigned long long> (count_.load (std::memory_order_relaxed)));
+  append_sample (out, name + "_count", labels, value);
+}
+
+/* ----> Registry */
+
+RsMetricsRegistry &
+RsMetricsRegistry::get ()
+{
+  static RsMetricsRegistry registry;
+  return registry;
+}
+
+std::shared_ptr<RsInstanceMetrics>
+RsMetricsRegistry::add (const std::string & name)
+{
+  auto metrics = std::make_shared<RsInstanceMetrics> (name);
+  std::lock_guard<std::mutex> guard (lock_);
+  instances_.push_back (metrics);
+  return metrics;
+}
+
+void
+RsMetricsRegistry::remove (const std::shared_ptr<RsInstanceMetrics> & metrics)
+{
+  std::lock_guard<std::mutex> guard (lock_);
+  instances_.erase (std::remove (instances_.begin (), instances_.end (), metrics),
+      instances_.end ());
+}
+
+/* Label values may contain anything an element name can */
+static std::string
+escape_label (const std::string & value)
+{
+  std::string out;
+  for (char c : value) {
+    if (c == '\\' || c == '"')
+      out += '\\';
+    if (c == '\n') {
+      out += "\\n";
+      continue;
+    }
+    out += c;
+  }
+  return out;
+}
+
+std::string
+RsMetricsRegistry::render ()
+{
+  static const struct {
+    const char *name;
+    const char *help;
+    std::atomic<uint64_t> RsInstanceMetrics::*counter;
+  } counters[] = {
+    { "realsensesrc_frames_total", "Frames pushed downstream", &RsInstanceMetrics::frames },
+    { "realsensesrc_output_bytes_total", "Bytes pushed downstream", &RsInstanceMetrics::bytes },
+    { "realsensesrc_inflight_drops_total", "Framesets dropped at max-inflight",
+      &RsInstanceMetrics::inflight_drops },
+    { "realsensesrc_device_starts_total", "Times the device pipeline was (re)started",
+      &RsInstanceMetrics::starts },
+    { "realsensesrc_errors_total", "RealSense errors while streaming", &RsInstanceMetrics::errors },
+  };
+  static const char *stage_names[RsStageCount] = { "wait", "align", "output", "create" };
+
+  std::vector<std::shared_ptr<RsInstanceMetrics>> instances;
+  {
+    std::lock_guard<std::mutex> guard (lock_);
+    instances = instances_;
+  }
+
+  std::string out;
+  char value[32];
+  for (const auto &counter : counters) {
+    out += std::string ("# HELP ") + counter.name + " " + counter.help + "\n";
+    out += std::string ("# TYPE ") + counter.name + " counter\n";
+    for (const auto &instance : instances) {
+      snprintf (value, sizeof (value), "%llu", static_cast<unsigned long long> (
+          ((*instance).*(counter.counter)).load (std::memory_order_relaxed)));
+      append_sample (out, counter.name, "instance=\"" + escape_label (instance->name) + "\"", value);
+    }
+  }
+
+  const std::string histogram = "realsensesrc_stage_latency_seconds";
+  out += "# HELP " + histogram + " Time spent per frame in each stage\n";
+  out += "# TYPE " + histogram + " histogram\n";
+  for (const auto &instance : instances)
+    for (int stage = 0; stage < RsStageCount; ++stage)
+      instance->stages[stage].render (out, histogram, "instance=\""
+          + escape_label (instance->name) + "\",stage=\"" + stage_names[stage] + "\"");
+  return out;
+}
+
+/* ----> Exporter */
+
+/* Whether something accepts connections on the unix socket at addr */
+static bool
+socket_in_use (const struct sockaddr_un & addr)
+{
+  const int fd = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    return false;
+  const bool in_use = connect (fd, reinterpret_cast<const sockaddr *> (&addr), sizeof (addr)) == 0;
+  close (fd);
+  return in_use;
+}
+
+RsMetricsExporter::~RsMetricsExporter ()
+{
+  stop ();
+}
+
+bool
+RsMetricsExporter::start (const std::string & endpoint)
+{
+  stop ();
+
+  if (endpoint.compare (0, 5, "unix:") == 0) {
+    unix_path_ = endpoint.substr (5);
+    struct sockaddr_un addr = {};
+    if (unix_path_.empty () || unix_path_.size () >= sizeof (addr.sun_path)) {
+      error_ = "invalid unix socket path";
+      return false;
+    }
+    addr.sun_family = AF_UNIX;
+    memcpy (addr.sun_path, unix_path_.c_str (), unix_path_.size () + 1);
+
+    /* A stale socket from a previous run would make bind fail. Anything
+     * else at the path, or a socket someone still listens on, is left. */
+    struct stat st;
+    if (lstat (unix_path_.c_str (), &st) == 0) {
+      if (!S_ISSOCK (st.st_mode)) {
+        error_ = unix_path_ + " exists and is not a socket";
+        unix_path_.clear ();
+        return false;
+      }
+      if (socket_in_use (addr)) {
+        error_ = unix_path_ + " is in use by another process";
+        unix_path_.clear ();
+        return false;
+      }
+      unlink (unix_path_.c_str ());
+    }
+
+    listen_fd_ = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0 || bind (listen_fd_, reinterpret_cast<sockaddr *> (&addr), sizeof (addr)) < 0) {
+      error_ = std::string ("bind ") + unix_path_ + ": " + strerror (errno);
+      unix_path_.clear ();
+      stop ();
+      return false;
+    }
+    if (lstat (unix_path_.c_str (), &st) == 0)
+      unix_ino_ = st.st_ino;
+  } else {
+    std::string port = endpoint;
+    if (port.compare (0, 10, "localhost:") == 0)
+      port = port.substr (10);
+    char *end = nullptr;
+    const long number = strtol (port.c_str (), &end, 10);
+    if (port.empty () || *end != '\0' || number <= 0 || number > 65535) {
+      error_ = "invalid endpoint '" + endpoint + "'";
+      return false;
+    }
+
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons (static_cast<uint16_t> (number));
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+
+    listen_fd_ = socket (AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    const int one = 1;
+    if (listen_fd_ >= 0)
+      setsockopt (listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof (one));
+    if (listen_fd_ < 0 || bind (listen_fd_, reinterpret_cast<sockaddr *> (&addr), sizeof (addr)) < 0) {
+      error_ = "bind 127.0.0.1:" + port + ": " + strerror (errno);
+      stop ();
+      return false;
+    }
+  }
+
+  if (listen (listen_fd_, 8) < 0 || pipe2 (wake_fd_, O_CLOEXEC) < 0) {
+    error_ = std::string ("listen: ") + strerror (errno);
+    stop ();
+    return false;
+  }
+
+  thread_ = std::thread (&RsMetricsExporter::run, this);
+  return true;
+}
+
+void
+RsMetricsExporter::stop ()
+{
+  if (thread_.joinable ()) {
+    const char byte = 0;
+    if (write (wake_fd_[1], &byte, 1) < 0)
+      error_ = std::string ("wake: ") + strerror (errno);
+    thread_.join ();
+  }
+  for (int *fd : { &listen_fd_, &wake_fd_[0], &wake_fd_[1] }) {
+    if (*fd >= 0)
+      close (*fd);
+    *fd = -1;
+  }
+  /* Only remove our own socket, not whatever replaced it since */
+  struct stat st;
+  if (!unix_path_.empty () && lstat (unix_path_.c_str (), &st) == 0 && S_ISSOCK (st.st_mode)
+      && st.st_ino == unix_ino_)
+    unlink (unix_path_.c_str ());
+  unix_path_.clear ();
+  unix_ino_ = 0;
+}
+
+void
+RsMetricsExporter::run ()
+{
+  for (;;) {
+    struct pollfd fds[2] = { { listen_fd_, POLLIN, 0 }, { wake_fd_[0], POLLIN, 0 } };
+    if (poll (fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    if (fds[1].revents)
+      return;
+    if (fds[0].revents & POLLIN) {
+      const int fd = accept4 (listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd >= 0) {
+        serve (fd);
+        close (fd);
+      }
+    }
+  }
+}
+
+/* One request per connection; a slow client can stall scrapes, never streaming */
+void
+RsMetricsExporter::serve (int fd)
+{
+  const struct timeval timeout = { 1, 0 };
+  setsockopt (fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof (timeout));
+  setsockopt (fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof (timeout));
+
+  char request[2048];
+  size_t length = 0;
+  while (length < sizeof (request) - 1) {
+    const ssize_t n = recv (fd, request + length, sizeof (request) - 1 - length, 0);
+    if (n <= 0)
+      break;
+    length += n;
+    request[length] = '\0';
+    if (strstr (request, "\r\n\r\n") || strstr (request, "\n\n"))
+      break;
+  }
+  request[length] = '\0';
+
+  std::string response;
+  if (strncmp (request, "GET /metrics", 12) == 0 || strncmp (request, "GET / ", 6) == 0) {
+    const std::string body = RsMetricsRegistry::get ().render ();
+    response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: " + std::to_string (body.size ()) + "\r\nConnection: close\r\n\r\n" + body;
+  } else {
+    response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+  }
+
+  size_t sent = 0;
+  while (sent < response.size ()) {
+    const ssize_t n = send (fd, response.data () + sent, response.size () - sent, MSG_NOSIGNAL);
+    if (n <= 0)
+      break;
+    sent += n;
+  }
+}
@@ -0,0 +1,124 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_METRICS_H__
+#define __RS_METRICS_H__
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Fixed-bucket latency histogram. observe() is lock-free and only does
+ * relaxed atomic adds, so it is safe on the streaming thread. */
+class RsLatencyHistogram
+{
+public:
+  static constexpr int N_BUCKETS = 10;
+  /* Upper bounds in microseconds; the last bucket is +Inf */
+  static const uint64_t bounds_us[N_BUCKETS - 1];
+
+  void observe(uint64_t us);
+  void render(std::string &out, const std::string &name, const std::string &labels) const;
+
+private:
+  std::atomic<uint64_t> buckets_[N_BUCKETS] = {};
+  std::atomic<uint64_t> sum_us_{0};
+  std::atomic<uint64_t> count_{0};
+};
+
+enum RsMetricsStage
+{
+  RsStageWait,    // waiting for a frameset from librealsense
+  RsStageAlign,   // align processing block
+  RsStageOutput,  // building the output buffer (copy, encode)
+  RsStageCreate,  // whole create() call
+  RsStageCount
+};
+
+/* Counters of one element instance. Written by the streaming thread,
+ * read by the exporter; all fields are relaxed atomics. */
+struct RsInstanceMetrics
+{
+  explicit RsInstanceMetrics(std::string instance) : name(std::move(instance)) {}
+
+  const std::string name;
+  std::atomic<uint64_t> frames{0};
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> inflight_drops{0};
+  std::atomic<uint64_t> starts{0};
+  std::atomic<uint64_t> errors{0};
+  RsLatencyHistogram stages[RsStageCount];
+
+  static void add(std::atomic<uint64_t> &counter, uint64_t n = 1)
+  {
+    counter.fetch_add(n, std::memory_order_relaxed);
+  }
+};
+
+/* Process-wide list of instances. The mutex is only taken to add or
+ * remove an instance and by the exporter while rendering, never per frame. */
+class RsMetricsRegistry
+{
+public:
+  static RsMetricsRegistry &get();
+
+  std::shared_ptr<RsInstanceMetrics> add(const std::string &name);
+  void remove(const std::shared_ptr<RsInstanceMetrics> &metrics);
+
+  /* Prometheus text exposition format, version 0.0.4 */
+  std::string render();
+
+private:
+  std::mutex lock_;
+  std::vector<std::shared_ptr<RsInstanceMetrics>> instances_;
+};
+
+/* Serves the registry over HTTP on its own thread.
+ * Endpoint: "unix:/path/to.sock", "localhost:PORT" or just "PORT";
+ * TCP endpoints only ever bind to 127.0.0.1. */
+class RsMetricsExporter
+{
+public:
+  RsMetricsExporter() = default;
+  ~RsMetricsExporter();
+
+  RsMetricsExporter(const RsMetricsExporter &) = delete;
+  RsMetricsExporter &operator=(const RsMetricsExporter &) = delete;
+
+  bool start(const std::string &endpoint);
+  void stop();
+  const std::string &last_error() const { return error_; }
+
+private:
+  void run();
+  void serve(int fd);
+
+  std::thread thread_;
+  int listen_fd_ = -1;
+  int wake_fd_[2] = {-1, -1};
+  std::string unix_path_;
+  uint64_t unix_ino_ = 0;  // inode of the socket bound at unix_path_
+  std::string error_;
+};
+
+#endif /* __RS_METRICS_H__ */
@@ -0,0 +1,601 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Header-only encode/decode of the depth half of realsensesrc mux output,
+ * and the copy of the color half. The element encodes with these same
+ * functions, so consumers decoding with them always agree with the source.
+ * Include <gst/video/video.h> before this header to also get RSMux::demux
+ * for GstSamples. */
+
+#ifndef __RS_MUX_H__
+#define __RS_MUX_H__
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define RS_MUX_HAVE_SSSE3 1
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RS_MUX_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace RSMux {
+
+enum class DepthEncoding
+{
+  Decimal,     // R = B = depth % 10, G = depth / 10; depth > 2559 units encodes as 0
+  DecimalMask  // R, G as Decimal, B = validity code (MASK_*)
+};
+
+/* Largest depth the Decimal encodings represent, in device units: 2.559 m
+ * at the default 1 mm, see depth_scale() */
+constexpr uint16_t DECIMAL_MAX_DEPTH = 2559;
+
+/* Validity codes in the B channel of DecimalMask. Codes are spaced so
+ * consumers can threshold them: mask >= MASK_FILLED means usable depth. */
+constexpr uint8_t MASK_NO_DATA = 0;        // sensor reported no depth (or none mapped after align)
+constexpr uint8_t MASK_OUT_OF_RANGE = 64;  // measured, but beyond DECIMAL_MAX_DEPTH
+constexpr uint8_t MASK_FILLED = 128;       // synthesized by in-element filtering
+constexpr uint8_t MASK_VALID = 255;        // measured and encoded exactly
+
+inline uint8_t
+mask_code (uint16_t depth)
+{
+  return depth == 0 ? MASK_NO_DATA : depth <= DECIMAL_MAX_DEPTH ? MASK_VALID : MASK_OUT_OF_RANGE;
+}
+
+/* Planes from this size on are copied with non-temporal stores: they
+ * would only evict what the encoders work on, as the element does not read
+ * its output again. Below, the copy is likely still cache resident for a
+ * downstream reader. */
+constexpr size_t STREAM_MIN_BYTES = 1 << 20;
+
+enum class Store
+{
+  Auto,       // Streaming from STREAM_MIN_BYTES on, where the CPU has it
+  Cached,     // plain memcpy
+  Streaming   // non-temporal stores, Cached where the CPU has none
+};
+
+enum class Kernel
+{
+  Auto,    // best kernel the running CPU supports
+  Scalar,
+  SSSE3,
+  NEON
+};
+
+namespace detail {
+
+/* ----> Scalar */
+
+template <bool Mask>
+inline void
+encode_decimal_scalar (const uint16_t * depth, uint8_t * rgb, size_t n)
+{
+  for (size_t i = 0; i < n; ++i) {
+    const uint16_t d = depth[i] <= DECIMAL_MAX_DEPTH ? depth[i] : 0;
+    rgb[3 * i] = static_cast<uint8_t> (d % 10);
+    rgb[3 * i + 1] = static_cast<uint8_t> (d / 10);
+    rgb[3 * i + 2] = Mask ? mask_code (depth[i]) : rgb[3 * i];
+  }
+}
+
+inline void
+decode_decimal_scalar (const uint8_t * rgb, uint16_t * depth, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    depth[i] = static_cast<uint16_t> (rgb[3 * i + 1] * 10 + rgb[3 * i]);
+}
+
+inline void
+decode_mask_scalar (const uint8_t * rgb, uint8_t * mask, size_t n)
+{
+  for (size_t i = 0; i < n; ++i)
+    mask[i] = rgb[3 * i + 2];
+}
+
+/* ----> SSSE3: 16 pixels (48 RGB bytes) per iteration */
+
+#ifdef RS_MUX_HAVE_SSSE3
+#define RS_MUX_SSSE3 __attribute__ ((target ("ssse3")))
+
+/* Shuffle masks placing pixel bytes into RGB triplets: for output vector j,
+ * byte k takes pixel p = (16j + k) / 3 of the channel the mask is for.
+ * encode_rb_mask fills channels 0 and 2 from the same vector. */
+alignas (16) static const int8_t encode_rb_mask[3][16] = {
+  { 0, -1, 0, 1, -1, 1, 2, -1, 2, 3, -1, 3, 4, -1, 4, 5 },
+  { -1, 5, 6, -1, 6, 7, -1, 7, 8, -1, 8, 9, -1, 9, 10, -1 },
+  { 10, 11, -1, 11, 12, -1, 12, 13, -1, 13, 14, -1, 14, 15, -1, 15 },
+};
+alignas (16) static const int8_t encode_g_mask[3][16] = {
+  { -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1 },
+  { 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10 },
+  { -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1 },
+};
+alignas (16) static const int8_t encode_r_mask[3][16] = {
+  { 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5 },
+  { -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1 },
+  { -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1 },
+};
+alignas (16) static const int8_t encode_b_mask[3][16] = {
+  { -1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1 },
+  { -1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1 },
+  { 10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15 },
+};
+/* Inverse: gathers byte `channel` of each pixel from input vector j */
+alignas (16) static const int8_t decode_r_mask[3][16] = {
+  { 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+  { -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1 },
+  { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13 },
+};
+alignas (16) static const int8_t decode_g_mask[3][16] = {
+  { 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+  { -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1 },
+  { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14 },
+};
+alignas (16) static const int8_t decode_b_mask[3][16] = {
+  { 2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 },
+  { -1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1 },
+  { -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15 },
+};
+
+RS_MUX_SSSE3 inline __m128i
+load_mask (const int8_t * mask)
+{
+  return _mm_load_si128 (reinterpret_cast<const __m128i *> (mask));
+}
+
+/* MASK_VALID where 0 < d <= max, MASK_OUT_OF_RANGE where d > max, else 0 */
+RS_MUX_SSSE3 inline __m128i
+mask_codes_ssse3 (__m128i d, __m128i in_range)
+{
+  const __m128i zero = _mm_setzero_si128 ();
+  const __m128i valid = _mm_andnot_si128 (_mm_cmpeq_epi16 (d, zero), in_range);
+  return _mm_or_si128 (_mm_and_si128 (valid, _mm_set1_epi16 (MASK_VALID)),
+      _mm_andnot_si128 (in_range, _mm_set1_epi16 (MASK_OUT_OF_RANGE)));
+}
+
+template <bool Mask>
+RS_MUX_SSSE3 inline void
+encode_decimal_ssse3 (const uint16_t * depth, uint8_t * rgb, size_t n)
+{
+  const __m128i max = _mm_set1_epi16 (DECIMAL_MAX_DEPTH);
+  const __m128i magic = _mm_set1_epi16 (static_cast<short> (52429));  // ceil(2^19 / 10)
+  const __m128i ten = _mm_set1_epi16 (10);
+  const __m128i zero = _mm_setzero_si128 ();
+
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m128i d0 = _mm_loadu_si128 (reinterpret_cast<const __m128i *> (depth + i));
+    __m128i d1 = _mm_loadu_si128 (reinterpret_cast<const __m128i *> (depth + i + 8));
+    /* d <= max  <=>  saturating d - max == 0 */
+    const __m128i in0 = _mm_cmpeq_epi16 (_mm_subs_epu16 (d0, max), zero);
+    const __m128i in1 = _mm_cmpeq_epi16 (_mm_subs_epu16 (d1, max), zero);
+    __m128i b = zero;
+    if (Mask)
+      b = _mm_packus_epi16 (mask_codes_ssse3 (d0, in0), mask_codes_ssse3 (d1, in1));
+    /* Out of range depth encodes as 0 */
+    d0 = _mm_and_si128 (d0, in0);
+    d1 = _mm_and_si128 (d1, in1);
+    /* d / 10 == (d * 52429) >> 19 for every 16-bit d */
+    const __m128i q0 = _mm_srli_epi16 (_mm_mulhi_epu16 (d0, magic), 3);
+    const __m128i q1 = _mm_srli_epi16 (_mm_mulhi_epu16 (d1, magic), 3);
+    const __m128i r0 = _mm_sub_epi16 (d0, _mm_mullo_epi16 (q0, ten));
+    const __m128i r1 = _mm_sub_epi16 (d1, _mm_mullo_epi16 (q1, ten));
+    const __m128i g = _mm_packus_epi16 (q0, q1);
+    const __m128i r = _mm_packus_epi16 (r0, r1);
+
+    auto *out = reinterpret_cast<__m128i *> (rgb + 3 * i);
+    for (int j = 0; j < 3; ++j) {
+      const __m128i gv = _mm_shuffle_epi8 (g, load_mask (encode_g_mask[j]));
+      if (Mask)
+        _mm_storeu_si128 (out + j, _mm_or_si128 (_mm_or_si128 (gv,
+            _mm_shuffle_epi8 (r, load_mask (encode_r_mask[j]))),
+            _mm_shuffle_epi8 (b, load_mask (encode_b_mask[j]))));
+      else
+        _mm_storeu_si128 (out + j, _mm_or_si128 (gv,
+            _mm_shuffle_epi8 (r, load_mask (encode_rb_mask[j]))));
+    }
+  }
+  encode_decimal_scalar<Mask> (depth + i, rgb + 3 * i, n - i);
+}
+
+RS_MUX_SSSE3 inline void
+decode_decimal_ssse3 (const uint8_t * rgb, uint16_t * depth, size_t n)
+{
+  const __m128i ten = _mm_set1_epi16 (10);
+  const __m128i zero = _mm_setzero_si128 ();
+
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const auto *in = reinterpret_cast<const __m128i *> (rgb + 3 * i);
+    __m128i r = zero, g = zero;
+    for (int j = 0; j < 3; ++j) {
+      const __m128i v = _mm_loadu_si128 (in + j);
+      r = _mm_or_si128 (r, _mm_shuffle_epi8 (v, load_mask (decode_r_mask[j])));
+      g = _mm_or_si128 (g, _mm_shuffle_epi8 (v, load_mask (decode_g_mask[j])));
+    }
+    const __m128i d0 = _mm_add_epi16 (_mm_mullo_epi16 (_mm_unpacklo_epi8 (g, zero), ten),
+        _mm_unpacklo_epi8 (r, zero));
+    const __m128i d1 = _mm_add_epi16 (_mm_mullo_epi16 (_mm_unpackhi_epi8 (g, zero), ten),
+        _mm_unpackhi_epi8 (r, zero));
+    _mm_storeu_si128 (reinterpret_cast<__m128i *> (depth + i), d0);
+    _mm_storeu_si128 (reinterpret_cast<__m128i *> (depth + i + 8), d1);
+  }
+  decode_decimal_scalar (rgb + 3 * i, depth + i, n - i);
+}
+
+RS_MUX_SSSE3 inline void
+decode_mask_ssse3 (const uint8_t * rgb, uint8_t * mask, size_t n)
+{
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const auto *in = reinterpret_cast<const __m128i *> (rgb + 3 * i);
+    __m128i b = _mm_setzero_si128 ();
+    for (int j = 0; j < 3; ++j)
+      b = _mm_or_si128 (b, _mm_shuffle_epi8 (_mm_loadu_si128 (in + j),
+          load_mask (decode_b_mask[j])));
+    _mm_storeu_si128 (reinterpret_cast<__m128i *> (mask + i), b);
+  }
+  decode_mask_scalar (rgb + 3 * i, mask + i, n - i);
+}
+
+inline bool
+cpu_has_ssse3 ()
+{
+  static const bool has = __builtin_cpu_supports ("ssse3");
+  return has;
+}
+
+/* ----> SSE2 streaming copy: whole cache lines bypass the cache */
+
+#define RS_MUX_SSE2 __attribute__ ((target ("sse2")))
+
+RS_MUX_SSE2 inline void
+stream_row_sse2 (const uint8_t * src, uint8_t * dst, size_t n)
+{
+  /* Up to the first 16-byte aligned destination address through the cache */
+  const size_t head = std::min<size_t> ((16 - (reinterpret_cast<uintptr_t> (dst) & 15)) & 15, n);
+  memcpy (dst, src, head);
+
+  size_t i = head;
+  for (; i + 64 <= n; i += 64) {
+    const auto *in = reinterpret_cast<const __m128i *> (src + i);
+    auto *out = reinterpret_cast<__m128i *> (dst + i);
+    const __m128i v0 = _mm_loadu_si128 (in), v1 = _mm_loadu_si128 (in + 1);
+    const __m128i v2 = _mm_loadu_si128 (in + 2), v3 = _mm_loadu_si128 (in + 3);
+    _mm_stream_si128 (out, v0);
+    _mm_stream_si128 (out + 1, v1);
+    _mm_stream_si128 (out + 2, v2);
+    _mm_stream_si128 (out + 3, v3);
+  }
+  for (; i + 16 <= n; i += 16)
+    _mm_stream_si128 (reinterpret_cast<__m128i *> (dst + i),
+        _mm_loadu_si128 (reinterpret_cast<const __m128i *> (src + i)));
+  memcpy (dst + i, src + i, n - i);
+}
+
+/* Orders the streaming stores before the buffer is handed to another thread */
+RS_MUX_SSE2 inline void
+stream_fence_sse2 ()
+{
+  _mm_sfence ();
+}
+
+inline bool
+cpu_has_sse2 ()
+{
+  static const bool has = __builtin_cpu_supports ("sse2");
+  return has;
+}
+#endif
+
+/* ----> NEON: 16 pixels per iteration, vst3/vld3 do the interleaving */
+
+#ifdef RS_MUX_HAVE_NEON
+inline uint8x8_t
+mask_codes_neon (uint16x8_t d, uint16x8_t in_range)
+{
+  const uint16x8_t valid = vandq_u16 (in_range, vtstq_u16 (d, d));
+  return vmovn_u16 (vorrq_u16 (vandq_u16 (valid, vdupq_n_u16 (MASK_VALID)),
+      vbicq_u16 (vdupq_n_u16 (MASK_OUT_OF_RANGE), in_range)));
+}
+
+template <bool Mask>
+inline void
+encode_decimal_neon (const uint16_t * depth, uint8_t * rgb, size_t n)
+{
+  const uint16x8_t max = vdupq_n_u16 (DECIMAL_MAX_DEPTH);
+  const uint16x8_t ten = vdupq_n_u16 (10);
+
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    uint16x8_t d0 = vld1q_u16 (depth + i);
+    uint16x8_t d1 = vld1q_u16 (depth + i + 8);
+    const uint16x8_t in0 = vcleq_u16 (d0, max);
+    const uint16x8_t in1 = vcleq_u16 (d1, max);
+    uint8x16_t b = vdupq_n_u8 (0);
+    if (Mask)
+      b = vcombine_u8 (mask_codes_neon (d0, in0), mask_codes_neon (d1, in1));
+    d0 = vandq_u16 (d0, in0);
+    d1 = vandq_u16 (d1, in1);
+    /* d / 10 == (d * 52429) >> 19 for every 16-bit d */
+    const uint16x8_t q0 = vcombine_u16 (
+        vshrn_n_u32 (vmull_n_u16 (vget_low_u16 (d0), 52429), 16),
+        vshrn_n_u32 (vmull_n_u16 (vget_high_u16 (d0), 52429), 16));
+    const uint16x8_t q1 = vcombine_u16 (
+        vshrn_n_u32 (vmull_n_u16 (vget_low_u16 (d1), 52429), 16),
+        vshrn_n_u32 (vmull_n_u16 (vget_high_u16 (d1), 52429), 16));
+    const uint16x8_t g0 = vshrq_n_u16 (q0, 3), g1 = vshrq_n_u16 (q1, 3);
+    uint8x16x3_t out;
+    out.val[1] = vcombine_u8 (vmovn_u16 (g0), vmovn_u16 (g1));
+    out.val[0] = vcombine_u8 (vmovn_u16 (vmlsq_u16 (d0, g0, ten)),
+        vmovn_u16 (vmlsq_u16 (d1, g1, ten)));
+    out.val[2] = Mask ? b : out.val[0];
+    vst3q_u8 (rgb + 3 * i, out);
+  }
+  encode_decimal_scalar<Mask> (depth + i, rgb + 3 * i, n - i);
+}
+
+inline void
+decode_decimal_neon (const uint8_t * rgb, uint16_t * depth, size_t n)
+{
+  const uint8x8_t ten = vdup_n_u8 (10);
+
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const uint8x16x3_t in = vld3q_u8 (rgb + 3 * i);
+    const uint16x8_t d0 = vmlal_u8 (vmovl_u8 (vget_low_u8 (in.val[0])),
+        vget_low_u8 (in.val[1]), ten);
+    const uint16x8_t d1 = vmlal_u8 (vmovl_u8 (vget_high_u8 (in.val[0])),
+        vget_high_u8 (in.val[1]), ten);
+    vst1q_u16 (depth + i, d0);
+    vst1q_u16 (depth + i + 8, d1);
+  }
+  decode_decimal_scalar (rgb + 3 * i, depth + i, n - i);
+}
+
+inline void
+decode_mask_neon (const uint8_t * rgb, uint8_t * mask, size_t n)
+{
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    vst1q_u8 (mask + i, vld3q_u8 (rgb + 3 * i).val[2]);
+  decode_mask_scalar (rgb + 3 * i, mask + i, n - i);
+}
+#endif
+
+}  // namespace detail
+
+/* Whether kernel can run on this CPU. Scalar and Auto always can. */
+inline bool
+kernel_supported (Kernel kernel)
+{
+  switch (kernel) {
+    case Kernel::Auto:
+    case Kernel::Scalar:
+      return true;
+    case Kernel::SSSE3:
+#ifdef RS_MUX_HAVE_SSSE3
+      return detail::cpu_has_ssse3 ();
+#else
+      return false;
+#endif
+    case Kernel::NEON:
+#ifdef RS_MUX_HAVE_NEON
+      return true;
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+/* Kernel Auto resolves to on this CPU */
+inline Kernel
+best_kernel ()
+{
+  if (kernel_supported (Kernel::NEON))
+    return Kernel::NEON;
+  if (kernel_supported (Kernel::SSSE3))
+    return Kernel::SSSE3;
+  return Kernel::Scalar;
+}
+
+/* Encodes n Z16 depth pixels into n RGB triplets. An unsupported kernel
+ * falls back to Scalar. */
+inline void
+encode_depth (const uint16_t * depth, uint8_t * rgb, size_t n,
+    DepthEncoding encoding = DepthEncoding::Decimal, Kernel kernel = Kernel::Auto)
+{
+  const bool mask = encoding == DepthEncoding::DecimalMask;
+  if (kernel == Kernel::Auto || !kernel_supported (kernel))
+    kernel = best_kernel ();
+#ifdef RS_MUX_HAVE_NEON
+  if (kernel == Kernel::NEON)
+    return mask ? detail::encode_decimal_neon<true> (depth, rgb, n)
+        : detail::encode_decimal_neon<false> (depth, rgb, n);
+#endif
+#ifdef RS_MUX_HAVE_SSSE3
+  if (kernel == Kernel::SSSE3)
+    return mask ? detail::encode_decimal_ssse3<true> (depth, rgb, n)
+        : detail::encode_decimal_ssse3<false> (depth, rgb, n);
+#endif
+  mask ? detail::encode_decimal_scalar<true> (depth, rgb, n)
+      : detail::encode_decimal_scalar<false> (depth, rgb, n);
+}
+
+/* Decodes n RGB triplets back to Z16 depth. Exact for data produced by
+ * encode_depth; pixels that were out of range decode as 0. */
+inline void
+decode_depth (const uint8_t * rgb, uint16_t * depth, size_t n,
+    DepthEncoding encoding = DepthEncoding::Decimal, Kernel kernel = Kernel::Auto)
+{
+  (void) encoding;
+  if (kernel == Kernel::Auto || !kernel_supported (kernel))
+    kernel = best_kernel ();
+#ifdef RS_MUX_HAVE_NEON
+  if (kernel == Kernel::NEON)
+    return detail::decode_decimal_neon (rgb, depth, n);
+#endif
+#ifdef RS_MUX_HAVE_SSSE3
+  if (kernel == Kernel::SSSE3)
+    return detail::decode_decimal_ssse3 (rgb, depth, n);
+#endif
+  detail::decode_decimal_scalar (rgb, depth, n);
+}
+
+/* Extracts the n validity codes of DecimalMask data */
+inline void
+decode_mask (const uint8_t * rgb, uint8_t * mask, size_t n, Kernel kernel = Kernel::Auto)
+{
+  if (kernel == Kernel::Auto || !kernel_supported (kernel))
+    kernel = best_kernel ();
+#ifdef RS_MUX_HAVE_NEON
+  if (kernel == Kernel::NEON)
+    return detail::decode_mask_neon (rgb, mask, n);
+#endif
+#ifdef RS_MUX_HAVE_SSSE3
+  if (kernel == Kernel::SSSE3)
+    return detail::decode_mask_ssse3 (rgb, mask, n);
+#endif
+  detail::decode_mask_scalar (rgb, mask, n);
+}
+
+/* Whether Store::Streaming copies with non-temporal stores on this CPU */
+inline bool
+streaming_supported ()
+{
+#ifdef RS_MUX_HAVE_SSSE3
+  return detail::cpu_has_sse2 ();
+#else
+  return false;
+#endif
+}
+
+/* Row-wise copy of a plane (strides in bytes), as the element copies the
+ * color half of mux output */
+inline void
+copy_plane (const uint8_t * src, size_t src_stride, uint8_t * dst, size_t dst_stride,
+    size_t row_bytes, int height, Store store = Store::Auto)
+{
+  if (store == Store::Auto)
+    store = row_bytes * height >= STREAM_MIN_BYTES ? Store::Streaming : Store::Cached;
+#ifdef RS_MUX_HAVE_SSSE3
+  if (store == Store::Streaming && detail::cpu_has_sse2 ()) {
+    for (int y = 0; y < height; ++y)
+      detail::stream_row_sse2 (src + y * src_stride, dst + y * dst_stride, row_bytes);
+    detail::stream_fence_sse2 ();
+    return;
+  }
+#endif
+  if (src_stride == row_bytes && dst_stride == row_bytes) {
+    memcpy (dst, src, row_bytes * height);
+    return;
+  }
+  for (int y = 0; y < height; ++y)
+    memcpy (dst + y * dst_stride, src + y * src_stride, row_bytes);
+}
+
+/* Row-wise decode of a strided plane (strides in bytes) */
+inline void
+decode_depth_plane (const uint8_t * rgb, size_t rgb_stride, uint16_t * depth,
+    size_t depth_stride, int width, int height,
+    DepthEncoding encoding = DepthEncoding::Decimal, Kernel kernel = Kernel::Auto)
+{
+  for (int y = 0; y < height; ++y)
+    decode_depth (rgb + y * rgb_stride,
+        reinterpret_cast<uint16_t *> (reinterpret_cast<uint8_t *> (depth) + y * depth_stride),
+        width, encoding, kernel);
+}
+
+#ifdef __GST_VIDEO_H__
+/* Metres per unit of the depth in realsensesrc mux or sparse output with
+ * these caps. Caps without depth-scale predate depth-units and are in mm. */
+inline double
+depth_scale (const GstCaps * caps)
+{
+  double scale = 0.0;
+  if (!caps || gst_caps_get_size (caps) == 0
+      || !gst_structure_get_double (gst_caps_get_structure (caps, 0), "depth-scale", &scale)
+      || scale <= 0.0)
+    return 0.001;
+  return scale;
+}
+
+/* Splits an appsink sample of realsensesrc mux output into tightly packed
+ * RGB color and Z16 depth, plus the validity codes when mask is given
+ * (only meaningful with depth-mask enabled on the element). Returns false
+ * if the sample is not mux output. */
+inline bool
+demux (GstSample * sample, std::vector<uint8_t> & color, std::vector<uint16_t> & depth,
+    int *width, int *height, std::vector<uint8_t> * mask = nullptr,
+    Kernel kernel = Kernel::Auto)
+{
+  GstVideoInfo vinfo;
+  GstBuffer *buffer = gst_sample_get_buffer (sample);
+  GstCaps *caps = gst_sample_get_caps (sample);
+  if (!buffer || !caps || !gst_video_info_from_caps (&vinfo, caps)
+      || GST_VIDEO_INFO_FORMAT (&vinfo) != GST_VIDEO_FORMAT_RGB)
+    return false;
+
+  const int w = GST_VIDEO_INFO_WIDTH (&vinfo);
+  const int h = GST_VIDEO_INFO_HEIGHT (&vinfo) / 2;
+  const size_t row = static_cast<size_t> (w) * 3;
+
+  GstMapInfo map;
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READ))
+    return false;
+  /* Zero-copy buffers carry tightly packed planes in two memories */
+  const size_t stride = gst_buffer_n_memory (buffer) > 1 ? row
+      : static_cast<size_t> (GST_VIDEO_INFO_PLANE_STRIDE (&vinfo, 0));
+  if (map.size < stride * (2 * h - 1) + row) {
+    gst_buffer_unmap (buffer, &map);
+    return false;
+  }
+
+  color.resize (row * h);
+  depth.resize (static_cast<size_t> (w) * h);
+  for (int y = 0; y < h; ++y)
+    std::copy (map.data + y * stride, map.data + y * stride + row, color.data () + y * row);
+  decode_depth_plane (map.data + h * stride, stride, depth.data (), w * sizeof (uint16_t),
+      w, h, DepthEncoding::Decimal, kernel);
+  if (mask) {
+    mask->resize (static_cast<size_t> (w) * h);
+    for (int y = 0; y < h; ++y)
+      decode_mask (map.data + (h + y) * stride, mask->data () + static_cast<size_t> (y) * w, w, kernel);
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  *width = w;
+  *height = h;
+  return true;
+}
+#endif
+
+}  // namespace RSMux
+
+#endif /* __RS_MUX_H__ */
@@ -0,0 +1,194 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rsmuxkernels.h"
+
+#include <algorithm>
+
+static constexpr int MAX_BANDS = 64;
+
+void
+RsDepthResample::init (int src_width, int src_height, int dst_width, int dst_height)
+{
+  /* Pixel centres: src = (dst + 0.5) * src_size / dst_size, in integers */
+  x_index.resize (dst_width);
+  for (int x = 0; x < dst_width; ++x)
+    x_index[x] = static_cast<int> ((2 * static_cast<int64_t> (x) + 1) * src_width / (2 * dst_width));
+  y_index.resize (dst_height);
+  for (int y = 0; y < dst_height; ++y)
+    y_index[y] = static_cast<int> ((2 * static_cast<int64_t> (y) + 1) * src_height / (2 * dst_height));
+}
+
+/* Pixels that were holes before filling and now encode as valid depth */
+static void
+mark_filled (const uint16_t * original, const int *x_index, uint8_t * rgb, int width)
+{
+  for (int x = 0; x < width; ++x) {
+    const uint16_t d = original[x_index ? x_index[x] : x];
+    if (d == 0 && rgb[3 * x + 2] == RSMux::MASK_VALID)
+      rgb[3 * x + 2] = RSMux::MASK_FILLED;
+  }
+}
+
+/* One row of encode_depth with the CPU kernel fixed at compile time */
+template <RSMux::Kernel Cpu, bool Mask>
+struct EncodeRow
+{
+  static void run (const uint16_t * depth, uint8_t * rgb, size_t n)
+  {
+    RSMux::detail::encode_decimal_scalar<Mask> (depth, rgb, n);
+  }
+};
+
+#ifdef RS_MUX_HAVE_SSSE3
+template <bool Mask>
+struct EncodeRow<RSMux::Kernel::SSSE3, Mask>
+{
+  static void run (const uint16_t * depth, uint8_t * rgb, size_t n)
+  {
+    RSMux::detail::encode_decimal_ssse3<Mask> (depth, rgb, n);
+  }
+};
+#endif
+
+#ifdef RS_MUX_HAVE_NEON
+template <bool Mask>
+struct EncodeRow<RSMux::Kernel::NEON, Mask>
+{
+  static void run (const uint16_t * depth, uint8_t * rgb, size_t n)
+  {
+    RSMux::detail::encode_decimal_neon<Mask> (depth, rgb, n);
+  }
+};
+#endif
+
+template <RSMux::DepthEncoding Encoding, bool Resample, RsHoleFill Fill, RSMux::Kernel Cpu>
+static void
+mux_depth_kernel (const RsMuxDepthArgs & args)
+{
+  constexpr bool mask = Encoding == RSMux::DepthEncoding::DecimalMask;
+  const auto *depth = reinterpret_cast<const uint8_t *> (args.depth);
+  auto source_row = [&] (int y) {
+    return reinterpret_cast<const uint16_t *> (depth + y * args.depth_stride);
+  };
+  const int *x_index = Resample ? args.resample->x_index.data () : nullptr;
+  const int fill_width = Resample ? args.depth_width : args.width;
+
+  auto run = [&] (size_t band) {
+    const int y0 = static_cast<int> (band * args.height / args.n_bands);
+    const int y1 = static_cast<int> ((band + 1) * args.height / args.n_bands);
+    uint16_t *fill_row = Fill != RsHoleFill::Off ? args.fill_rows + band * fill_width : nullptr;
+    uint16_t *scratch_row = Resample ? args.scratch_rows + band * args.width : nullptr;
+
+    for (int y = y0; y < y1; ++y) {
+      const int sy = Resample ? args.resample->y_index[y] : y;
+      const uint16_t *original = source_row (sy);
+      const uint16_t *src = original;
+      if (Fill != RsHoleFill::Off) {
+        rs_hole_fill_row<Fill> (sy > 0 ? source_row (sy - 1) : nullptr, original,
+            sy + 1 < args.depth_height ? source_row (sy + 1) : nullptr, fill_width, fill_row);
+        src = fill_row;
+      }
+
+      const uint16_t *row = src;
+      if (Resample) {
+        for (int x = 0; x < args.width; ++x)
+          scratch_row[x] = src[x_index[x]];
+        row = scratch_row;
+      }
+
+      uint8_t *out = args.out + y * args.out_stride;
+      EncodeRow<Cpu, mask>::run (row, out, args.width);
+      if (mask && Fill != RsHoleFill::Off)
+        mark_filled (original, x_index, out, args.width);
+    }
+  };
+
+  if (args.n_bands > 1)
+    args.pool->parallel_for (args.n_bands, run);
+  else
+    run (0);
+}
+
+template <RSMux::DepthEncoding Encoding, bool Resample, RsHoleFill Fill>
+static RsMuxDepthKernel
+select_cpu (RSMux::Kernel cpu)
+{
+  switch (cpu) {
+#ifdef RS_MUX_HAVE_SSSE3
+    case RSMux::Kernel::SSSE3:
+      return mux_depth_kernel<Encoding, Resample, Fill, RSMux::Kernel::SSSE3>;
+#endif
+#ifdef RS_MUX_HAVE_NEON
+    case RSMux::Kernel::NEON:
+      return mux_depth_kernel<Encoding, Resample, Fill, RSMux::Kernel::NEON>;
+#endif
+    default:
+      return mux_depth_kernel<Encoding, Resample, Fill, RSMux::Kernel::Scalar>;
+  }
+}
+
+template <RSMux::DepthEncoding Encoding, bool Resample>
+static RsMuxDepthKernel
+select_fill (RsHoleFill hole_fill, RSMux::Kernel cpu)
+{
+  switch (hole_fill) {
+    case RsHoleFill::Off:
+      return select_cpu<Encoding, Resample, RsHoleFill::Off> (cpu);
+    case RsHoleFill::Left:
+      return select_cpu<Encoding, Resample, RsHoleFill::Left> (cpu);
+    case RsHoleFill::Farthest:
+      return select_cpu<Encoding, Resample, RsHoleFill::Farthest> (cpu);
+    case RsHoleFill::Nearest:
+      return select_cpu<Encoding, Resample, RsHoleFill::Nearest> (cpu);
+  }
+  return nullptr;
+}
+
+RsMuxDepthKernel
+rs_mux_depth_kernel (RSMux::DepthEncoding encoding, bool resample, RsHoleFill hole_fill,
+    RSMux::Kernel cpu)
+{
+  if (cpu == RSMux::Kernel::Auto || !RSMux::kernel_supported (cpu))
+    cpu = RSMux::best_kernel ();
+
+  switch (encoding) {
+    case RSMux::DepthEncoding::Decimal:
+      return resample ? select_fill<RSMux::DepthEncoding::Decimal, true> (hole_fill, cpu)
+          : select_fill<RSMux::DepthEncoding::Decimal, false> (hole_fill, cpu);
+    case RSMux::DepthEncoding::DecimalMask:
+      return resample ? select_fill<RSMux::DepthEncoding::DecimalMask, true> (hole_fill, cpu)
+          : select_fill<RSMux::DepthEncoding::DecimalMask, false> (hole_fill, cpu);
+  }
+  return nullptr;
+}
+
+int
+rs_mux_depth_bands (RsWorkerPool * pool, int height)
+{
+  return pool ? std::min<int> ({ static_cast<int> (pool->size ()) * 2, MAX_BANDS,
+      std::max (height, 1) }) : 1;
+}
+
+void
+rs_mux_copy_color (const uint8_t * color, size_t color_stride, uint8_t * out,
+    size_t out_stride, size_t row_bytes, int height)
+{
+  RSMux::copy_plane (color, color_stride, out, out_stride, row_bytes, height);
+}
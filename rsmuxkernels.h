@@ -0,0 +1,77 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_MUX_KERNELS_H__
+#define __RS_MUX_KERNELS_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "rsholefill.h"
+#include "rsmux.h"
+#include "rsworkerpool.h"
+
+/* Nearest-neighbour source indices mapping a depth frame onto the output
+ * grid, used when depth is not aligned and its size differs from color. */
+struct RsDepthResample
+{
+  std::vector<int> x_index;  // source column per output column
+  std::vector<int> y_index;  // source row per output row
+
+  void init(int src_width, int src_height, int dst_width, int dst_height);
+};
+
+/* One frame's worth of arguments for a depth plane kernel */
+struct RsMuxDepthArgs
+{
+  const uint16_t *depth;
+  size_t depth_stride;              // bytes
+  uint8_t *out;
+  size_t out_stride;                // bytes
+  int width;                        // output size
+  int height;
+  const RsDepthResample *resample;  // required by resampling kernels
+  uint16_t *scratch_rows;           // n_bands rows of width, required by resampling kernels
+  int depth_width;                  // input size
+  int depth_height;
+  uint16_t *fill_rows;              // n_bands rows of depth_width, required by hole filling kernels
+  int n_bands;                      // from rs_mux_depth_bands()
+  RsWorkerPool *pool;               // runs the bands, or nullptr
+};
+
+typedef void (*RsMuxDepthKernel)(const RsMuxDepthArgs &args);
+
+/* Kernels are instantiated per (encoding, resample, hole filling, CPU
+ * kernel) combination, so neither their rows nor their pixels branch on
+ * the configuration; pick one when it changes. Filled rows feed the
+ * encoder directly. An Auto or unsupported cpu resolves to
+ * RSMux::best_kernel(). Returns nullptr for unsupported combinations. */
+RsMuxDepthKernel rs_mux_depth_kernel(RSMux::DepthEncoding encoding, bool resample,
+    RsHoleFill hole_fill, RSMux::Kernel cpu = RSMux::Kernel::Auto);
+
+/* Number of row bands a depth kernel splits height rows into on pool */
+int rs_mux_depth_bands(RsWorkerPool *pool, int height);
+
+/* Row-wise copy of a packed color plane into a strided output plane, with
+ * non-temporal stores from RSMux::STREAM_MIN_BYTES on */
+void rs_mux_copy_color(const uint8_t *color, size_t color_stride, uint8_t *out,
+    size_t out_stride, size_t row_bytes, int height);
+
+#endif /* __RS_MUX_KERNELS_H__ */
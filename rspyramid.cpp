@@ -0,0 +1,169 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rspyramid.h"
+
+#include <algorithm>
+
+int
+rs_pyramid_layout (int color_width, int color_height, int depth_width,
+    int depth_height, int n_levels, RsPyramidLevel * levels, size_t * size)
+{
+  n_levels = std::min (n_levels, RS_PYRAMID_MAX_LEVELS);
+
+  int count = 0;
+  int cw = color_width / 2, ch = color_height / 2;
+  int dw = depth_width / 2, dh = depth_height / 2;
+  for (; count < n_levels && cw > 0 && ch > 0 && dw > 0 && dh > 0; ++count) {
+    levels[count].color = { cw, ch, cw * 3, 0 };
+    levels[count].depth = { dw, dh, dw * 2, 0 };
+    cw /= 2;
+    ch /= 2;
+    dw /= 2;
+    dh /= 2;
+  }
+
+  size_t offset = 0;
+  for (int i = 0; i < count; ++i) {
+    levels[i].color.offset = offset;
+    offset += static_cast<size_t> (levels[i].color.stride) * levels[i].color.height;
+  }
+  for (int i = 0; i < count; ++i) {
+    levels[i].depth.offset = offset;
+    offset += static_cast<size_t> (levels[i].depth.stride) * levels[i].depth.height;
+  }
+  *size = offset;
+  return count;
+}
+
+/* 2x2 box filter, rounded */
+static void
+reduce_rgb_row (const uint8_t * r0, const uint8_t * r1, uint8_t * dst, int width)
+{
+  for (int x = 0; x < width; ++x) {
+    for (int c = 0; c < 3; ++c) {
+      const int sum = r0[6 * x + c] + r0[6 * x + 3 + c] + r1[6 * x + c] + r1[6 * x + 3 + c];
+      dst[3 * x + c] = static_cast<uint8_t> ((sum + 2) >> 2);
+    }
+  }
+}
+
+/* Nearest valid sample. Subtracting 1 maps invalid (0) to 0xFFFF so a
+ * plain unsigned min skips it, and an all-invalid block wraps back to 0. */
+static void
+reduce_depth_min_row (const uint16_t * r0, const uint16_t * r1, uint16_t * dst, int width)
+{
+  for (int x = 0; x < width; ++x) {
+    const uint16_t a = static_cast<uint16_t> (r0[2 * x] - 1);
+    const uint16_t b = static_cast<uint16_t> (r0[2 * x + 1] - 1);
+    const uint16_t c = static_cast<uint16_t> (r1[2 * x] - 1);
+    const uint16_t d = static_cast<uint16_t> (r1[2 * x + 1] - 1);
+    dst[x] = static_cast<uint16_t> (std::min (std::min (a, b), std::min (c, d)) + 1);
+  }
+}
+
+/* Lower median of the valid samples, so the result is always a measured value */
+static void
+reduce_depth_median_row (const uint16_t * r0, const uint16_t * r1, uint16_t * dst, int width)
+{
+  for (int x = 0; x < width; ++x) {
+    uint16_t v[4];
+    int n = 0;
+    const uint16_t s[4] = { r0[2 * x], r0[2 * x + 1], r1[2 * x], r1[2 * x + 1] };
+    for (uint16_t sample : s) {
+      if (sample == 0)
+        continue;
+      /* Insertion into the sorted valid samples */
+      int i = n++;
+      for (; i > 0 && v[i - 1] > sample; --i)
+        v[i] = v[i - 1];
+      v[i] = sample;
+    }
+    dst[x] = n ? v[(n - 1) / 2] : 0;
+  }
+}
+
+/* Reduces the rows of one block through all levels of one plane */
+template <typename Reduce>
+static void
+build_block (const uint8_t * base, int base_stride, uint8_t * out,
+    const RsPyramidLevel * levels, int n_levels, RsPyramidPlane RsPyramidLevel::*plane,
+    int block, Reduce reduce)
+{
+  for (int l = 0; l < n_levels; ++l) {
+    const RsPyramidPlane &dst = levels[l].*plane;
+    const int rows_per_block = 1 << (n_levels - 1 - l);
+    const int y0 = block * rows_per_block;
+    const int y1 = std::min (y0 + rows_per_block, dst.height);
+    if (y0 >= y1)
+      return;
+
+    const uint8_t *src = (l == 0) ? base : out + (levels[l - 1].*plane).offset;
+    const int src_stride = (l == 0) ? base_stride : (levels[l - 1].*plane).stride;
+    for (int y = y0; y < y1; ++y) {
+      const uint8_t *r0 = src + static_cast<size_t> (2 * y) * src_stride;
+      reduce (r0, r0 + src_stride, out + dst.offset + static_cast<size_t> (y) * dst.stride,
+          dst.width);
+    }
+  }
+}
+
+void
+rs_pyramid_build (const uint8_t * rgb, int rgb_stride, const uint16_t * depth,
+    int depth_stride, const RsPyramidLevel * levels, int n_levels,
+    RsPyramidDepthFilter depth_filter, uint8_t * out, RsWorkerPool * pool)
+{
+  if (n_levels <= 0)
+    return;
+
+  const int block_rows = 1 << (n_levels - 1);
+  const int color_blocks = (levels[0].color.height + block_rows - 1) / block_rows;
+  const int depth_blocks = (levels[0].depth.height + block_rows - 1) / block_rows;
+  const int n_blocks = std::max (color_blocks, depth_blocks);
+
+  auto rgb_reduce = [] (const uint8_t * r0, const uint8_t * r1, uint8_t * dst, int width) {
+    reduce_rgb_row (r0, r1, dst, width);
+  };
+  auto depth_reduce = [depth_filter] (const uint8_t * r0, const uint8_t * r1, uint8_t * dst, int width) {
+    auto *d = reinterpret_cast<uint16_t *> (dst);
+    if (depth_filter == RsPyramidDepthMedian)
+      reduce_depth_median_row (reinterpret_cast<const uint16_t *> (r0),
+          reinterpret_cast<const uint16_t *> (r1), d, width);
+    else
+      reduce_depth_min_row (reinterpret_cast<const uint16_t *> (r0),
+          reinterpret_cast<const uint16_t *> (r1), d, width);
+  };
+
+  /* A few blocks per task keeps scheduling overhead low */
+  const size_t n_tasks = pool ? std::min<size_t> (n_blocks, pool->size () * 4) : 1;
+  auto run = [&] (size_t task) {
+    const int b0 = static_cast<int> (task * n_blocks / n_tasks);
+    const int b1 = static_cast<int> ((task + 1) * n_blocks / n_tasks);
+    for (int b = b0; b < b1; ++b) {
+      build_block (rgb, rgb_stride, out, levels, n_levels, &RsPyramidLevel::color, b, rgb_reduce);
+      build_block (reinterpret_cast<const uint8_t *> (depth), depth_stride, out, levels,
+          n_levels, &RsPyramidLevel::depth, b, depth_reduce);
+    }
+  };
+
+  if (pool != nullptr)
+    pool->parallel_for (n_tasks, run);
+  else
+    run (0);
+}
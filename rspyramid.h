@@ -0,0 +1,66 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_PYRAMID_H__
+#define __RS_PYRAMID_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "rsworkerpool.h"
+
+constexpr const int RS_PYRAMID_MAX_LEVELS = 6;
+
+enum RsPyramidDepthFilter
+{
+  RsPyramidDepthMin,    // nearest valid sample of each 2x2 block
+  RsPyramidDepthMedian  // lower median of the valid samples
+};
+
+/* One image of one level inside the pyramid buffer */
+struct RsPyramidPlane
+{
+  int width;
+  int height;
+  int stride;     // bytes
+  size_t offset;  // bytes from the start of the pyramid buffer
+};
+
+struct RsPyramidLevel
+{
+  RsPyramidPlane color;  // RGB
+  RsPyramidPlane depth;  // Z16
+};
+
+/* Lays out n_levels half-resolution levels below the given color and
+ * depth sizes in one buffer: all color levels, then all depth levels.
+ * Level 0 of the result is half the input size. Returns the number of
+ * levels that fit (a level stops the pyramid once a side reaches 0) and
+ * the total buffer size. */
+int rs_pyramid_layout(int color_width, int color_height, int depth_width,
+    int depth_height, int n_levels, RsPyramidLevel *levels, size_t *size);
+
+/* Builds every level in one blocked pass over the inputs: each block of
+ * 2^n base rows is reduced down all levels while it is still in cache.
+ * Blocks are independent and are spread across pool when given. */
+void rs_pyramid_build(const uint8_t *rgb, int rgb_stride, const uint16_t *depth,
+    int depth_stride, const RsPyramidLevel *levels, int n_levels,
+    RsPyramidDepthFilter depth_filter, uint8_t *out, RsWorkerPool *pool);
+
+#endif /* __RS_PYRAMID_H__ */
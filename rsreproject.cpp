@@ -0,0 +1,186 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rsreproject.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <librealsense2/rsutil.h>
+
+static constexpr int MAX_BANDS = 64;
+/* Footprints wider than this come from samples right in front of the lens */
+static constexpr int MAX_FOOTPRINT = 32;
+
+rs2_intrinsics
+rs_scale_intrinsics (const rs2_intrinsics & intrin, float scale)
+{
+  rs2_intrinsics out = intrin;
+  out.width = std::max (1, static_cast<int> (std::ceil (intrin.width * scale - 1e-3f)));
+  out.height = std::max (1, static_cast<int> (std::ceil (intrin.height * scale - 1e-3f)));
+  out.fx = intrin.fx * scale;
+  out.fy = intrin.fy * scale;
+  /* Pixel centres sit at +0.5, so the principal point scales about the corner */
+  out.ppx = (intrin.ppx + 0.5f) * scale - 0.5f;
+  out.ppy = (intrin.ppy + 0.5f) * scale - 0.5f;
+  return out;
+}
+
+void
+RsReprojector::configure (const rs2_intrinsics & depth, const rs2_intrinsics & color,
+    const rs2_extrinsics & depth_to_color, float depth_scale, float grid_scale)
+{
+  depth_ = depth;
+  grid_ = rs_scale_intrinsics (color, grid_scale);
+  extrin_ = depth_to_color;
+  depth_scale_ = depth_scale;
+
+  pinhole_ = grid_.model == RS2_DISTORTION_NONE;
+  if (!pinhole_)
+    pinhole_ = std::all_of (std::begin (grid_.coeffs), std::end (grid_.coeffs),
+        [] (float c) { return c == 0.0f; });
+
+  const int cw = depth.width + 1, ch = depth.height + 1;
+  corners_.resize (static_cast<size_t> (cw) * ch * 2);
+  for (int y = 0; y < ch; ++y) {
+    for (int x = 0; x < cw; ++x) {
+      const float pixel[2] = { x - 0.5f, y - 0.5f };
+      float point[3];
+      rs2_deproject_pixel_to_point (point, &depth_, pixel, 1.0f);
+      float *c = &corners_[(static_cast<size_t> (y) * cw + x) * 2];
+      c[0] = point[0];
+      c[1] = point[1];
+    }
+  }
+}
+
+inline void
+RsReprojector::to_pixel (const float point[3], float pixel[2]) const
+{
+  if (pinhole_) {
+    pixel[0] = point[0] / point[2] * grid_.fx + grid_.ppx;
+    pixel[1] = point[1] / point[2] * grid_.fy + grid_.ppy;
+  } else {
+    rs2_project_point_to_pixel (pixel, &grid_, point);
+  }
+}
+
+/* Nearest grid index of a projected coordinate, kept within [-1, size] */
+static inline int
+grid_round (float v, int size)
+{
+  if (!(v > -1.0f))
+    return -1;
+  /* floor (v + 0.5) without a libm call; the argument is positive here */
+  return static_cast<int> (std::min (v + 1.5f, size + 1.0f)) - 1;
+}
+
+/* Keep the nearest sample; with more than one band, bands may hit the
+ * same target pixel */
+template <bool Shared>
+static inline void
+splat_min (uint16_t * p, uint16_t z)
+{
+  if (!Shared) {
+    if (*p == 0 || z < *p)
+      *p = z;
+    return;
+  }
+  uint16_t cur = __atomic_load_n (p, __ATOMIC_RELAXED);
+  while ((cur == 0 || z < cur)
+      && !__atomic_compare_exchange_n (p, &cur, z, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+  }
+}
+
+template <bool Shared>
+void
+RsReprojector::project_rows (const uint16_t * depth, size_t depth_stride, int y0, int y1,
+    uint16_t * out, size_t out_stride) const
+{
+  const int width = depth_.width;
+  const size_t cw = static_cast<size_t> (width) + 1;
+  const float *r = extrin_.rotation;
+  const float *t = extrin_.translation;
+
+  for (int y = y0; y < y1; ++y) {
+    const auto *row = reinterpret_cast<const uint16_t *> (
+        reinterpret_cast<const uint8_t *> (depth) + y * depth_stride);
+    const float *top = &corners_[y * cw * 2];
+    const float *bottom = &corners_[(y + 1) * cw * 2];
+
+    for (int x = 0; x < width; ++x) {
+      const uint16_t z = row[x];
+      if (!z)
+        continue;
+      const float zm = z * depth_scale_;
+
+      /* Top-left and bottom-right corner of the pixel into the color camera */
+      float pixel[2][2];
+      const float *corner[2] = { top + x * 2, bottom + (x + 1) * 2 };
+      bool visible = true;
+      for (int i = 0; i < 2 && visible; ++i) {
+        const float px = corner[i][0] * zm, py = corner[i][1] * zm;
+        const float point[3] = {
+          r[0] * px + r[3] * py + r[6] * zm + t[0],
+          r[1] * px + r[4] * py + r[7] * zm + t[1],
+          r[2] * px + r[5] * py + r[8] * zm + t[2],
+        };
+        visible = point[2] > 0.0f;
+        if (visible)
+          to_pixel (point, pixel[i]);
+      }
+      if (!visible)
+        continue;
+
+      const int u0 = std::max (grid_round (pixel[0][0], grid_.width), 0);
+      const int v0 = std::max (grid_round (pixel[0][1], grid_.height), 0);
+      const int u1 = std::min (grid_round (pixel[1][0], grid_.width), grid_.width - 1);
+      const int v1 = std::min (grid_round (pixel[1][1], grid_.height), grid_.height - 1);
+      if (u1 - u0 > MAX_FOOTPRINT || v1 - v0 > MAX_FOOTPRINT)
+        continue;
+      for (int v = v0; v <= v1; ++v) {
+        auto *dst = reinterpret_cast<uint16_t *> (reinterpret_cast<uint8_t *> (out) + v * out_stride);
+        for (int u = u0; u <= u1; ++u)
+          splat_min<Shared> (dst + u, z);
+      }
+    }
+  }
+}
+
+void
+RsReprojector::project (const uint16_t * depth, size_t depth_stride, uint16_t * out,
+    size_t out_stride, RsWorkerPool * pool) const
+{
+  for (int v = 0; v < grid_.height; ++v)
+    memset (reinterpret_cast<uint8_t *> (out) + v * out_stride, 0, grid_.width * sizeof (uint16_t));
+
+  const int height = depth_.height;
+  const int n_bands = pool ? std::min<int> ({ static_cast<int> (pool->size ()) * 2, MAX_BANDS,
+      std::max (height, 1) }) : 1;
+  auto run = [&] (size_t band) {
+    project_rows<true> (depth, depth_stride, static_cast<int> (band * height / n_bands),
+        static_cast<int> ((band + 1) * height / n_bands), out, out_stride);
+  };
+
+  if (n_bands > 1)
+    pool->parallel_for (n_bands, run);
+  else
+    project_rows<false> (depth, depth_stride, 0, height, out, out_stride);
+}
@@ -0,0 +1,75 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_REPROJECT_H__
+#define __RS_REPROJECT_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <librealsense2/rs.hpp>
+
+#include "rsworkerpool.h"
+
+/* Intrinsics of the same camera sampled on a grid scaled by `scale` in both
+ * axes. The grid is rounded up to whole pixels; the distortion model and
+ * coefficients work on normalized coordinates and carry over unchanged. */
+rs2_intrinsics rs_scale_intrinsics(const rs2_intrinsics &intrin, float scale);
+
+/* Depth to color reprojection onto a (possibly scaled) color pixel grid.
+ *
+ * Like rs2::align, each depth pixel is deprojected, moved into the color
+ * camera and splatted over the footprint its pixel corners project to,
+ * keeping the nearest sample where footprints overlap. The corner rays are
+ * computed once per configuration, so a frame costs two projections per
+ * valid pixel. Output samples keep the depth units of the input. */
+class RsReprojector
+{
+public:
+  /* depth_scale converts depth units to metres (the unit of the extrinsics).
+   * The target grid is the color image scaled by grid_scale. */
+  void configure(const rs2_intrinsics &depth, const rs2_intrinsics &color,
+      const rs2_extrinsics &depth_to_color, float depth_scale, float grid_scale);
+
+  int width() const { return grid_.width; }
+  int height() const { return grid_.height; }
+  const rs2_intrinsics &intrinsics() const { return grid_; }
+
+  /* Writes width() x height() samples to out, 0 where nothing lands. Rows
+   * of depth are split into bands across pool when given. */
+  void project(const uint16_t *depth, size_t depth_stride, uint16_t *out,
+      size_t out_stride, RsWorkerPool *pool) const;
+
+private:
+  template <bool Shared>
+  void project_rows(const uint16_t *depth, size_t depth_stride, int y0, int y1,
+      uint16_t *out, size_t out_stride) const;
+  void to_pixel(const float point[3], float pixel[2]) const;
+
+  rs2_intrinsics depth_ = {};
+  rs2_intrinsics grid_ = {};
+  rs2_extrinsics extrin_ = {};
+  float depth_scale_ = 0.001f;
+  bool pinhole_ = true;
+  /* (x, y) at z = 1 of the (width + 1) x (height + 1) depth pixel corners */
+  std::vector<float> corners_;
+};
+
+#endif /* __RS_REPROJECT_H__ */
@@ -0,0 +1,132 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rssparse.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+/* Each band compacts into its own worst-case region plus one slack record */
+static constexpr int MAX_BANDS = 64;
+static constexpr int BLOCK = 16;
+
+size_t
+rs_sparse_max_size (int width, int height)
+{
+  return sizeof (RsSparseHeader)
+      + (static_cast<size_t> (width) * height + MAX_BANDS) * sizeof (RsSparsePoint);
+}
+
+/* True if all BLOCK samples at p are zero */
+static inline bool
+block_empty (const uint16_t * p)
+{
+#if defined(__SSE2__)
+  const __m128i a = _mm_loadu_si128 (reinterpret_cast<const __m128i *> (p));
+  const __m128i b = _mm_loadu_si128 (reinterpret_cast<const __m128i *> (p + 8));
+  return _mm_movemask_epi8 (_mm_cmpeq_epi16 (_mm_or_si128 (a, b), _mm_setzero_si128 ())) == 0xFFFF;
+#elif defined(__aarch64__)
+  return vmaxvq_u16 (vorrq_u16 (vld1q_u16 (p), vld1q_u16 (p + 8))) == 0;
+#else
+  uint64_t w[4];
+  memcpy (w, p, sizeof (w));
+  return (w[0] | w[1] | w[2] | w[3]) == 0;
+#endif
+}
+
+/* Every sample is written to out[n] and n only advances for valid ones, so
+ * the loop has no data-dependent branch; out needs one spare record. */
+static inline size_t
+compact_span (const uint16_t * row, int x0, int x1, uint16_t v, RsSparsePoint * out, size_t n)
+{
+  for (int x = x0; x < x1; ++x) {
+    const uint16_t z = row[x];
+    out[n] = { static_cast<uint16_t> (x), v, z };
+    n += (z != 0);
+  }
+  return n;
+}
+
+static size_t
+compact_rows (const uint16_t * depth, size_t depth_stride, int width, int y0, int y1,
+    RsSparsePoint * out)
+{
+  size_t n = 0;
+  for (int y = y0; y < y1; ++y) {
+    const auto *row = reinterpret_cast<const uint16_t *> (
+        reinterpret_cast<const uint8_t *> (depth) + y * depth_stride);
+    const uint16_t v = static_cast<uint16_t> (y);
+    int x = 0;
+    for (; x + BLOCK <= width; x += BLOCK) {
+      if (!block_empty (row + x))
+        n = compact_span (row, x, x + BLOCK, v, out, n);
+    }
+    n = compact_span (row, x, width, v, out, n);
+  }
+  return n;
+}
+
+size_t
+rs_sparse_compact (const uint16_t * depth, size_t depth_stride, int width, int height,
+    uint8_t * out, RsWorkerPool * pool)
+{
+  auto *points = reinterpret_cast<RsSparsePoint *> (out + sizeof (RsSparseHeader));
+  const int n_bands = pool ? std::min<int> ({ static_cast<int> (pool->size ()) * 2, MAX_BANDS,
+      std::max (height, 1) }) : 1;
+
+  size_t counts[MAX_BANDS];
+  auto band_rows = [&] (size_t band, int *y0, int *y1) {
+    *y0 = static_cast<int> (band * height / n_bands);
+    *y1 = static_cast<int> ((band + 1) * height / n_bands);
+  };
+  /* Band b starts at its first pixel's slot plus one slack record per earlier band */
+  auto band_base = [&] (size_t band, int y0) {
+    return points + static_cast<size_t> (y0) * width + band;
+  };
+  auto run = [&] (size_t band) {
+    int y0, y1;
+    band_rows (band, &y0, &y1);
+    counts[band] = compact_rows (depth, depth_stride, width, y0, y1, band_base (band, y0));
+  };
+
+  if (n_bands > 1)
+    pool->parallel_for (n_bands, run);
+  else
+    run (0);
+
+  /* Close the gaps between bands; cheap when the frame is sparse */
+  size_t count = counts[0];
+  for (int band = 1; band < n_bands; ++band) {
+    int y0, y1;
+    band_rows (band, &y0, &y1);
+    memmove (points + count, band_base (band, y0), counts[band] * sizeof (RsSparsePoint));
+    count += counts[band];
+  }
+
+  RsSparseHeader header = { RS_SPARSE_MAGIC, static_cast<uint32_t> (count),
+      static_cast<uint16_t> (width), static_cast<uint16_t> (height), 0 };
+  memcpy (out, &header, sizeof (header));
+  return sizeof (RsSparseHeader) + count * sizeof (RsSparsePoint);
+}
@@ -0,0 +1,62 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_SPARSE_H__
+#define __RS_SPARSE_H__
+
+#include <cstddef>
+#include <cstdint>
+
+#include "rsworkerpool.h"
+
+/* Sparse depth buffer: an RsSparseHeader followed by `count` RsSparsePoint
+ * records of the valid (non-zero) pixels in row-major order. All fields
+ * are little-endian. */
+constexpr const uint32_t RS_SPARSE_MAGIC = 0x31505352;  // "RSP1"
+
+struct RsSparseHeader
+{
+  uint32_t magic;
+  uint32_t count;
+  uint16_t width;   // size of the depth frame the points come from
+  uint16_t height;
+  uint32_t reserved;
+};
+
+struct RsSparsePoint
+{
+  uint16_t u;  // column
+  uint16_t v;  // row
+  uint16_t z;  // depth in depth units
+};
+
+static_assert (sizeof (RsSparseHeader) == 16, "RsSparseHeader must be packed");
+static_assert (sizeof (RsSparsePoint) == 6, "RsSparsePoint must be packed");
+
+/* Worst-case size of a sparse buffer for a width x height frame, including
+ * the slack the branchless compaction writes past the last record. */
+size_t rs_sparse_max_size(int width, int height);
+
+/* Writes header and records of all non-zero pixels to out, which must hold
+ * rs_sparse_max_size() bytes. Rows are split into bands across pool when
+ * given. Returns the number of bytes used. */
+size_t rs_sparse_compact(const uint16_t *depth, size_t depth_stride, int width,
+    int height, uint8_t *out, RsWorkerPool *pool);
+
+#endif /* __RS_SPARSE_H__ */
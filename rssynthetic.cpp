@@ -0,0 +1,234 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rssynthetic.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "rssyntheticscene.h"
+
+static rs2_intrinsics
+synthetic_intrinsics (int width, int height, float focal_scale)
+{
+  rs2_intrinsics intrin = {};
+  intrin.width = width;
+  intrin.height = height;
+  intrin.fx = intrin.fy = width * focal_scale;
+  intrin.ppx = (width - 1) * 0.5f;
+  intrin.ppy = (height - 1) * 0.5f;
+  intrin.model = RS2_DISTORTION_NONE;
+  return intrin;
+}
+
+RsSyntheticCamera::~RsSyntheticCamera ()
+{
+  stop ();
+}
+
+void
+RsSyntheticCamera::add_to (rs2::context & ctx, const RsModeTable & color_modes,
+    const RsModeTable & depth_modes, float depth_units)
+{
+  depth_units_ = depth_units;
+  device_.register_info (RS2_CAMERA_INFO_NAME, "Synthetic RealSense");
+  device_.register_info (RS2_CAMERA_INFO_SERIAL_NUMBER, SERIAL);
+  depth_.add_read_only_option (RS2_OPTION_DEPTH_UNITS, depth_units_);
+
+  const rs2_extrinsics identity = { { 1, 0, 0, 0, 1, 0, 0, 0, 1 }, { 0, 0, 0 } };
+  const rs2_extrinsics baseline = { { 1, 0, 0, 0, 1, 0, 0, 0, 1 },
+      { RsSyntheticScene::BASELINE_M, 0, 0 } };
+  int uid = 0;
+
+  /* Every profile is tied to the first color one, which links them all */
+  rs2::stream_profile reference;
+  for (const auto &mode : color_modes) {
+    const int w = std::get<0> (mode), h = std::get<1> (mode), fps = std::get<2> (mode);
+    const rs2_video_stream stream = { RS2_STREAM_COLOR, 0, uid++, w, h, fps, 3, RS2_FORMAT_RGB8,
+        synthetic_intrinsics (w, h, RsSyntheticScene::COLOR_FOCAL) };
+    rs2::stream_profile profile = color_.add_video_stream (stream, uid == 1);
+    if (uid == 1)
+      reference = profile;
+    else
+      profile.register_extrinsics_to (reference, identity);
+  }
+  for (const auto &mode : depth_modes) {
+    const int w = std::get<0> (mode), h = std::get<1> (mode), fps = std::get<2> (mode);
+    const rs2_video_stream stream = { RS2_STREAM_DEPTH, 0, uid++, w, h, fps, 2, RS2_FORMAT_Z16,
+        synthetic_intrinsics (w, h, RsSyntheticScene::DEPTH_FOCAL) };
+    depth_.add_video_stream (stream).register_extrinsics_to (reference, baseline);
+  }
+
+  device_.create_matcher (RS2_MATCHER_DEFAULT);
+  device_.add_to (ctx);
+
+  running_ = true;
+  thread_ = std::thread (&RsSyntheticCamera::run, this);
+}
+
+void
+RsSyntheticCamera::stop ()
+{
+  running_ = false;
+  if (thread_.joinable ())
+    thread_.join ();
+}
+
+static void
+free_pixels (void *pixels)
+{
+  delete[] static_cast<uint8_t *> (pixels);
+}
+
+/* Which columns and rows of an image from a camera at origin_x see the
+ * square; a pixel does if both do */
+static void
+square_mask (int width, int height, float focal, double origin_x, double seconds,
+    std::vector<bool> & columns, std::vector<bool> & rows)
+{
+  columns.resize (width);
+  rows.resize (height);
+  double rx, ry;
+  for (int x = 0; x < width; ++x) {
+    RsSyntheticScene::pixel_ray (x, 0, width, height, focal, &rx, &ry);
+    columns[x] = RsSyntheticScene::square_columns (origin_x, rx, seconds);
+  }
+  for (int y = 0; y < height; ++y) {
+    RsSyntheticScene::pixel_ray (0, y, width, height, focal, &rx, &ry);
+    rows[y] = RsSyntheticScene::square_rows (ry);
+  }
+}
+
+static uint8_t *
+generate_color (int width, int height, double seconds)
+{
+  auto *pixels = new uint8_t[static_cast<size_t> (width) * height * 3];
+  std::vector<bool> columns, rows;
+  square_mask (width, height, RsSyntheticScene::COLOR_FOCAL, -RsSyntheticScene::BASELINE_M,
+      seconds, columns, rows);
+  for (int y = 0; y < height; ++y) {
+    uint8_t *row = pixels + static_cast<size_t> (y) * width * 3;
+    for (int x = 0; x < width; ++x) {
+      const bool in = rows[y] && columns[x];
+      row[3 * x] = in ? 230 : static_cast<uint8_t> (x * 255 / width);
+      row[3 * x + 1] = in ? 200 : static_cast<uint8_t> (y * 255 / height);
+      row[3 * x + 2] = in ? 40 : 96;
+    }
+  }
+  return pixels;
+}
+
+/* Distance in depth units, 0 (no data) past the 16-bit range */
+static uint16_t
+depth_value (double metres, float units)
+{
+  const double value = std::round (metres / units);
+  return value <= 65535.0 ? static_cast<uint16_t> (value) : 0;
+}
+
+static uint8_t *
+generate_depth (int width, int height, double seconds, float units)
+{
+  auto *pixels = new uint8_t[static_cast<size_t> (width) * height * sizeof (uint16_t)];
+  auto *depth = reinterpret_cast<uint16_t *> (pixels);
+  std::vector<bool> columns, rows;
+  square_mask (width, height, RsSyntheticScene::DEPTH_FOCAL, 0.0, seconds, columns, rows);
+  const int invalid = RsSyntheticScene::invalid_columns (width);
+  const uint16_t wall = depth_value (RsSyntheticScene::WALL_M, units);
+  const uint16_t square = depth_value (RsSyntheticScene::SQUARE_M, units);
+  for (int y = 0; y < height; ++y) {
+    uint16_t *row = depth + static_cast<size_t> (y) * width;
+    for (int x = 0; x < width; ++x) {
+      const bool in = rows[y] && columns[x];
+      row[x] = x < invalid ? 0 : in ? square : wall;
+    }
+  }
+  return pixels;
+}
+
+void
+RsSyntheticCamera::run ()
+{
+  using namespace std::chrono;
+
+  struct Stream
+  {
+    rs2::software_sensor *sensor;
+    bool is_depth;
+    int uid = -1;          // profile being generated, -1 while not streaming
+    int64_t next_us = 0;   // due time of the next frame since start
+    int frame_number = 0;
+  };
+  Stream streams[2] = { { &color_, false }, { &depth_, true } };
+
+  /* Both streams count frames from one epoch, so equal rates give equal
+   * timestamps and the matcher pairs them */
+  const auto start = steady_clock::now ();
+  const double epoch_ms = duration<double, std::milli> (
+      system_clock::now ().time_since_epoch ()).count ();
+
+  while (running_) {
+    const int64_t elapsed = duration_cast<microseconds> (steady_clock::now () - start).count ();
+    int64_t wake = elapsed + 10000;
+
+    for (Stream &s : streams) {
+      const auto active = s.sensor->get_active_streams ();
+      if (active.empty ()) {
+        s.uid = -1;
+        continue;
+      }
+      const rs2::video_stream_profile profile = active[0].as<rs2::video_stream_profile> ();
+      const int64_t period = 1000000 / std::max (profile.fps (), 1);
+      if (s.uid != profile.unique_id ()) {
+        s.uid = profile.unique_id ();
+        s.next_us = (elapsed + period - 1) / period * period;
+      }
+
+      if (elapsed >= s.next_us) {
+        /* The scene moves with the frame timestamp, which consumers see */
+        const double timestamp = epoch_ms + s.next_us / 1e3;
+        const double seconds = timestamp / 1e3;
+        const int w = profile.width (), h = profile.height ();
+        const int bpp = s.is_depth ? 2 : 3;
+        rs2_software_video_frame frame = {};
+        frame.pixels = s.is_depth ? generate_depth (w, h, seconds, depth_units_) : generate_color (w, h, seconds);
+        frame.deleter = free_pixels;
+        frame.stride = w * bpp;
+        frame.bpp = bpp;
+        frame.timestamp = timestamp;
+        frame.domain = RS2_TIMESTAMP_DOMAIN_SYSTEM_TIME;
+        frame.frame_number = ++s.frame_number;
+        frame.profile = profile.get ();
+        frame.depth_units = depth_units_;
+        s.sensor->on_video_frame (frame);
+
+        /* Skip frames rather than burst when the host fell behind */
+        s.next_us += period;
+        if (s.next_us <= elapsed)
+          s.next_us = (elapsed / period + 1) * period;
+      }
+      wake = std::min (wake, s.next_us);
+    }
+
+    std::this_thread::sleep_until (start + microseconds (wake));
+  }
+}
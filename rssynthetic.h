@@ -0,0 +1,68 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_SYNTHETIC_H__
+#define __RS_SYNTHETIC_H__
+
+#include <atomic>
+#include <thread>
+
+#include <librealsense2/rs.hpp>
+#include <librealsense2/hpp/rs_internal.hpp>
+
+#include "rsadaptive.h"
+
+/* A librealsense software device that streams generated frames, so the
+ * element can be started, benchmarked and tested without a camera.
+ *
+ * It offers every mode of the given tables, with plausible intrinsics and
+ * a 15 mm baseline, and follows whatever modes the pipeline opens. Both
+ * see a wall at 2 m and a square moving at 1 m (rssyntheticscene.h); color
+ * is a gradient with the square in yellow, depth has an invalid border.
+ * Frames are timestamped in system time and the square moves with the
+ * timestamp. */
+class RsSyntheticCamera
+{
+public:
+  static constexpr const char *SERIAL = "synthetic-0";
+
+  RsSyntheticCamera() = default;
+  ~RsSyntheticCamera();
+
+  RsSyntheticCamera(const RsSyntheticCamera &) = delete;
+  RsSyntheticCamera &operator=(const RsSyntheticCamera &) = delete;
+
+  /* Creates the device in ctx, reporting depth in units of depth_units
+   * metres, and starts the generator thread */
+  void add_to(rs2::context &ctx, const RsModeTable &color_modes, const RsModeTable &depth_modes,
+      float depth_units = 0.001f);
+  void stop();
+
+private:
+  void run();
+
+  rs2::software_device device_;
+  rs2::software_sensor color_ = device_.add_sensor("Synthetic Color");
+  rs2::software_sensor depth_ = device_.add_sensor("Synthetic Depth");
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  float depth_units_ = 0.001f;
+};
+
+#endif /* __RS_SYNTHETIC_H__ */
@@ -0,0 +1,108 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_SYNTHETIC_SCENE_H__
+#define __RS_SYNTHETIC_SCENE_H__
+
+#include <cmath>
+
+/* The scene RsSyntheticCamera renders, in metres in depth camera
+ * coordinates: a wall at 2 m and, at 1 m in front of it, a 0.3 m square
+ * that sweeps from left to right every 4 s. The color camera sits
+ * BASELINE_M to the right with a narrower field of view; neither has
+ * distortion. Both render the same geometry, so color edges are depth
+ * edges. Header only, without librealsense, so tools can score output
+ * depth against the scene. */
+namespace RsSyntheticScene {
+
+/* Depth to color offset of a D400 */
+constexpr float BASELINE_M = 0.015f;
+constexpr double WALL_M = 2.0;
+constexpr double SQUARE_M = 1.0;
+constexpr double SQUARE_SIDE_M = 0.3;
+/* Range of the square's left edge over a sweep */
+constexpr double SQUARE_FROM_M = -0.75;
+constexpr double SQUARE_TO_M = 0.45;
+/* Focal lengths in pixels per pixel of image width */
+constexpr float COLOR_FOCAL = 0.71f;
+constexpr float DEPTH_FOCAL = 0.6f;
+
+/* Ray through pixel (x, y) of an image with the given focal length, pixel
+ * centres on integers and the principal point in the middle, as its (x, y)
+ * at z = 1 */
+inline void
+pixel_ray(double x, double y, int width, int height, float focal, double *rx, double *ry)
+{
+  *rx = (x - (width - 1) * 0.5) / (focal * width);
+  *ry = (y - (height - 1) * 0.5) / (focal * width);
+}
+
+/* Whether a ray from (origin_x, 0, 0) through (origin_x + rx, ry, 1) hits
+ * the square at a frame timestamp (system time); split by axis so images
+ * can test columns and rows once each. Tools recompute the position from
+ * the sensor timestamp. */
+inline bool
+square_columns(double origin_x, double rx, double seconds)
+{
+  const double phase = seconds * 0.25 - std::floor(seconds * 0.25);
+  const double left = SQUARE_FROM_M + phase * (SQUARE_TO_M - SQUARE_FROM_M);
+  const double x = origin_x + rx * SQUARE_M;
+  return x >= left && x < left + SQUARE_SIDE_M;
+}
+
+inline bool
+square_rows(double ry)
+{
+  const double y = ry * SQUARE_M;
+  return y >= -0.5 * SQUARE_SIDE_M && y < 0.5 * SQUARE_SIDE_M;
+}
+
+/* The band only the left imager sees, without depth, as on a D400 */
+inline int
+invalid_columns(int width)
+{
+  return width / 32;
+}
+
+/* Distance in metres the color camera sees at pixel (x, y) of a color frame
+ * of the given size, with depth frames of the given size at timestamp
+ * seconds. 0 where the depth camera has no data for the point: its invalid
+ * band and outside its field of view. Points it cannot see behind the
+ * square still count. */
+inline double
+color_truth(double x, double y, int color_width, int color_height, int depth_width,
+    int depth_height, double seconds)
+{
+  double rx, ry;
+  pixel_ray(x, y, color_width, color_height, COLOR_FOCAL, &rx, &ry);
+  const double origin_x = -BASELINE_M;
+  const double z = square_columns(origin_x, rx, seconds) && square_rows(ry) ? SQUARE_M : WALL_M;
+
+  /* The depth pixel the point falls on */
+  const double depth_f = DEPTH_FOCAL * depth_width;
+  const int u = static_cast<int>(std::floor((origin_x / z + rx) * depth_f + depth_width * 0.5));
+  const int v = static_cast<int>(std::floor(ry * depth_f + depth_height * 0.5));
+  if (u < invalid_columns(depth_width) || u >= depth_width || v < 0 || v >= depth_height)
+    return 0.0;
+  return z;
+}
+
+}  // namespace RsSyntheticScene
+
+#endif /* __RS_SYNTHETIC_SCENE_H__ */
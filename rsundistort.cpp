@@ -0,0 +1,169 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rsundistort.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <librealsense2/rsutil.h>
+
+static constexpr int MAX_BANDS = 64;
+static constexpr int WEIGHT_BITS = 6;
+static constexpr int WEIGHT_ONE = 1 << WEIGHT_BITS;
+
+bool
+RsUndistorter::configure (const rs2_intrinsics & intrin)
+{
+  const bool distorted = intrin.model != RS2_DISTORTION_NONE
+      && std::any_of (std::begin (intrin.coeffs), std::end (intrin.coeffs),
+          [] (float c) { return c != 0.0f; });
+  if (!distorted || intrin.width < 2 || intrin.height < 2) {
+    taps_.clear ();
+    return false;
+  }
+
+  out_ = intrin;
+  out_.model = RS2_DISTORTION_NONE;
+  std::fill (std::begin (out_.coeffs), std::end (out_.coeffs), 0.0f);
+
+  const int w = intrin.width, h = intrin.height;
+  taps_.resize (static_cast<size_t> (w) * h);
+  auto quantize = [] (float v, int size, uint16_t * base, uint8_t * weight) {
+    v = std::min (std::max (v, 0.0f), static_cast<float> (size - 1));
+    const int i = std::min (static_cast<int> (v), size - 2);
+    *base = static_cast<uint16_t> (i);
+    *weight = static_cast<uint8_t> (std::lround ((v - i) * WEIGHT_ONE));
+  };
+
+  for (int y = 0; y < h; ++y) {
+    for (int x = 0; x < w; ++x) {
+      /* The ray through this pixel of the ideal image, into the real one */
+      const float point[3] = { (x - out_.ppx) / out_.fx, (y - out_.ppy) / out_.fy, 1.0f };
+      float pixel[2];
+      rs2_project_point_to_pixel (pixel, &intrin, point);
+      Tap &tap = taps_[static_cast<size_t> (y) * w + x];
+      quantize (pixel[0], w, &tap.x, &tap.wx);
+      quantize (pixel[1], h, &tap.y, &tap.wy);
+    }
+  }
+  return true;
+}
+
+/* ----> Scalar */
+
+static inline void
+remap_pixel (const uint8_t * in, size_t in_stride, const RsUndistorter::Tap & tap, uint8_t * out)
+{
+  const uint8_t *top = in + tap.y * in_stride + tap.x * 3;
+  const uint8_t *bottom = top + in_stride;
+  const int wx = tap.wx, wy = tap.wy;
+  for (int c = 0; c < 3; ++c) {
+    const int t = top[c] * (WEIGHT_ONE - wx) + top[c + 3] * wx;
+    const int b = bottom[c] * (WEIGHT_ONE - wx) + bottom[c + 3] * wx;
+    out[c] = static_cast<uint8_t> ((t * (WEIGHT_ONE - wy) + b * wy
+        + (1 << (2 * WEIGHT_BITS - 1))) >> (2 * WEIGHT_BITS));
+  }
+}
+
+static void
+remap_row_scalar (const uint8_t * in, size_t in_stride, const RsUndistorter::Tap * taps,
+    uint8_t * out, int width)
+{
+  for (int x = 0; x < width; ++x)
+    remap_pixel (in, in_stride, taps[x], out + 3 * x);
+}
+
+/* ----> SSSE3: one pixel per iteration, both taps of a row in one load.
+ * Bytes of the top and bottom rows are interleaved so pmaddubsw blends
+ * them vertically, then pmaddwd blends the left and right pixel. */
+
+#ifdef RS_MUX_HAVE_SSSE3
+RS_MUX_SSSE3 static void
+remap_row_ssse3 (const uint8_t * in, size_t in_stride, const RsUndistorter::Tap * taps,
+    uint8_t * out, int width)
+{
+  /* Pairs the left and right value of each channel: 16-bit lanes (0, 3),
+   * (1, 4), (2, 5) */
+  const __m128i pair_mask = _mm_setr_epi8 (0, 1, 6, 7, 2, 3, 8, 9, 4, 5, 10, 11,
+      -1, -1, -1, -1);
+  const __m128i pack_mask = _mm_setr_epi8 (0, 4, 8, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      -1, -1, -1, -1);
+  const __m128i round = _mm_set1_epi32 (1 << (2 * WEIGHT_BITS - 1));
+
+  /* 8-byte loads from the last two source columns would cross the row end,
+   * and the 4-byte store of the last pixel the output row end */
+  int x = 0;
+  for (; x < width - 1; ++x) {
+    const RsUndistorter::Tap tap = taps[x];
+    if (tap.x + 3 > width) {
+      remap_pixel (in, in_stride, tap, out + 3 * x);
+      continue;
+    }
+    const uint8_t *top = in + tap.y * in_stride + tap.x * 3;
+    const __m128i t = _mm_loadl_epi64 (reinterpret_cast<const __m128i *> (top));
+    const __m128i b = _mm_loadl_epi64 (reinterpret_cast<const __m128i *> (top + in_stride));
+    const __m128i wy = _mm_set1_epi16 (static_cast<short> ((tap.wy << 8) | (WEIGHT_ONE - tap.wy)));
+    const __m128i vertical = _mm_maddubs_epi16 (_mm_unpacklo_epi8 (t, b), wy);
+    const __m128i wx = _mm_set1_epi32 ((tap.wx << 16) | (WEIGHT_ONE - tap.wx));
+    __m128i v = _mm_madd_epi16 (_mm_shuffle_epi8 (vertical, pair_mask), wx);
+    v = _mm_srli_epi32 (_mm_add_epi32 (v, round), 2 * WEIGHT_BITS);
+    const int32_t rgb = _mm_cvtsi128_si32 (_mm_shuffle_epi8 (v, pack_mask));
+    memcpy (out + 3 * x, &rgb, sizeof (rgb));
+  }
+  for (; x < width; ++x)
+    remap_pixel (in, in_stride, taps[x], out + 3 * x);
+}
+#endif
+
+void
+RsUndistorter::remap (const uint8_t * in, size_t in_stride, uint8_t * out, size_t out_stride,
+    RsWorkerPool * pool, RSMux::Kernel kernel) const
+{
+  const int width = out_.width, height = out_.height;
+  const int n_bands = pool ? std::min<int> ({ static_cast<int> (pool->size ()) * 2, MAX_BANDS,
+      height }) : 1;
+  if (kernel == RSMux::Kernel::Auto || !RSMux::kernel_supported (kernel))
+    kernel = RSMux::best_kernel ();
+#ifdef RS_MUX_HAVE_SSSE3
+  const bool ssse3 = kernel == RSMux::Kernel::SSSE3;
+#endif
+
+  auto run = [&] (size_t band) {
+    const int y0 = static_cast<int> (band * height / n_bands);
+    const int y1 = static_cast<int> ((band + 1) * height / n_bands);
+    for (int y = y0; y < y1; ++y) {
+      const Tap *taps = taps_.data () + static_cast<size_t> (y) * width;
+      uint8_t *row = out + y * out_stride;
+#ifdef RS_MUX_HAVE_SSSE3
+      if (ssse3) {
+        remap_row_ssse3 (in, in_stride, taps, row, width);
+        continue;
+      }
+#endif
+      remap_row_scalar (in, in_stride, taps, row, width);
+    }
+  };
+
+  if (n_bands > 1)
+    pool->parallel_for (n_bands, run);
+  else
+    run (0);
+}
@@ -0,0 +1,70 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_UNDISTORT_H__
+#define __RS_UNDISTORT_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <librealsense2/rs.hpp>
+
+#include "rsmux.h"
+#include "rsworkerpool.h"
+
+/* Color undistortion through a remap table.
+ *
+ * configure() projects the ray of every pixel of the distortion-free
+ * image through the camera model once, and stores the top-left source
+ * pixel and 6-bit bilinear weights. remap() then costs one bilinear gather
+ * per pixel and can write straight into the output buffer, in place of the
+ * plain color copy. Sources outside the image take the nearest edge pixel. */
+class RsUndistorter
+{
+public:
+  /* Table for RGB images with these intrinsics. Returns false if the model
+   * has nothing to undistort (no distortion or all coefficients zero) or
+   * the image is smaller than 2x2. */
+  bool configure(const rs2_intrinsics &intrin);
+
+  /* The undistorted image: same size, focal length and principal point,
+   * no distortion */
+  const rs2_intrinsics &intrinsics() const { return out_; }
+  size_t memory() const { return taps_.size() * sizeof(Tap); }
+
+  /* Writes the undistorted image to out; in and out are RGB of the
+   * configured size. Rows are split into bands across pool when given.
+   * kernel is Auto outside of tests; unsupported kernels fall back to it. */
+  void remap(const uint8_t *in, size_t in_stride, uint8_t *out, size_t out_stride,
+      RsWorkerPool *pool, RSMux::Kernel kernel = RSMux::Kernel::Auto) const;
+
+  /* Table entry of one output pixel */
+  struct Tap
+  {
+    uint16_t x, y;    // top-left source pixel, at most width - 2, height - 2
+    uint8_t wx, wy;   // weights of the right and bottom pixels, out of 64
+  };
+
+private:
+  rs2_intrinsics out_ = {};
+  std::vector<Tap> taps_;
+};
+
+#endif /* __RS_UNDISTORT_H__ */
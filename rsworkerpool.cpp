@@ -0,0 +1,186 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include "rsworkerpool.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+struct RsExecutor::Job
+{
+  const std::function<void(size_t)> *fn;
+  size_t count;
+  std::atomic<size_t> next{0};
+  std::atomic<size_t> done{0};
+
+  std::mutex lock;
+  std::condition_variable finished_cv;
+  bool finished = false;
+};
+
+RsExecutor &
+RsExecutor::get ()
+{
+  static RsExecutor executor ([] {
+    unsigned n = std::thread::hardware_concurrency ();
+    if (const char *env = getenv ("GST_REALSENSE_THREADS"))
+      n = static_cast<unsigned> (strtoul (env, nullptr, 10));
+    return std::min (std::max (n, 1u), 256u);
+  }());
+  return executor;
+}
+
+RsExecutor::RsExecutor (unsigned n_threads)
+{
+  for (unsigned i = 0; i < n_threads; ++i)
+    workers_.emplace_back (new Worker);
+  for (unsigned i = 0; i < n_threads; ++i)
+    threads_.emplace_back (&RsExecutor::worker_loop, this, i);
+}
+
+RsExecutor::~RsExecutor ()
+{
+  {
+    std::lock_guard<std::mutex> guard (sleep_lock_);
+    quit_ = true;
+  }
+  sleep_cv_.notify_all ();
+  for (auto &t : threads_)
+    t.join ();
+}
+
+/* Only indices below count reach fn, and the submitter does not return
+ * before all of them are done, so stale tickets never touch a dead fn. */
+void
+RsExecutor::work (Job & job)
+{
+  size_t n = 0;
+  for (size_t i = job.next.fetch_add (1); i < job.count; i = job.next.fetch_add (1)) {
+    (*job.fn) (i);
+    ++n;
+  }
+  if (n && job.done.fetch_add (n) + n == job.count) {
+    std::lock_guard<std::mutex> guard (job.lock);
+    job.finished = true;
+    job.finished_cv.notify_one ();
+  }
+}
+
+std::shared_ptr<RsExecutor::Job>
+RsExecutor::take (unsigned self)
+{
+  const unsigned n = size ();
+  for (int p = N_PRIORITIES - 1; p >= 0; --p) {
+    {
+      Worker &own = *workers_[self];
+      std::lock_guard<std::mutex> guard (own.lock);
+      if (!own.queue[p].empty ()) {
+        auto job = std::move (own.queue[p].back ());
+        own.queue[p].pop_back ();
+        return job;
+      }
+    }
+    for (unsigned k = 1; k < n; ++k) {
+      Worker &victim = *workers_[(self + k) % n];
+      std::lock_guard<std::mutex> guard (victim.lock);
+      if (!victim.queue[p].empty ()) {
+        auto job = std::move (victim.queue[p].front ());
+        victim.queue[p].pop_front ();
+        steals_.fetch_add (1, std::memory_order_relaxed);
+        return job;
+      }
+    }
+  }
+  return nullptr;
+}
+
+void
+RsExecutor::worker_loop (unsigned self)
+{
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> guard (sleep_lock_);
+      sleep_cv_.wait (guard, [&] { return quit_ || queued_ > 0; });
+      if (quit_)
+        return;
+      /* Reserve a ticket; one is guaranteed to be in some deque */
+      --queued_;
+    }
+
+    std::shared_ptr<Job> job;
+    while (!(job = take (self)))
+      std::this_thread::yield ();
+    work (*job);
+  }
+}
+
+void
+RsExecutor::run (size_t count, const std::function<void(size_t)> &fn, unsigned width,
+    RsTaskPriority priority)
+{
+  if (count == 0)
+    return;
+  const size_t tickets = std::min<size_t> ({ width ? width - 1 : 0, count - 1, size () });
+  if (tickets == 0) {
+    for (size_t i = 0; i < count; ++i)
+      fn (i);
+    return;
+  }
+
+  auto job = std::make_shared<Job> ();
+  job->fn = &fn;
+  job->count = count;
+
+  const int p = static_cast<int> (priority);
+  const unsigned first = next_worker_.fetch_add (static_cast<unsigned> (tickets));
+  for (size_t i = 0; i < tickets; ++i) {
+    Worker &worker = *workers_[(first + i) % size ()];
+    std::lock_guard<std::mutex> guard (worker.lock);
+    worker.queue[p].push_back (job);
+  }
+  {
+    std::lock_guard<std::mutex> guard (sleep_lock_);
+    queued_ += tickets;
+  }
+  if (tickets == 1)
+    sleep_cv_.notify_one ();
+  else
+    sleep_cv_.notify_all ();
+
+  work (*job);
+
+  std::unique_lock<std::mutex> guard (job->lock);
+  job->finished_cv.wait (guard, [&] { return job->finished; });
+}
+
+RsWorkerPool::RsWorkerPool (unsigned n_threads, RsTaskPriority priority)
+  : width_ (std::max (n_threads, 1u)), priority_ (priority)
+{
+}
+
+void
+RsWorkerPool::parallel_for (size_t count, const std::function<void(size_t)> &fn)
+{
+  if (width_ <= 1 || count <= 1) {
+    for (size_t i = 0; i < count; ++i)
+      fn (i);
+    return;
+  }
+  RsExecutor::get ().run (count, fn, width_, priority ());
+}
@@ -0,0 +1,129 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef __RS_WORKER_POOL_H__
+#define __RS_WORKER_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum class RsTaskPriority
+{
+  Low = 0,
+  Normal = 1,
+  High = 2,
+};
+
+/* Process-wide work-stealing pool shared by every realsensesrc instance.
+ *
+ * A job of `count` indices is published as up to `width - 1` tickets,
+ * spread over the workers' deques at the job's priority. Workers pop
+ * their own deque from the back and steal from the front of the others,
+ * always draining higher priorities first. Whoever holds a ticket claims
+ * indices from the job's shared counter until it runs dry, so a camera
+ * with a heavy frame soaks up whatever capacity the others leave idle,
+ * while the total number of busy threads stays at the pool size plus the
+ * submitting streaming threads.
+ *
+ * The pool has one thread per CPU unless GST_REALSENSE_THREADS is set.
+ */
+class RsExecutor
+{
+public:
+  static RsExecutor &get();
+
+  unsigned size() const { return static_cast<unsigned>(threads_.size()); }
+
+  /* Runs fn(0) .. fn(count - 1) on at most `width` threads including the
+   * caller, which always takes part, and returns when all are done. */
+  void run(size_t count, const std::function<void(size_t)> &fn, unsigned width,
+      RsTaskPriority priority);
+
+  /* Number of tickets a worker took from another worker's deque */
+  uint64_t steals() const { return steals_.load(std::memory_order_relaxed); }
+
+  ~RsExecutor();
+
+private:
+  struct Job;
+  static constexpr int N_PRIORITIES = 3;
+
+  struct Worker
+  {
+    std::mutex lock;
+    std::deque<std::shared_ptr<Job>> queue[N_PRIORITIES];
+  };
+
+  explicit RsExecutor(unsigned n_threads);
+  RsExecutor(const RsExecutor &) = delete;
+  RsExecutor &operator=(const RsExecutor &) = delete;
+
+  void worker_loop(unsigned self);
+  std::shared_ptr<Job> take(unsigned self);
+  static void work(Job &job);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+  std::vector<std::thread> threads_;
+  std::atomic<unsigned> next_worker_{0};
+  std::atomic<uint64_t> steals_{0};
+
+  std::mutex sleep_lock_;
+  std::condition_variable sleep_cv_;
+  size_t queued_ = 0;  // tickets in all deques, under sleep_lock_
+  bool quit_ = false;
+};
+
+/* One instance's handle on the shared executor.
+ *
+ * parallel_for() runs fn(0) .. fn(count - 1) across the executor and the
+ * calling thread and returns once every index has been processed. size()
+ * is the number of threads a job may use, which callers also use to pick
+ * how many slices to cut a frame into.
+ */
+class RsWorkerPool
+{
+public:
+  /* n_threads counts the calling thread; 1 means run everything inline. */
+  explicit RsWorkerPool(unsigned n_threads,
+      RsTaskPriority priority = RsTaskPriority::Normal);
+
+  RsWorkerPool(const RsWorkerPool &) = delete;
+  RsWorkerPool &operator=(const RsWorkerPool &) = delete;
+
+  unsigned size() const { return width_; }
+
+  RsTaskPriority priority() const { return priority_.load(std::memory_order_relaxed); }
+  void set_priority(RsTaskPriority priority) { priority_.store(priority, std::memory_order_relaxed); }
+
+  void parallel_for(size_t count, const std::function<void(size_t)> &fn);
+
+private:
+  const unsigned width_;
+  std::atomic<RsTaskPriority> priority_;
+};
+
+#endif /* __RS_WORKER_POOL_H__ */
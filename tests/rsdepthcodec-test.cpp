@@ -0,0 +1,170 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* rsdepthcodec-test: lossless round trip of the depth recording codec.
+ *
+ * Frames of several sizes, including single pixels and odd widths, are
+ * encoded from planes whose rows are padded to odd strides and decoded
+ * again, with one and several bands, inline and on a worker pool. The
+ * decoded frame must equal the input exactly, including zero depth, values
+ * beyond the mux range (>= 2560) and the largest residuals (0 next to
+ * 65535). */
+
+#include <cstdio>
+#include <vector>
+
+#include "rsdepthcodec.h"
+
+namespace {
+
+struct Size
+{
+  int width, height;
+};
+
+const Size sizes[] = { { 1, 1 }, { 7, 5 }, { 33, 17 }, { 641, 37 }, { 848, 480 } };
+
+/* Extra pixels at the end of each row */
+const int paddings[] = { 0, 1, 3 };
+
+int failures = 0;
+
+uint32_t
+next (uint32_t * state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+/* Mixes smooth depth, holes, runs of zeros, out of mux range values and
+ * full-scale jumps; the padding holds garbage the encoder must skip */
+std::vector<uint16_t>
+make_depth (int width, int height, size_t stride, uint32_t seed)
+{
+  std::vector<uint16_t> depth (stride * height, 0xBEEF);
+  uint32_t rng = seed;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      uint16_t d;
+      switch (next (&rng) % 8) {
+        case 0:
+          d = 0;
+          break;
+        case 1:
+          d = static_cast<uint16_t> (2560 + next (&rng) % (65536 - 2560));
+          break;
+        case 2:
+          d = (x + y) % 2 ? 65535 : 0;
+          break;
+        default:
+          d = static_cast<uint16_t> (500 + x + 3 * y);
+          break;
+      }
+      if (y % 5 == 2 && x < width / 2)
+        d = 0;
+      depth[y * stride + x] = d;
+    }
+  }
+  return depth;
+}
+
+void
+check (const Size & size, int padding, unsigned bands, RsWorkerPool * pool)
+{
+  const size_t stride = static_cast<size_t> (size.width) + padding;
+  const std::vector<uint16_t> depth = make_depth (size.width, size.height, stride,
+      0x9E3779B9u ^ (size.width * 31 + size.height) ^ padding);
+
+  RsDepthEncoder encoder;
+  if (!encoder.init (size.width, size.height, 3, bands)) {
+    fprintf (stderr, "FAIL init %dx%d, %u bands: %s\n", size.width, size.height, bands,
+        encoder.last_error ().c_str ());
+    ++failures;
+    return;
+  }
+
+  RsArena arena;
+  arena.reserve (static_cast<size_t> (size.width) * size.height * 2);
+  std::vector<uint8_t> frame (encoder.max_size ());
+  const size_t bytes = encoder.encode (depth.data (), stride * sizeof (uint16_t), frame.data (),
+      frame.size (), &arena, pool);
+  if (bytes == 0) {
+    fprintf (stderr, "FAIL encode %dx%d: %s\n", size.width, size.height,
+        encoder.last_error ().c_str ());
+    ++failures;
+    return;
+  }
+
+  int width = 0, height = 0;
+  if (!RsDepthDecoder::peek (frame.data (), bytes, &width, &height) || width != size.width
+      || height != size.height) {
+    fprintf (stderr, "FAIL peek %dx%d\n", size.width, size.height);
+    ++failures;
+    return;
+  }
+
+  RsDepthDecoder decoder;
+  std::vector<uint16_t> decoded (static_cast<size_t> (width) * height);
+  if (!decoder.decode (frame.data (), bytes, decoded.data (), pool)) {
+    fprintf (stderr, "FAIL decode %dx%d: %s\n", size.width, size.height,
+        decoder.last_error ().c_str ());
+    ++failures;
+    return;
+  }
+
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      if (decoded[static_cast<size_t> (y) * width + x] != depth[y * stride + x]) {
+        fprintf (stderr, "FAIL %dx%d, padding %d, %u bands, %s: pixel (%d, %d) is %u, "
+            "expected %u\n", size.width, size.height, padding, bands,
+            pool ? "pool" : "inline", x, y, decoded[static_cast<size_t> (y) * width + x],
+            depth[y * stride + x]);
+        ++failures;
+        return;
+      }
+    }
+  }
+}
+
+}  // namespace
+
+int
+main ()
+{
+  if (!RsDepthEncoder::available ()) {
+    printf ("built without zstd, nothing to test\n");
+    return 0;
+  }
+
+  RsWorkerPool pool (4);
+  for (const auto &size : sizes)
+    for (int padding : paddings)
+      for (unsigned bands : { 1u, 4u })
+        for (RsWorkerPool *p : { static_cast<RsWorkerPool *> (nullptr), &pool })
+          check (size, padding, bands, p);
+
+  if (failures) {
+    fprintf (stderr, "%d failures\n", failures);
+    return 1;
+  }
+  printf ("all round trips exact\n");
+  return 0;
+}
@@ -0,0 +1,198 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* rsholefill-test: SIMD hole filling against a scalar reference.
+ *
+ * Rows of every width from 1 to 40 and of a few camera widths, so the
+ * vector loops run with every tail length, are filled in each mode with
+ * and without the rows above and below. Rows mix random depth with holes,
+ * runs of zeros longer than a vector, holes at the row ends, the extremes
+ * 1 and 65535 and all-zero rows. The result must match a plain loop over
+ * the documented rule, and nothing past the row end may be written. The
+ * rows are allocated to their exact width so a sanitizer build catches
+ * reads beyond them. */
+
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+#include "rsholefill.h"
+
+namespace {
+
+const int extra_widths[] = { 63, 64, 65, 640, 641, 848 };
+
+/* Written past the row end to detect overruns */
+const uint16_t GUARD = 0xBEEF;
+const int GUARD_LEN = 16;
+
+int failures = 0;
+
+uint32_t
+next (uint32_t * state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+std::unique_ptr<uint16_t[]>
+make_row (int width, uint32_t * rng)
+{
+  std::unique_ptr<uint16_t[]> row (new uint16_t[width]);
+  const uint32_t kind = next (rng) % 6;
+  int x = 0;
+  while (x < width) {
+    uint16_t d;
+    int run = 1;
+    switch (kind == 0 ? 0 : next (rng) % 8) {
+      case 0:
+        /* Holes, sometimes longer than a vector */
+        d = 0;
+        run = 1 + next (rng) % (kind == 1 ? 24 : 4);
+        break;
+      case 1:
+        d = 1;
+        break;
+      case 2:
+        d = 65535;
+        break;
+      default:
+        d = static_cast<uint16_t> (1 + next (rng) % 65535);
+        break;
+    }
+    for (; run > 0 && x < width; --run, ++x)
+      row[x] = d;
+  }
+  /* Holes at either end */
+  if (kind == 2 && width > 0)
+    row[0] = 0;
+  if (kind == 3 && width > 0)
+    row[width - 1] = 0;
+  return row;
+}
+
+uint16_t
+sample (const uint16_t * row, int x, int width)
+{
+  return (row && x >= 0 && x < width) ? row[x] : 0;
+}
+
+uint16_t
+reference (RsHoleFill mode, const uint16_t * above, const uint16_t * row,
+    const uint16_t * below, int width, int x)
+{
+  if (row[x] || mode == RsHoleFill::Off)
+    return row[x];
+  if (mode == RsHoleFill::Left) {
+    for (int i = x - 1; i >= 0; --i)
+      if (row[i])
+        return row[i];
+    return 0;
+  }
+  uint16_t best = 0;
+  for (const uint16_t *r : { above, row, below }) {
+    for (int dx = -1; dx <= 1; ++dx) {
+      const uint16_t v = sample (r, x + dx, width);
+      if (v && (!best || (mode == RsHoleFill::Farthest ? v > best : v < best)))
+        best = v;
+    }
+  }
+  return best;
+}
+
+const char *
+mode_name (RsHoleFill mode)
+{
+  switch (mode) {
+    case RsHoleFill::Off:
+      return "off";
+    case RsHoleFill::Left:
+      return "left";
+    case RsHoleFill::Farthest:
+      return "farthest";
+    case RsHoleFill::Nearest:
+      return "nearest";
+  }
+  return "?";
+}
+
+template <RsHoleFill Mode>
+void
+check (int width, const uint16_t * above, const uint16_t * row, const uint16_t * below)
+{
+  std::vector<uint16_t> out (width + GUARD_LEN, GUARD);
+  rs_hole_fill_row<Mode> (above, row, below, width, out.data ());
+
+  for (int x = 0; x < width; ++x) {
+    const uint16_t want = reference (Mode, above, row, below, width, x);
+    if (out[x] != want) {
+      fprintf (stderr, "FAIL %s width %d%s%s x %d: %u, expected %u\n", mode_name (Mode),
+          width, above ? " above" : "", below ? " below" : "", x, out[x], want);
+      ++failures;
+      return;
+    }
+  }
+  for (int i = 0; i < GUARD_LEN; ++i) {
+    if (out[width + i] != GUARD) {
+      fprintf (stderr, "FAIL %s width %d: wrote %d past the row end\n", mode_name (Mode),
+          width, i);
+      ++failures;
+      return;
+    }
+  }
+}
+
+void
+check_width (int width, uint32_t * rng)
+{
+  for (int round = 0; round < 20; ++round) {
+    auto above = make_row (width, rng);
+    auto row = make_row (width, rng);
+    auto below = make_row (width, rng);
+    for (int edges = 0; edges < 4; ++edges) {
+      const uint16_t *a = (edges & 1) ? nullptr : above.get ();
+      const uint16_t *b = (edges & 2) ? nullptr : below.get ();
+      check<RsHoleFill::Off> (width, a, row.get (), b);
+      check<RsHoleFill::Left> (width, a, row.get (), b);
+      check<RsHoleFill::Farthest> (width, a, row.get (), b);
+      check<RsHoleFill::Nearest> (width, a, row.get (), b);
+    }
+  }
+}
+
+} // namespace
+
+int
+main ()
+{
+  uint32_t rng = 0x2545F491;
+  for (int width = 1; width <= 40; ++width)
+    check_width (width, &rng);
+  for (int width : extra_widths)
+    check_width (width, &rng);
+
+  if (failures) {
+    fprintf (stderr, "%d failures\n", failures);
+    return 1;
+  }
+  printf ("all rows match the scalar reference\n");
+  return 0;
+}
@@ -0,0 +1,177 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* rsmux-test: bit-exact round trip of the mux depth encoding.
+ *
+ * Every uint16 depth value is laid out in rows of several odd and SIMD
+ * boundary widths, encoded into the bottom half of a mux frame with each
+ * kernel this CPU supports and split again with RSMux::demux. The encoded
+ * bytes of every kernel must equal the scalar ones, and demux must return
+ * the color half unchanged, depth values up to DECIMAL_MAX_DEPTH exactly
+ * (0 beyond) and, for DecimalMask, the validity codes. */
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include <cstdio>
+#include <vector>
+
+#include "rsmux.h"
+
+namespace {
+
+struct KernelName
+{
+  RSMux::Kernel kernel;
+  const char *name;
+};
+
+const KernelName kernels[] = { { RSMux::Kernel::Scalar, "scalar" },
+    { RSMux::Kernel::SSSE3, "ssse3" }, { RSMux::Kernel::NEON, "neon" } };
+
+/* Up to and across the 16-pixel SIMD blocks, and a wide odd row */
+const int widths[] = { 1, 2, 15, 16, 17, 31, 33, 47, 641 };
+
+int failures = 0;
+
+void
+fail (const char *what, const char *kernel, int width, RSMux::DepthEncoding encoding,
+    size_t index)
+{
+  if (++failures <= 20)
+    fprintf (stderr, "FAIL %s: kernel %s, width %d, %s, pixel %zu\n", what, kernel, width,
+        encoding == RSMux::DepthEncoding::DecimalMask ? "DecimalMask" : "Decimal", index);
+}
+
+/* A mux frame with the given depth encoded by kernel, wrapped as a sample
+ * with the caps realsensesrc sets */
+GstSample *
+make_sample (const std::vector<uint16_t> & depth, int width, int height,
+    RSMux::DepthEncoding encoding, RSMux::Kernel kernel, std::vector<uint8_t> & encoded)
+{
+  GstVideoInfo vinfo;
+  gst_video_info_set_format (&vinfo, GST_VIDEO_FORMAT_RGB, width, height * 2);
+  const size_t stride = GST_VIDEO_INFO_PLANE_STRIDE (&vinfo, 0);
+  const size_t row = static_cast<size_t> (width) * 3;
+
+  GstBuffer *buffer = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (&vinfo), NULL);
+  GstMapInfo map;
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  for (int y = 0; y < height; ++y)
+    for (size_t x = 0; x < row; ++x)
+      map.data[y * stride + x] = static_cast<uint8_t> (x * 7 + y);
+
+  encoded.resize (row * height);
+  for (int y = 0; y < height; ++y) {
+    uint8_t *out = map.data + (height + y) * stride;
+    RSMux::encode_depth (depth.data () + static_cast<size_t> (y) * width, out, width,
+        encoding, kernel);
+    std::copy (out, out + row, encoded.data () + y * row);
+  }
+  gst_buffer_unmap (buffer, &map);
+
+  GstCaps *caps = gst_video_info_to_caps (&vinfo);
+  GstSample *sample = gst_sample_new (buffer, caps, NULL, NULL);
+  gst_caps_unref (caps);
+  gst_buffer_unref (buffer);
+  return sample;
+}
+
+void
+check_width (int width)
+{
+  /* All 65536 values, the last row padded by wrapping around */
+  const int height = (65536 + width - 1) / width;
+  std::vector<uint16_t> depth (static_cast<size_t> (width) * height);
+  for (size_t i = 0; i < depth.size (); ++i)
+    depth[i] = static_cast<uint16_t> (i);
+
+  for (auto encoding : { RSMux::DepthEncoding::Decimal, RSMux::DepthEncoding::DecimalMask }) {
+    const bool mask = encoding == RSMux::DepthEncoding::DecimalMask;
+    std::vector<uint8_t> reference;
+    GstSample *scalar = make_sample (depth, width, height, encoding, RSMux::Kernel::Scalar,
+        reference);
+
+    for (const auto &k : kernels) {
+      if (!RSMux::kernel_supported (k.kernel))
+        continue;
+
+      /* Encoders agree byte for byte with scalar */
+      std::vector<uint8_t> encoded;
+      GstSample *sample = make_sample (depth, width, height, encoding, k.kernel, encoded);
+      for (size_t i = 0; i < encoded.size (); ++i) {
+        if (encoded[i] != reference[i]) {
+          fail ("encode differs from scalar", k.name, width, encoding, i / 3);
+          break;
+        }
+      }
+
+      /* Decoders restore what the scalar encoder wrote */
+      std::vector<uint8_t> color, codes;
+      std::vector<uint16_t> decoded;
+      int w = 0, h = 0;
+      if (!RSMux::demux (scalar, color, decoded, &w, &h, mask ? &codes : nullptr, k.kernel)
+          || w != width || h != height) {
+        fail ("demux", k.name, width, encoding, 0);
+        gst_sample_unref (sample);
+        continue;
+      }
+      for (size_t i = 0; i < color.size (); ++i) {
+        const size_t x = i % (static_cast<size_t> (width) * 3), y = i / (width * 3);
+        if (color[i] != static_cast<uint8_t> (x * 7 + y)) {
+          fail ("color", k.name, width, encoding, i / 3);
+          break;
+        }
+      }
+      for (size_t i = 0; i < depth.size (); ++i) {
+        const uint16_t expected = depth[i] <= RSMux::DECIMAL_MAX_DEPTH ? depth[i] : 0;
+        if (decoded[i] != expected) {
+          fail ("depth", k.name, width, encoding, i);
+          break;
+        }
+        if (mask && codes[i] != RSMux::mask_code (depth[i])) {
+          fail ("mask code", k.name, width, encoding, i);
+          break;
+        }
+      }
+      gst_sample_unref (sample);
+    }
+    gst_sample_unref (scalar);
+  }
+}
+
+}  // namespace
+
+int
+main (int argc, char **argv)
+{
+  gst_init (&argc, &argv);
+
+  for (const auto &k : kernels)
+    printf ("%-7s %s\n", k.name, RSMux::kernel_supported (k.kernel) ? "tested" : "not supported");
+  for (int width : widths)
+    check_width (width);
+
+  if (failures) {
+    fprintf (stderr, "%d failures\n", failures);
+    return 1;
+  }
+  printf ("all round trips exact\n");
+  return 0;
+}
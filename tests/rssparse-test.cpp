@@ -0,0 +1,179 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* rssparse-test: sparse depth compaction and the get-distances lookup.
+ *
+ * Known depth planes of several sizes, with rows padded by non-zero
+ * garbage, are compacted inline and on a worker pool. Planes mix valid
+ * pixels, holes, empty 16-pixel blocks, blocks valid only towards their
+ * end, empty rows and the value 65535, and include all-empty and
+ * all-valid frames. The buffer, sized exactly by
+ * rs_sparse_max_size(), is parsed back: the header must hold the magic,
+ * count and frame size, and the records must be exactly the non-zero
+ * pixels in row-major order with their positions and values. Looking up
+ * each record's pixel in the plane, as get-distances does, must return its
+ * depth in metres, and pixels outside the frame must return 0. */
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "rsdepthquery.h"
+#include "rssparse.h"
+
+namespace {
+
+struct Size
+{
+  int width, height;
+};
+
+const Size sizes[] = { { 1, 1 }, { 15, 3 }, { 16, 2 }, { 17, 5 }, { 33, 9 }, { 640, 37 },
+    { 848, 480 } };
+
+/* Extra pixels at the end of each row */
+const int paddings[] = { 0, 3 };
+
+enum class Fill
+{
+  Mixed,
+  Empty,
+  Full
+};
+
+const float DEPTH_SCALE = 0.001f;
+
+int failures = 0;
+
+uint16_t
+depth_at (Fill fill, int x, int y)
+{
+  if (fill == Fill::Empty)
+    return 0;
+  if (fill == Fill::Full)
+    return static_cast<uint16_t> (1 + (x * 31 + y * 17) % 65535);
+  /* Every third row empty, every fourth 16-pixel block empty, blocks with
+   * only their second half or last pixel valid, scattered holes elsewhere */
+  const int block = (x / 16) % 4, lane = x % 16;
+  if (y % 3 == 1 || block == 2 || (block == 3 && lane < 8)
+      || (block == 0 && y % 3 == 0 && lane != 15) || (x * 7 + y * 13) % 5 == 0)
+    return 0;
+  if ((x + y) % 11 == 0)
+    return 65535;
+  return static_cast<uint16_t> (1 + (x * 31 + y * 17) % 65535);
+}
+
+void
+fail (const Size & size, int padding, Fill fill, RsWorkerPool * pool, const char *what)
+{
+  static const char *fills[] = { "mixed", "empty", "full" };
+  fprintf (stderr, "FAIL %dx%d padding %d %s%s: %s\n", size.width, size.height, padding,
+      fills[static_cast<int> (fill)], pool ? " pool" : "", what);
+  ++failures;
+}
+
+void
+check (const Size & size, int padding, Fill fill, RsWorkerPool * pool)
+{
+  const int width = size.width, height = size.height;
+  const size_t stride = width + padding;
+  std::vector<uint16_t> depth (stride * height, 0xBEEF);
+  for (int y = 0; y < height; ++y)
+    for (int x = 0; x < width; ++x)
+      depth[y * stride + x] = depth_at (fill, x, y);
+
+  std::vector<uint8_t> out (rs_sparse_max_size (width, height));
+  const size_t used = rs_sparse_compact (depth.data (), stride * sizeof (uint16_t), width,
+      height, out.data (), pool);
+
+  RsSparseHeader header;
+  memcpy (&header, out.data (), sizeof (header));
+  if (header.magic != RS_SPARSE_MAGIC || header.width != width || header.height != height) {
+    fail (size, padding, fill, pool, "bad header");
+    return;
+  }
+  if (used != sizeof (header) + header.count * sizeof (RsSparsePoint)) {
+    fail (size, padding, fill, pool, "size does not match the count");
+    return;
+  }
+
+  /* Walk the plane in row-major order alongside the records */
+  const uint8_t *records = out.data () + sizeof (header);
+  uint32_t n = 0;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      const uint16_t z = depth_at (fill, x, y);
+      if (!z)
+        continue;
+      if (n >= header.count) {
+        fail (size, padding, fill, pool, "too few records");
+        return;
+      }
+      RsSparsePoint point;
+      memcpy (&point, records + n * sizeof (point), sizeof (point));
+      if (point.u != x || point.v != y || point.z != z) {
+        fprintf (stderr, "record %u is (%u, %u, %u), expected (%d, %d, %u)\n", n, point.u,
+            point.v, point.z, x, y, z);
+        fail (size, padding, fill, pool, "wrong record");
+        return;
+      }
+      const float metres = rs_depth_at (depth.data (), stride, width, height, DEPTH_SCALE,
+          point.u + 0.5f, point.v + 0.5f);
+      if (metres != point.z * DEPTH_SCALE) {
+        fail (size, padding, fill, pool, "lookup does not match the record");
+        return;
+      }
+      ++n;
+    }
+  }
+  if (n != header.count) {
+    fail (size, padding, fill, pool, "too many records");
+    return;
+  }
+
+  /* Just outside each edge, where the padding holds garbage */
+  const float outside[][2] = { { -0.5f, 0.0f }, { 0.0f, -0.5f }, { width + 0.0f, 0.0f },
+    { width - 0.5f, height + 0.0f }, { width + 0.5f, height - 0.5f } };
+  for (const auto &p : outside) {
+    if (rs_depth_at (depth.data (), stride, width, height, DEPTH_SCALE, p[0], p[1]) != 0.0f) {
+      fail (size, padding, fill, pool, "lookup outside the frame is not 0");
+      return;
+    }
+  }
+}
+
+} // namespace
+
+int
+main ()
+{
+  RsWorkerPool pool (4);
+  for (const auto &size : sizes)
+    for (int padding : paddings)
+      for (Fill fill : { Fill::Mixed, Fill::Empty, Fill::Full })
+        for (RsWorkerPool *p : { static_cast<RsWorkerPool *> (nullptr), &pool })
+          check (size, padding, fill, p);
+
+  if (failures) {
+    fprintf (stderr, "%d failures\n", failures);
+    return 1;
+  }
+  printf ("all sparse buffers decode to their planes\n");
+  return 0;
+}
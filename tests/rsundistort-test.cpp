@@ -0,0 +1,190 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* rsundistort-test: the SSSE3 color remap against the scalar one.
+ *
+ * Images of every width from 2 to 40 and a few camera widths, so rows end
+ * at every offset of the vector loop, are undistorted through a model with
+ * strong barrel and tangential distortion whose corners sample outside the
+ * image, so the edge clamp and the last source columns are exercised.
+ * Input and output rows are padded to odd strides and the last input row
+ * ends exactly at the allocation, so a sanitizer build catches reads beyond
+ * it. The SSSE3 result must equal the scalar one byte for byte, inline and
+ * on a worker pool, nothing outside the rows may be written, and a flat
+ * image must stay flat. */
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "rsundistort.h"
+
+namespace {
+
+struct Size
+{
+  int width, height;
+};
+
+const Size extra_sizes[] = { { 63, 9 }, { 64, 9 }, { 65, 9 }, { 641, 37 }, { 848, 480 } };
+
+/* Extra bytes at the end of each row */
+const int paddings[] = { 0, 5 };
+
+const uint8_t GUARD = 0xA5;
+
+int failures = 0;
+
+uint32_t
+next (uint32_t * state)
+{
+  *state ^= *state << 13;
+  *state ^= *state >> 17;
+  *state ^= *state << 5;
+  return *state;
+}
+
+rs2_intrinsics
+make_intrinsics (int width, int height)
+{
+  rs2_intrinsics intrin = {};
+  intrin.width = width;
+  intrin.height = height;
+  intrin.fx = intrin.fy = 0.6f * width;
+  intrin.ppx = 0.5f * width + 0.3f;
+  intrin.ppy = 0.5f * height - 0.2f;
+  intrin.model = RS2_DISTORTION_INVERSE_BROWN_CONRADY;
+  const float coeffs[5] = { 0.35f, -0.1f, 0.01f, -0.008f, 0.05f };
+  memcpy (intrin.coeffs, coeffs, sizeof (coeffs));
+  return intrin;
+}
+
+/* Returns the output plane, with guard bytes in the padding and after the
+ * last row */
+std::vector<uint8_t>
+run (const RsUndistorter & undistorter, const std::vector<uint8_t> &in, size_t in_stride,
+    size_t out_stride, int height, RsWorkerPool * pool, RSMux::Kernel kernel)
+{
+  std::vector<uint8_t> out (out_stride * height + 16, GUARD);
+  undistorter.remap (in.data (), in_stride, out.data (), out_stride, pool, kernel);
+  return out;
+}
+
+bool
+guards_intact (const std::vector<uint8_t> &out, int width, int height, size_t stride)
+{
+  for (size_t i = 0; i < out.size (); ++i) {
+    const bool in_row = i < stride * height && i % stride < static_cast<size_t> (width) * 3;
+    if (!in_row && out[i] != GUARD)
+      return false;
+  }
+  return true;
+}
+
+void
+check (const Size & size, int padding, RsWorkerPool * pool, uint32_t * rng)
+{
+  const int width = size.width, height = size.height;
+  RsUndistorter undistorter;
+  if (!undistorter.configure (make_intrinsics (width, height))) {
+    fprintf (stderr, "FAIL %dx%d: nothing to undistort\n", width, height);
+    ++failures;
+    return;
+  }
+
+  const size_t in_stride = width * 3 + padding;
+  const size_t out_stride = width * 3 + (padding ? padding + 2 : 0);
+  /* The last row is not padded, so the plane ends with the image */
+  std::vector<uint8_t> in (in_stride * (height - 1) + width * 3);
+  for (auto &b : in)
+    b = static_cast<uint8_t> (next (rng));
+
+  const auto scalar = run (undistorter, in, in_stride, out_stride, height, nullptr,
+      RSMux::Kernel::Scalar);
+  const auto ssse3 = run (undistorter, in, in_stride, out_stride, height, pool,
+      RSMux::Kernel::SSSE3);
+
+  for (int y = 0; y < height; ++y) {
+    const size_t row = y * out_stride;
+    for (int x = 0; x < width * 3; ++x) {
+      if (scalar[row + x] != ssse3[row + x]) {
+        fprintf (stderr, "FAIL %dx%d padding %d%s: pixel (%d, %d) channel %d is %u, "
+            "scalar %u\n", width, height, padding, pool ? " pool" : "", x / 3, y, x % 3,
+            ssse3[row + x], scalar[row + x]);
+        ++failures;
+        return;
+      }
+    }
+  }
+  if (!guards_intact (scalar, width, height, out_stride)
+      || !guards_intact (ssse3, width, height, out_stride)) {
+    fprintf (stderr, "FAIL %dx%d padding %d: wrote outside the rows\n", width, height,
+        padding);
+    ++failures;
+    return;
+  }
+
+  /* The blend weights sum to one, so a flat image stays flat */
+  std::vector<uint8_t> flat (in.size ());
+  for (size_t i = 0; i < flat.size (); ++i)
+    flat[i] = static_cast<uint8_t> (40 + 80 * (i % in_stride % 3));
+  for (RSMux::Kernel kernel : { RSMux::Kernel::Scalar, RSMux::Kernel::SSSE3 }) {
+    const auto out = run (undistorter, flat, in_stride, out_stride, height, pool, kernel);
+    for (int y = 0; y < height; ++y) {
+      for (int x = 0; x < width * 3; ++x) {
+        if (out[y * out_stride + x] != 40 + 80 * (x % 3)) {
+          fprintf (stderr, "FAIL %dx%d %s: flat image changed at (%d, %d)\n", width, height,
+              kernel == RSMux::Kernel::Scalar ? "scalar" : "ssse3", x / 3, y);
+          ++failures;
+          return;
+        }
+      }
+    }
+  }
+}
+
+} // namespace
+
+int
+main ()
+{
+  if (!RSMux::kernel_supported (RSMux::Kernel::SSSE3)) {
+    printf ("no SSSE3 on this CPU, nothing to test\n");
+    return 0;
+  }
+
+  RsWorkerPool pool (4);
+  uint32_t rng = 0x9E3779B9;
+  for (int padding : paddings) {
+    for (RsWorkerPool *p : { static_cast<RsWorkerPool *> (nullptr), &pool }) {
+      for (int width = 2; width <= 40; ++width)
+        for (int height : { 2, 7 })
+          check ({ width, height }, padding, p, &rng);
+      for (const auto &size : extra_sizes)
+        check (size, padding, p, &rng);
+    }
+  }
+
+  if (failures) {
+    fprintf (stderr, "%d failures\n", failures);
+    return 1;
+  }
+  printf ("SSSE3 remap matches the scalar remap\n");
+  return 0;
+}
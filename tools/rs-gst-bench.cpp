@@ -0,0 +1,758 @@
+/* GStreamer RealSense is a set of plugins to acquire frames from
+ * Intel RealSense cameras into GStreamer pipeline.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* rs-gst-bench: runs realsensesrc ! fakesink with the given element
+ * properties for a fixed time and reports frame rate, CPU time per frame,
+ * latency percentiles and drop counts, as text or JSON.
+ *
+ *   rs-gst-bench --duration 20 --json align=3 encode-threads=4
+ *
+ * Latency comes from the element's GstRealsenseLatencyMeta (latency-meta is
+ * always switched on) and ends when fakesink hands the buffer off.
+ *
+ * With --ground-truth and the synthetic camera it also scores the output
+ * depth against the scene the camera renders (rssyntheticscene.h), e.g. to
+ * weigh guided upsampling against alignment plus hole filling:
+ *
+ *   rs-gst-bench --ground-truth synthetic=true align=3
+ *   rs-gst-bench --ground-truth synthetic=true align=1 hole-fill=2
+ *
+ * With --starts N it instead starts and stops the pipeline N times and
+ * reports each startup phase of the first (cold) start and the median and
+ * worst of the rest (warm), e.g. without a camera:
+ *
+ *   rs-gst-bench --starts 10 synthetic=true
+ *
+ * With --copy it runs no pipeline and times the element's color plane copy
+ * (RSMux::copy_plane) with cached and streaming stores, and how long a
+ * cache-sized working set takes to read back after each copy. With --encode
+ * it times the depth encode and decode of each kernel (RSMux::encode_depth,
+ * RSMux::decode_depth_plane) the CPU supports. */
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "gstrealsensemeta.h"
+#include "rsmux.h"
+#include "rssyntheticscene.h"
+
+#ifndef RS_BENCH_PLUGIN_DIR
+#define RS_BENCH_PLUGIN_DIR ""
+#endif
+
+namespace {
+
+struct Options
+{
+  double duration = 10.0;
+  double warmup = 2.0;
+  bool json = false;
+  bool coverage = false;
+  bool ground_truth = false;
+  int starts = 0;
+  bool copy = false;
+  bool encode = false;
+  std::string plugin_path = RS_BENCH_PLUGIN_DIR;
+  std::vector<std::string> properties;
+};
+
+/* Latency samples of one stage pair, in ms */
+struct Series
+{
+  const char *name;
+  std::vector<double> ms;
+
+  double percentile(double p) const
+  {
+    if (ms.empty())
+      return NAN;
+    /* Nearest rank */
+    std::vector<double> sorted (ms);
+    const size_t rank = static_cast<size_t> (std::ceil (p / 100.0 * sorted.size ()));
+    const size_t i = std::min (std::max<size_t> (rank, 1), sorted.size ()) - 1;
+    std::nth_element (sorted.begin (), sorted.begin () + i, sorted.end ());
+    return sorted[i];
+  }
+};
+
+enum SeriesId
+{
+  SeriesTotal,    // arrival -> fakesink
+  SeriesSensor,   // sensor timestamp -> fakesink, host time domains only
+  SeriesAlign,    // arrival -> aligned
+  SeriesEncode,   // aligned -> encoded
+  SeriesPush,     // encoded -> pushed
+  SeriesCount
+};
+
+struct Bench
+{
+  std::mutex lock;
+  GType latency_api = 0;
+  bool coverage = false;
+  gint64 warmup_end = 0;    // monotonic us; frames before are not counted
+  gint64 first = 0, last = 0;
+  double cpu_start = 0.0;
+  guint64 frames = 0;
+  guint64 missed = 0;       // gaps in buffer timestamps of more than 1.5 frames
+  GstClockTime last_pts = GST_CLOCK_TIME_NONE;
+  GstClockTime frame_duration = GST_CLOCK_TIME_NONE;
+  double coverage_sum = 0.0;
+  guint64 coverage_frames = 0;
+  /* --ground-truth: stream sizes and depth scale, read once caps are set */
+  bool ground_truth = false;
+  int color_width = 0, color_height = 0, depth_width = 0, depth_height = 0;
+  int grid_divisor = 1;       // align-scale as 1/n
+  float depth_scale = 0.0f;
+  guint64 truth_pixels = 0;   // output pixels where the scene has depth
+  guint64 missing = 0;        // of these, without output depth
+  guint64 bad = 0;            // missing or more than BAD_ERROR off
+  double error_sum = 0.0;     // absolute error in metres where there is depth
+  Series series[SeriesCount] = { { "total", {} }, { "sensor", {} }, { "align", {} },
+      { "encode", {} }, { "push", {} } };
+};
+
+double
+cpu_seconds ()
+{
+  struct rusage usage;
+  getrusage (RUSAGE_SELF, &usage);
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+      + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+void
+add_interval (Series & series, GstClockTime from, GstClockTime to)
+{
+  if (GST_CLOCK_TIME_IS_VALID (from) && GST_CLOCK_TIME_IS_VALID (to) && to >= from)
+    series.ms.push_back ((to - from) / 1e6);
+}
+
+/* Share of the depth plane with depth, for mux output */
+double
+depth_coverage (GstBuffer * buffer, GstPad * pad)
+{
+  GstCaps *caps = gst_pad_get_current_caps (pad);
+  if (!caps)
+    return NAN;
+  GstSample *sample = gst_sample_new (buffer, caps, NULL, NULL);
+  gst_caps_unref (caps);
+
+  std::vector<uint8_t> color;
+  std::vector<uint16_t> depth;
+  int width, height;
+  const bool ok = RSMux::demux (sample, color, depth, &width, &height);
+  gst_sample_unref (sample);
+  if (!ok || depth.empty ())
+    return NAN;
+  const size_t valid = depth.size () - std::count (depth.begin (), depth.end (), 0);
+  return static_cast<double> (valid) / depth.size ();
+}
+
+/* Relative depth error beyond which a pixel counts as bad */
+constexpr double BAD_ERROR = 0.01;
+
+/* Compares mux output depth, on the (possibly reduced) color grid, with the
+ * synthetic scene at the frame's sensor timestamp. Pixels the depth camera
+ * cannot see are skipped. */
+void
+score_depth (Bench * bench, GstBuffer * buffer, GstPad * pad, double timestamp_ms)
+{
+  GstCaps *caps = gst_pad_get_current_caps (pad);
+  if (!caps || !bench->depth_scale)
+    return;
+  GstSample *sample = gst_sample_new (buffer, caps, NULL, NULL);
+  gst_caps_unref (caps);
+
+  std::vector<uint8_t> color;
+  std::vector<uint16_t> depth;
+  int width, height;
+  const bool ok = RSMux::demux (sample, color, depth, &width, &height);
+  gst_sample_unref (sample);
+  if (!ok || depth.empty ())
+    return;
+
+  /* align-scale shrinks the grid about the image corner */
+  const double n = bench->grid_divisor;
+  for (int y = 0; y < height; ++y) {
+    for (int x = 0; x < width; ++x) {
+      const double truth = RsSyntheticScene::color_truth ((x + 0.5) * n - 0.5,
+          (y + 0.5) * n - 0.5, bench->color_width, bench->color_height,
+          bench->depth_width, bench->depth_height, timestamp_ms / 1e3);
+      if (truth == 0.0)
+        continue;
+      ++bench->truth_pixels;
+      const uint16_t d = depth[static_cast<size_t> (y) * width + x];
+      if (!d) {
+        ++bench->missing;
+        ++bench->bad;
+        continue;
+      }
+      const double error = std::fabs (d * bench->depth_scale - truth);
+      bench->error_sum += error;
+      if (error > BAD_ERROR * truth)
+        ++bench->bad;
+    }
+  }
+}
+
+void
+on_handoff (GstElement * sink, GstBuffer * buffer, GstPad * pad, gpointer user_data)
+{
+  auto *bench = static_cast<Bench *>(user_data);
+  const GstClockTime now = g_get_monotonic_time () * GST_USECOND;
+  const gint64 now_us = g_get_monotonic_time ();
+
+  std::lock_guard<std::mutex> guard (bench->lock);
+  if (now_us < bench->warmup_end)
+    return;
+  if (bench->frames == 0) {
+    bench->first = now_us;
+    bench->cpu_start = cpu_seconds ();
+  }
+  bench->last = now_us;
+  ++bench->frames;
+
+  const GstClockTime pts = GST_BUFFER_PTS (buffer);
+  if (GST_CLOCK_TIME_IS_VALID (pts) && GST_CLOCK_TIME_IS_VALID (bench->last_pts)
+      && GST_CLOCK_TIME_IS_VALID (bench->frame_duration) && pts > bench->last_pts) {
+    const GstClockTime gap = pts - bench->last_pts;
+    if (gap * 2 > bench->frame_duration * 3)
+      bench->missed += (gap + bench->frame_duration / 2) / bench->frame_duration - 1;
+  }
+  bench->last_pts = pts;
+
+  // The plugin registers the meta API with its first meta
+  if (!bench->latency_api)
+    bench->latency_api = g_type_from_name (GST_REALSENSE_LATENCY_META_API_NAME);
+  auto *meta = bench->latency_api ? reinterpret_cast<GstRealsenseLatencyMeta *>(
+      gst_buffer_get_meta (buffer, bench->latency_api)) : nullptr;
+  if (meta) {
+    add_interval (bench->series[SeriesTotal], meta->arrival, now);
+    add_interval (bench->series[SeriesSensor], meta->sensor, now);
+    add_interval (bench->series[SeriesAlign], meta->arrival, meta->aligned);
+    add_interval (bench->series[SeriesEncode], meta->aligned, meta->encoded);
+    add_interval (bench->series[SeriesPush], meta->encoded, meta->pushed);
+  }
+
+  if (bench->ground_truth && meta)
+    score_depth (bench, buffer, pad, meta->sensor_timestamp);
+
+  if (bench->coverage) {
+    const double share = depth_coverage (buffer, pad);
+    if (!std::isnan (share)) {
+      bench->coverage_sum += share;
+      ++bench->coverage_frames;
+    }
+  }
+}
+
+guint64
+stats_field (const GstStructure * stats, const char *name)
+{
+  guint64 value = 0;
+  if (stats)
+    gst_structure_get_uint64 (stats, name, &value);
+  return value;
+}
+
+void
+usage (const char *argv0)
+{
+  fprintf (stderr,
+      "Usage: %s [options] [property=value ...]\n"
+      "Runs realsensesrc ! fakesink with the given realsensesrc properties.\n"
+      "  -d, --duration SECONDS   measure for this long (default 10)\n"
+      "  -w, --warmup SECONDS     discard frames for this long first (default 2)\n"
+      "  -j, --json               print one JSON object\n"
+      "  -c, --coverage           report the share of output pixels with depth\n"
+      "                           (mux output; decodes every frame in the sink)\n"
+      "  -g, --ground-truth       score depth against the synthetic scene\n"
+      "                           (synthetic=true, align=1 or 3, mux output)\n"
+      "  -s, --starts N           time N starts instead; the first is cold\n"
+      "  -m, --copy               time the color plane copy instead (no camera)\n"
+      "  -e, --encode             time depth encode and decode instead (no camera)\n"
+      "  -p, --plugin-path DIR    directory holding the realsensesrc plugin\n", argv0);
+}
+
+bool
+parse_args (int argc, char **argv, Options & options)
+{
+  for (int i = 1; i < argc; ++i) {
+    const std::string arg = argv[i];
+    auto value = [&] () -> const char * {
+      return i + 1 < argc ? argv[++i] : nullptr;
+    };
+    if (arg == "-h" || arg == "--help") {
+      return false;
+    } else if (arg == "-d" || arg == "--duration") {
+      const char *v = value ();
+      if (!v || (options.duration = g_ascii_strtod (v, NULL)) <= 0)
+        return false;
+    } else if (arg == "-w" || arg == "--warmup") {
+      const char *v = value ();
+      if (!v || (options.warmup = g_ascii_strtod (v, NULL)) < 0)
+        return false;
+    } else if (arg == "-j" || arg == "--json") {
+      options.json = true;
+    } else if (arg == "-c" || arg == "--coverage") {
+      options.coverage = true;
+    } else if (arg == "-g" || arg == "--ground-truth") {
+      options.ground_truth = true;
+    } else if (arg == "-s" || arg == "--starts") {
+      const char *v = value ();
+      if (!v || (options.starts = atoi (v)) <= 0)
+        return false;
+    } else if (arg == "-m" || arg == "--copy") {
+      options.copy = true;
+    } else if (arg == "-e" || arg == "--encode") {
+      options.encode = true;
+    } else if (arg == "-p" || arg == "--plugin-path") {
+      const char *v = value ();
+      if (!v)
+        return false;
+      options.plugin_path = v;
+    } else if (arg.find ('=') != std::string::npos && arg[0] != '-') {
+      options.properties.push_back (arg);
+    } else {
+      fprintf (stderr, "Unknown argument: %s\n", arg.c_str ());
+      return false;
+    }
+  }
+  return true;
+}
+
+void
+print_number (const char *key, double value, bool json, bool *first)
+{
+  if (json) {
+    if (std::isnan (value))
+      printf ("%s\"%s\": null", *first ? "" : ", ", key);
+    else
+      printf ("%s\"%s\": %.3f", *first ? "" : ", ", key, value);
+    *first = false;
+  } else if (!std::isnan (value)) {
+    printf ("%-24s %.3f\n", key, value);
+  }
+}
+
+/* Startup phases reported by the element, as in its startup-stats */
+const char *const startup_phases[] = { "context", "query-devices", "advanced-mode",
+    "load-preset", "setup", "pipeline-start", "configure", "first-frame", "total" };
+
+/* Brings the pipeline up and down options.starts times. The element posts
+ * realsense-startup at the end of each start; the wall time runs from the
+ * state change until then. */
+int
+run_starts (GstElement * pipeline, GstBus * bus, const Options & options,
+    const std::string & description)
+{
+  const size_t n_phases = G_N_ELEMENTS (startup_phases);
+  std::vector<Series> phases;
+  for (const char *name : startup_phases)
+    phases.push_back ({ name, {} });
+  phases.push_back ({ "wall", {} });
+
+  for (int i = 0; i < options.starts; ++i) {
+    const gint64 t_start = g_get_monotonic_time ();
+    if (gst_element_set_state (pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+      fprintf (stderr, "Pipeline failed to start\n");
+      gst_element_set_state (pipeline, GST_STATE_NULL);
+      return 1;
+    }
+
+    const GstStructure *startup = NULL;
+    GstMessage *msg = NULL;
+    while (!startup) {
+      msg = gst_bus_timed_pop_filtered (bus, 60 * GST_SECOND,
+          (GstMessageType) (GST_MESSAGE_ERROR | GST_MESSAGE_ELEMENT));
+      if (!msg)
+        break;
+      if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+        GError *error = NULL;
+        gchar *debug = NULL;
+        gst_message_parse_error (msg, &error, &debug);
+        fprintf (stderr, "Error: %s\n%s\n", error->message, debug ? debug : "");
+        g_clear_error (&error);
+        g_free (debug);
+        gst_message_unref (msg);
+        msg = NULL;
+        break;
+      }
+      if (gst_message_has_name (msg, "realsense-startup"))
+        startup = gst_message_get_structure (msg);
+      else
+        gst_message_unref (msg);
+    }
+    const double wall_ms = (g_get_monotonic_time () - t_start) / 1e3;
+    if (!startup) {
+      if (!msg)
+        fprintf (stderr, "Start %d did not complete\n", i + 1);
+      gst_element_set_state (pipeline, GST_STATE_NULL);
+      return 1;
+    }
+
+    for (size_t p = 0; p < n_phases; ++p) {
+      const std::string field = std::string (startup_phases[p]) + "-us";
+      gint64 us = 0;
+      gst_structure_get_int64 (startup, field.c_str (), &us);
+      phases[p].ms.push_back (us / 1e3);
+    }
+    phases[n_phases].ms.push_back (wall_ms);
+    gst_message_unref (msg);
+    gst_element_set_state (pipeline, GST_STATE_NULL);
+  }
+
+  bool first = true;
+  if (options.json) {
+    printf ("{\"pipeline\": \"");
+    for (const char *c = description.c_str (); *c; ++c)
+      printf (*c == '"' || *c == '\\' ? "\\%c" : "%c", *c);
+    printf ("\", ");
+  } else {
+    printf ("%s\n", description.c_str ());
+  }
+  print_number ("starts", options.starts, options.json, &first);
+  for (Series &phase : phases) {
+    const std::string name (phase.name);
+    print_number (("cold-" + name + "-ms").c_str (), phase.ms[0], options.json, &first);
+    Series warm = { phase.name, std::vector<double> (phase.ms.begin () + 1, phase.ms.end ()) };
+    print_number (("warm-" + name + "-p50-ms").c_str (), warm.percentile (50), options.json, &first);
+    print_number (("warm-" + name + "-max-ms").c_str (), warm.percentile (100), options.json, &first);
+  }
+  if (options.json)
+    printf ("}\n");
+  return 0;
+}
+
+/* Copies a color plane of each size into the top half of a mux frame,
+ * rotating through as many source and output frames as a pipeline holds,
+ * so neither starts out cached. After each copy a working set standing in
+ * for the encoder state is read back: its time grows with what the copy
+ * evicted. */
+int
+run_copy (const Options & options)
+{
+  static const struct { int width, height; } sizes[] = { { 640, 480 }, { 1280, 720 },
+      { 1920, 1080 } };
+  static const struct { const char *name; RSMux::Store store; } stores[] = {
+      { "cached", RSMux::Store::Cached }, { "streaming", RSMux::Store::Streaming } };
+  const int n_frames = 4;
+  const size_t working_set = 1 << 20;
+  const double seconds = std::min (options.duration, 2.0);
+
+  std::vector<uint8_t> hot (working_set, 1);
+  volatile uint64_t sink = 0;
+  auto read_hot = [&] () {
+    uint64_t sum = 0;
+    for (size_t i = 0; i < working_set; i += 64)
+      sum += hot[i];
+    sink = sink + sum;
+  };
+
+  bool first = true;
+  if (options.json)
+    printf ("{");
+  print_number ("streaming-supported", RSMux::streaming_supported (), options.json, &first);
+  for (const auto &size : sizes) {
+    const size_t row = static_cast<size_t> (size.width) * 3;
+    const size_t plane = row * size.height;
+    std::vector<std::vector<uint8_t>> color (n_frames, std::vector<uint8_t> (plane, 7));
+    std::vector<std::vector<uint8_t>> out (n_frames, std::vector<uint8_t> (2 * plane));
+
+    for (const auto &store : stores) {
+      Series copy = { "copy", {} }, reread = { "reread", {} };
+      const gint64 end = g_get_monotonic_time () + static_cast<gint64> (seconds * G_USEC_PER_SEC);
+      for (int i = 0; g_get_monotonic_time () < end; ++i) {
+        read_hot ();
+        gint64 t0 = g_get_monotonic_time ();
+        RSMux::copy_plane (color[i % n_frames].data (), row, out[i % n_frames].data (), row,
+            row, size.height, store.store);
+        gint64 t1 = g_get_monotonic_time ();
+        read_hot ();
+        const gint64 t2 = g_get_monotonic_time ();
+        copy.ms.push_back ((t1 - t0) / 1e3);
+        reread.ms.push_back ((t2 - t1) / 1e3);
+      }
+
+      const std::string key = std::to_string (size.width) + "x" + std::to_string (size.height)
+          + "-" + store.name;
+      const double p50 = copy.percentile (50);
+      print_number ((key + "-p50-ms").c_str (), p50, options.json, &first);
+      print_number ((key + "-gbps").c_str (), plane / (p50 * 1e6), options.json, &first);
+      print_number ((key + "-reread-p50-ms").c_str (), reread.percentile (50), options.json, &first);
+    }
+  }
+  if (options.json)
+    printf ("}\n");
+  return 0;
+}
+
+/* Encodes a depth plane of each size into the bottom half of a mux frame
+ * and decodes it again, row by row as the element and RSMux::demux do, with
+ * every kernel this CPU supports. The depth is a ramp with holes and
+ * out-of-range pixels, so every branch of the encoders is taken. */
+int
+run_encode (const Options & options)
+{
+  static const struct { int width, height; } sizes[] = { { 640, 480 }, { 848, 480 },
+      { 1280, 720 } };
+  static const struct { const char *name; RSMux::Kernel kernel; } kernels[] = {
+      { "scalar", RSMux::Kernel::Scalar }, { "ssse3", RSMux::Kernel::SSSE3 },
+      { "neon", RSMux::Kernel::NEON } };
+  static const struct { const char *name; RSMux::DepthEncoding encoding; } encodings[] = {
+      { "decimal", RSMux::DepthEncoding::Decimal },
+      { "mask", RSMux::DepthEncoding::DecimalMask } };
+  const double seconds = std::min (options.duration, 1.0);
+
+  bool first = true;
+  if (options.json)
+    printf ("{");
+  for (const auto &size : sizes) {
+    const size_t n = static_cast<size_t> (size.width) * size.height;
+    const size_t row = static_cast<size_t> (size.width) * 3;
+    std::vector<uint16_t> depth (n), decoded (n);
+    std::vector<uint8_t> rgb (n * 3), mask (n);
+    for (size_t i = 0; i < n; ++i)
+      depth[i] = i % 97 == 0 ? 0 : static_cast<uint16_t> ((i * 7) % 3000);
+
+    for (const auto &kernel : kernels) {
+      if (!RSMux::kernel_supported (kernel.kernel))
+        continue;
+      for (const auto &encoding : encodings) {
+        const bool with_mask = encoding.encoding == RSMux::DepthEncoding::DecimalMask;
+        Series encode = { "encode", {} }, decode = { "decode", {} };
+        const gint64 end = g_get_monotonic_time () + static_cast<gint64> (seconds * G_USEC_PER_SEC);
+        while (g_get_monotonic_time () < end) {
+          const gint64 t0 = g_get_monotonic_time ();
+          for (int y = 0; y < size.height; ++y)
+            RSMux::encode_depth (depth.data () + static_cast<size_t> (y) * size.width,
+                rgb.data () + y * row, size.width, encoding.encoding, kernel.kernel);
+          const gint64 t1 = g_get_monotonic_time ();
+          RSMux::decode_depth_plane (rgb.data (), row, decoded.data (),
+              size.width * sizeof (uint16_t), size.width, size.height, encoding.encoding,
+              kernel.kernel);
+          if (with_mask)
+            RSMux::decode_mask (rgb.data (), mask.data (), n, kernel.kernel);
+          const gint64 t2 = g_get_monotonic_time ();
+          encode.ms.push_back ((t1 - t0) / 1e3);
+          decode.ms.push_back ((t2 - t1) / 1e3);
+        }
+
+        const std::string key = std::to_string (size.width) + "x" + std::to_string (size.height)
+            + "-" + kernel.name + "-" + encoding.name;
+        print_number ((key + "-encode-p50-ms").c_str (), encode.percentile (50), options.json,
+            &first);
+        print_number ((key + "-decode-p50-ms").c_str (), decode.percentile (50), options.json,
+            &first);
+      }
+    }
+  }
+  if (options.json)
+    printf ("}\n");
+  return 0;
+}
+
+}  // namespace
+
+int
+main (int argc, char **argv)
+{
+  Options options;
+  if (!parse_args (argc, argv, options)) {
+    usage (argv[0]);
+    return 2;
+  }
+
+  gst_init (NULL, NULL);
+  if (options.copy)
+    return run_copy (options);
+  if (options.encode)
+    return run_encode (options);
+  if (!options.plugin_path.empty ())
+    gst_registry_scan_path (gst_registry_get (), options.plugin_path.c_str ());
+
+  std::string description = "realsensesrc name=src latency-meta=true";
+  for (const auto &property : options.properties)
+    description += " " + property;
+  description += " ! fakesink name=sink sync=false signal-handoffs=true";
+
+  GError *error = NULL;
+  GstElement *pipeline = gst_parse_launch (description.c_str (), &error);
+  if (!pipeline) {
+    fprintf (stderr, "Could not build pipeline: %s\n", error ? error->message : "unknown error");
+    g_clear_error (&error);
+    return 1;
+  }
+  if (error) {
+    fprintf (stderr, "%s\n", error->message);
+    g_clear_error (&error);
+  }
+
+  if (options.starts > 0) {
+    GstBus *bus = gst_element_get_bus (pipeline);
+    const int status = run_starts (pipeline, bus, options, description);
+    gst_object_unref (bus);
+    gst_object_unref (pipeline);
+    return status;
+  }
+
+  Bench bench;
+  bench.coverage = options.coverage;
+  bench.ground_truth = options.ground_truth;
+  GstElement *src = gst_bin_get_by_name (GST_BIN (pipeline), "src");
+  GstElement *sink = gst_bin_get_by_name (GST_BIN (pipeline), "sink");
+  if (options.ground_truth) {
+    gboolean synthetic = FALSE;
+    gint align = 0;
+    g_object_get (src, "synthetic", &synthetic, "align", &align, NULL);
+    if (!synthetic || (align != 1 && align != 3)) {
+      fprintf (stderr, "--ground-truth needs synthetic=true and align=1 or align=3\n");
+      gst_object_unref (src);
+      gst_object_unref (sink);
+      gst_object_unref (pipeline);
+      return 2;
+    }
+  }
+  g_signal_connect (sink, "handoff", G_CALLBACK (on_handoff), &bench);
+
+  const gint64 t_start = g_get_monotonic_time ();
+  bench.warmup_end = t_start + static_cast<gint64> (options.warmup * G_USEC_PER_SEC);
+  const gint64 deadline = bench.warmup_end + static_cast<gint64> (options.duration * G_USEC_PER_SEC);
+
+  int status = 0;
+  if (gst_element_set_state (pipeline, GST_STATE_PLAYING) == GST_STATE_CHANGE_FAILURE) {
+    fprintf (stderr, "Pipeline failed to start\n");
+    status = 1;
+  }
+
+  GstBus *bus = gst_element_get_bus (pipeline);
+  while (status == 0) {
+    const gint64 now = g_get_monotonic_time ();
+    if (now >= deadline)
+      break;
+    GstMessage *msg = gst_bus_timed_pop_filtered (bus, (deadline - now) * GST_USECOND,
+        (GstMessageType) (GST_MESSAGE_ERROR | GST_MESSAGE_EOS | GST_MESSAGE_ASYNC_DONE));
+    if (!msg)
+      break;
+    if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+      gchar *debug = NULL;
+      gst_message_parse_error (msg, &error, &debug);
+      fprintf (stderr, "Error: %s\n%s\n", error->message, debug ? debug : "");
+      g_clear_error (&error);
+      g_free (debug);
+      status = 1;
+    } else if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_EOS) {
+      gst_message_unref (msg);
+      break;
+    } else if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ASYNC_DONE) {
+      // Caps are negotiated; the expected frame spacing finds missed frames
+      GstPad *pad = gst_element_get_static_pad (sink, "sink");
+      GstCaps *caps = gst_pad_get_current_caps (pad);
+      gint fps_n = 0, fps_d = 1;
+      if (caps && gst_structure_get_fraction (gst_caps_get_structure (caps, 0), "framerate",
+              &fps_n, &fps_d) && fps_n > 0) {
+        std::lock_guard<std::mutex> guard (bench.lock);
+        bench.frame_duration = gst_util_uint64_scale_int (GST_SECOND, fps_d, fps_n);
+      }
+      if (caps)
+        gst_caps_unref (caps);
+      gst_object_unref (pad);
+
+      if (options.ground_truth) {
+        gint align = 0;
+        gfloat align_scale = 1.0f;
+        std::lock_guard<std::mutex> guard (bench.lock);
+        g_object_get (src, "color-width", &bench.color_width, "color-height", &bench.color_height,
+            "depth-width", &bench.depth_width, "depth-height", &bench.depth_height,
+            "depth-scale", &bench.depth_scale, "align", &align, "align-scale", &align_scale, NULL);
+        // As the element rounds it; only align=1 reduces the grid
+        if (align == 1)
+          bench.grid_divisor = std::max (1, static_cast<int> (std::lround (1.0f / align_scale)));
+      }
+    }
+    gst_message_unref (msg);
+  }
+  const double cpu_end = cpu_seconds ();
+
+  GstStructure *stats = NULL;
+  g_object_get (src, "stats", &stats, NULL);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  std::lock_guard<std::mutex> guard (bench.lock);
+  const double seconds = (bench.last - bench.first) / 1e6;
+  const double fps = bench.frames > 1 && seconds > 0 ? (bench.frames - 1) / seconds : NAN;
+  const double cpu_ms = bench.frames ? (cpu_end - bench.cpu_start) * 1e3 / bench.frames : NAN;
+
+  bool first = true;
+  if (options.json) {
+    printf ("{\"pipeline\": \"");
+    for (const char *c = description.c_str (); *c; ++c)
+      printf (*c == '"' || *c == '\\' ? "\\%c" : "%c", *c);
+    printf ("\", ");
+  } else {
+    printf ("%s\n", description.c_str ());
+  }
+  print_number ("seconds", seconds, options.json, &first);
+  print_number ("frames", static_cast<double> (bench.frames), options.json, &first);
+  print_number ("fps", fps, options.json, &first);
+  print_number ("cpu-ms-per-frame", cpu_ms, options.json, &first);
+  for (const Series &series : bench.series) {
+    for (int p : { 50, 95, 99 }) {
+      const std::string key = std::string (series.name) + "-p" + std::to_string (p) + "-ms";
+      print_number (key.c_str (), series.percentile (p), options.json, &first);
+    }
+  }
+  print_number ("missed-frames", static_cast<double> (bench.missed), options.json, &first);
+  for (const char *field : { "inflight-drops", "memory-drops", "record-drops" })
+    print_number (field, static_cast<double> (stats_field (stats, field)), options.json, &first);
+  if (options.coverage)
+    print_number ("depth-coverage", bench.coverage_frames
+        ? bench.coverage_sum / bench.coverage_frames : NAN, options.json, &first);
+  if (options.ground_truth) {
+    const double pixels = static_cast<double> (bench.truth_pixels);
+    const guint64 with_depth = bench.truth_pixels - bench.missing;
+    print_number ("depth-mae-mm", with_depth ? bench.error_sum * 1e3 / with_depth : NAN,
+        options.json, &first);
+    print_number ("depth-missing-share", pixels ? bench.missing / pixels : NAN, options.json,
+        &first);
+    print_number ("depth-bad-share", pixels ? bench.bad / pixels : NAN, options.json, &first);
+  }
+  if (options.json)
+    printf ("}\n");
+
+  if (stats)
+    gst_structure_free (stats);
+  gst_object_unref (bus);
+  gst_object_unref (src);
+  gst_object_unref (sink);
+  gst_object_unref (pipeline);
+  return status;
+}